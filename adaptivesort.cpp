@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <vector>
+#include "adaptivesort.h"
+#include "bench.h"
+
+using namespace std;
+
+// Run and merge counts summed over every adaptiveSort call, reported per sort as counters
+static AdaptiveSortStats totals;
+
+int main(int argc, char* argv[]) {
+    vector<BenchEngine> engines = {
+        {"adaptive", [](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+             AdaptiveSortStats stats;
+             adaptiveSort(a, b, 0, (ptrdiff_t)a.size() - 1, ctx.pool, &stats);
+             totals.natural_runs += stats.natural_runs;
+             totals.reversed_runs += stats.reversed_runs;
+             totals.merges += stats.merges;
+             totals.skipped_merges += stats.skipped_merges;
+             totals.parallel_merges += stats.parallel_merges;
+         }},
+        {"mergeSort/network", [](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             mergeSort(a, b, 0, n - 1, 50, max<ptrdiff_t>(10000, n / (4 * ctx.threads)), ctx.pool, networkSort);
+         }},
+        {"std::sort", [](vector<double>& a, vector<double>&, const BenchContext&) { sort(a.begin(), a.end()); }},
+        {"std::stable_sort", [](vector<double>& a, vector<double>&, const BenchContext&) { stable_sort(a.begin(), a.end()); }},
+    };
+    vector<BenchCounter> counters = {
+        {"natural_runs", [] { return (double)totals.natural_runs; }},
+        {"reversed_runs", [] { return (double)totals.reversed_runs; }},
+        {"merges", [] { return (double)totals.merges; }},
+        {"skipped_merges", [] { return (double)totals.skipped_merges; }},
+        {"parallel_merges", [] { return (double)totals.parallel_merges; }},
+    };
+    return benchMain(argc, argv, engines, counters);
+}
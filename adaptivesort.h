@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "threadpool.h"
+#include "merge.h"
+#include "parallel_merge.h"
+#include "mergesorttk.h"
+
+// Adaptive natural-run merge sort (powersort). Instead of splitting at the midpoint, the
+// input is scanned for runs that are already ascending or strictly descending (reversed
+// in place), short runs are extended to minRunLength() with insertion sort, and runs are
+// merged in the order given by the powersort merge policy. Merges trim the elements that
+// are already in place by galloping and are skipped entirely when arr[mid - 1] <= arr[mid],
+// so sorted, reversed and sorted-plus-tail inputs cost O(n).
+
+constexpr ptrdiff_t ADAPTIVE_MIN_MERGE = 64;     // Inputs this short are one insertion-sorted run
+constexpr ptrdiff_t GALLOP_BLOCK = 128;         // Outputs per SIMD merge block between galloping checks
+constexpr int MIN_GALLOP = 7;                    // Galloping continues while a run wins this many in a row
+constexpr ptrdiff_t ADAPTIVE_PARALLEL_MERGE = 1 << 18;  // Trimmed merges this large use the co-rank merge
+
+// Run and merge counts of the last adaptiveSort call
+struct AdaptiveSortStats {
+    ptrdiff_t natural_runs = 0;      // Runs found before minrun extension
+    ptrdiff_t reversed_runs = 0;     // Strictly descending runs reversed in place
+    ptrdiff_t merges = 0;
+    ptrdiff_t skipped_merges = 0;    // Runs already in order: nothing moved
+    ptrdiff_t parallel_merges = 0;
+};
+
+// Minimum run length for n elements: between ADAPTIVE_MIN_MERGE / 2 and ADAPTIVE_MIN_MERGE,
+// chosen so n / minrun is a power of two or slightly less
+inline ptrdiff_t minRunLength(ptrdiff_t n) {
+    ptrdiff_t r = 0;
+    while (n >= ADAPTIVE_MIN_MERGE) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+// End of the run starting at arr[lo] (at most hi). A strictly descending run is reversed,
+// so the range [lo, end) is ascending afterwards; strictness keeps the sort stable.
+inline ptrdiff_t extendRunAndMakeAscending(double* arr, ptrdiff_t lo, ptrdiff_t hi, bool& reversed) {
+    ptrdiff_t end = lo + 1;
+    reversed = false;
+    if (end == hi) return end;
+    if (arr[end] < arr[lo]) {
+        while (end + 1 < hi && arr[end + 1] < arr[end]) end++;
+        std::reverse(arr + lo, arr + end + 1);
+        reversed = true;
+    } else {
+        while (end + 1 < hi && !(arr[end + 1] < arr[end])) end++;
+    }
+    return end + 1;
+}
+
+// Powersort node power of the boundary between the adjacent runs [s1, s1 + n1) and
+// [s1 + n1, s1 + n1 + n2) in an array of n elements: the depth at which the boundary
+// would sit in a perfectly balanced merge tree over [0, n)
+inline int powersortPower(ptrdiff_t s1, ptrdiff_t n1, ptrdiff_t n2, ptrdiff_t n) {
+    int power = 0;
+    ptrdiff_t a = 2 * s1 + n1;   // Twice the midpoint of run 1
+    ptrdiff_t b = a + n1 + n2;   // Twice the midpoint of run 2
+    while (true) {
+        power++;
+        if (a >= n) {
+            a -= n;
+            b -= n;
+        } else if (b >= n) {
+            break;
+        }
+        a <<= 1;
+        b <<= 1;
+    }
+    return power;
+}
+
+// Exponential then binary search: number of leading elements of a[0..n) that precede
+// key, i.e. a[i] < key (Right = false) or a[i] <= key (Right = true). Costs O(log c) for
+// a result c, so long prefixes are found without scanning them.
+template <bool Right>
+ptrdiff_t gallop(double key, const double* a, ptrdiff_t n) {
+    auto precedes = [key](double e) { return Right ? !(key < e) : e < key; };
+    ptrdiff_t last = 0, ofs = 1;
+    while (ofs <= n && precedes(a[ofs - 1])) {
+        last = ofs;
+        ofs = 2 * ofs + 1;
+    }
+    return std::partition_point(a + last, a + std::min(ofs - 1, n), precedes) - a;
+}
+
+// Same search from the back: number of trailing elements of a[0..n) that are >= key
+inline ptrdiff_t gallopFromBack(double key, const double* a, ptrdiff_t n) {
+    ptrdiff_t last = 0, ofs = 1;
+    while (ofs <= n && !(a[n - ofs] < key)) {
+        last = ofs;
+        ofs = 2 * ofs + 1;
+    }
+    const ptrdiff_t lo = n - std::min(ofs - 1, n);
+    return n - (std::partition_point(a + lo, a + n - last, [key](double e) { return e < key; }) - a);
+}
+
+// Merges the buffered left run x[0..nx) with the right run y[0..ny) into dst, which sits
+// exactly nx elements before y in the same array, so y's remainder is already in place
+// once x runs out. Blocks of GALLOP_BLOCK outputs go through the SIMD kernel (a block
+// never reaches the unread part of y while nx >= GALLOP_BLOCK); when one run supplies a
+// whole block the merge gallops, copying whole stretches found by exponential search
+// until neither run wins MIN_GALLOP elements in a row. Ties go to x.
+inline void gallopMerge(const double* x, ptrdiff_t nx, double* y, ptrdiff_t ny, double* dst) {
+    // One galloping step: the x elements <= *y, then the y elements < the next x
+    auto gallopStep = [&] {
+        ptrdiff_t cx = gallop<true>(*y, x, nx);
+        dst = std::copy(x, x + cx, dst);
+        x += cx;
+        nx -= cx;
+        if (nx == 0) return cx;
+        ptrdiff_t cy = gallop<false>(*x, y, ny);
+        dst = std::copy(y, y + cy, dst);
+        y += cy;
+        ny -= cy;
+        return std::max(cx, cy);
+    };
+
+    while (nx >= GALLOP_BLOCK && ny > 0) {
+        const ptrdiff_t t = std::min(GALLOP_BLOCK, nx + ny);
+        const ptrdiff_t i = coRank(t, x, nx, y, ny);
+        mergeRuns(x, i, y, t - i, dst);
+        x += i;
+        nx -= i;
+        y += t - i;
+        ny -= t - i;
+        dst += t;
+        if (i == 0 || i == t) {
+            while (nx > 0 && ny > 0 && gallopStep() >= MIN_GALLOP) {
+            }
+        }
+    }
+    // Fewer than a block left in the buffer: every step places at least one x element
+    while (nx > 0 && ny > 0) gallopStep();
+    std::copy(x, x + nx, dst);
+}
+
+// Merges the adjacent sorted runs arr[lo, mid) and arr[mid, hi). Elements of the left run
+// that are <= arr[mid] and elements of the right run that are >= arr[mid - 1] are
+// already in place; only the rest is merged, with the left part buffered in aux.
+inline void adaptiveMerge(double* arr, double* aux, ptrdiff_t lo, ptrdiff_t mid, ptrdiff_t hi,
+                          WorkStealingPool& pool, AdaptiveSortStats& stats) {
+    stats.merges++;
+    if (!(arr[mid] < arr[mid - 1])) {
+        stats.skipped_merges++;
+        return;
+    }
+    lo += gallop<true>(arr[mid], arr + lo, mid - lo);
+    hi -= gallopFromBack(arr[mid - 1], arr + mid, hi - mid);
+    const ptrdiff_t na = mid - lo, nb = hi - mid;
+
+    if (na + nb >= ADAPTIVE_PARALLEL_MERGE && pool.size() > 0) {
+        // Large merges gain more from every core than from galloping
+        stats.parallel_merges++;
+        parallelCopy(arr + lo, aux + lo, na + nb, pool);
+        parallelMergeRuns(aux + lo, na, aux + mid, nb, arr + lo, pool);
+    } else {
+        std::copy(arr + lo, arr + mid, aux);
+        gallopMerge(aux, na, arr + mid, nb, arr + lo);
+    }
+}
+
+// Adaptive natural-run merge sort of arr[left..right] (inclusive, like mergeSort). aux
+// must be as large as arr; the pool is only used for large merges.
+inline void adaptiveSort(std::vector<double>& arr, std::vector<double>& aux, ptrdiff_t left, ptrdiff_t right,
+                         WorkStealingPool& pool = WorkStealingPool::instance(), AdaptiveSortStats* stats = nullptr) {
+    AdaptiveSortStats local;
+    AdaptiveSortStats& st = stats ? *stats : local;
+    st = AdaptiveSortStats{};
+    const ptrdiff_t n = right - left + 1;
+    if (n < 2) return;
+
+    double* a = arr.data();
+    const ptrdiff_t min_run = minRunLength(n);
+
+    // Next run from lo, extended to min_run elements with insertion sort
+    auto nextRun = [&](ptrdiff_t lo) {
+        bool reversed;
+        ptrdiff_t end = extendRunAndMakeAscending(a, lo, right + 1, reversed);
+        st.natural_runs++;
+        st.reversed_runs += reversed;
+        if (end - lo < min_run) {
+            end = std::min(lo + min_run, right + 1);
+            insertionSort(arr, lo, end - 1);   // The prefix is sorted, so only the new elements move
+        }
+        return end;
+    };
+
+    struct Run {
+        ptrdiff_t start, end;
+        int power;
+    };
+    std::vector<Run> stack;
+
+    // Offsets are relative to left so the powers describe the subarray being sorted
+    ptrdiff_t start = left, end = nextRun(left);
+    while (end <= right) {
+        ptrdiff_t next_end = nextRun(end);
+        int power = powersortPower(start - left, end - start, next_end - end, n);
+        while (!stack.empty() && stack.back().power > power) {
+            adaptiveMerge(a, aux.data(), stack.back().start, start, end, pool, st);
+            start = stack.back().start;
+            stack.pop_back();
+        }
+        stack.push_back({start, end, power});
+        start = end;
+        end = next_end;
+    }
+    while (!stack.empty()) {
+        adaptiveMerge(a, aux.data(), stack.back().start, start, end, pool, st);
+        start = stack.back().start;
+        stack.pop_back();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "bench.h"
+
+// Heap allocation counters for the benchmark reports. Including this header replaces the
+// global operator new and delete of the program, so include it from one driver (.cpp)
+// only. Memory from mmap (SortWorkspace, NumaBuffer) is not seen here; the workspace
+// counts its own growths.
+
+inline std::atomic<size_t> alloc_count{0};
+inline std::atomic<size_t> alloc_bytes{0};
+
+// Counts and allocates one block; every replaced form of operator new goes through here.
+// The aligned forms use aligned_alloc, whose size must be a multiple of the alignment.
+inline void* countedAlloc(size_t size, size_t align = 0) noexcept {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (align <= alignof(std::max_align_t)) return std::malloc(size);
+    return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+inline void* countedAllocOrThrow(size_t size, size_t align = 0) {
+    if (void* p = countedAlloc(size, align)) return p;
+    throw std::bad_alloc();
+}
+
+// Every form is replaced, so new/delete pairs always match (malloc and aligned_alloc are
+// both released with free).
+void* operator new(size_t size) { return countedAllocOrThrow(size); }
+void* operator new[](size_t size) { return countedAllocOrThrow(size); }
+void* operator new(size_t size, std::align_val_t align) { return countedAllocOrThrow(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align) { return countedAllocOrThrow(size, (size_t)align); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return countedAlloc(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return countedAlloc(size, (size_t)align); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+// allocations and alloc_bytes per timed run, for benchMain / measureSort
+inline std::vector<BenchCounter> allocationCounters() {
+    return {
+        {"allocations", [] { return (double)alloc_count.load(); }},
+        {"alloc_bytes", [] { return (double)alloc_bytes.load(); }},
+    };
+}
@@ -0,0 +1,124 @@
+// Argsort and key + payload sorting against sorting full rows, e.g.
+//   argsort --sizes 1e6,1e7 --threads 1,8 --engines 'argsort*,struct*'
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "argsort.h"
+#include "bench.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+// A 64-byte row: the key, a row id and six payload columns
+struct Row {
+    double key;
+    uint64_t id;
+    double payload[6];
+};
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    opts.sizes = {100000, 1000000, 10000000};
+    opts.reps = 5;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    // Variant names: struct/<engine> sorts the rows; pairs/<engine>/<id bits> sorts packed
+    // (key, row id) pairs; argsort/<engine> computes the permutation and argsort+gather/<engine>
+    // also reorders every column of the row with it
+    const vector<SortEngine> engines = {SortEngine::Merge, SortEngine::Radix, SortEngine::Rank};
+    BenchReport report(opts);
+
+    report.run([&](const BenchConfig& cfg) {
+        const ptrdiff_t n = cfg.n;
+        const vector<double>& keys = cfg.arr;
+        vector<Row> rows(n);
+        for (ptrdiff_t i = 0; i < n; i++) {
+            rows[i].key = keys[i];
+            rows[i].id = i;
+            for (int c = 0; c < 6; c++) rows[i].payload[c] = keys[i] + c;
+        }
+#ifdef _OPENMP
+        omp_set_num_threads(cfg.threads);
+#endif
+        psort::SortOptions sort_opts;
+        sort_opts.pool = &cfg.pool;
+        if (report.text()) cout << "Sorting " << n << " " << inputPatternName(cfg.input) << " keys of 64-byte rows with " << cfg.threads << " threads..." << endl;
+
+        auto record = [&](const string& name, const BenchStats& stats) { report.record({name, cfg.input, n, cfg.threads, stats, {}}); };
+
+        // Full rows: every comparison-sort move or radix scatter carries 64 bytes
+        vector<Row> sorted_rows;
+        auto rows_sorted = [&] {
+            return is_sorted(sorted_rows.begin(), sorted_rows.end(), [](const Row& a, const Row& b) { return a.key < b.key; });
+        };
+        auto copy_rows = [&] { sorted_rows = rows; };
+        if (report.selected("struct/merge")) {
+            record("struct/merge", measureRuns(opts.reps, opts.warmup, copy_rows,
+                                               [&] { psort::parallel_sort(sorted_rows, {}, &Row::key, sort_opts); }, rows_sorted));
+        }
+        if (report.selected("struct/radix")) {
+            record("struct/radix", measureRuns(opts.reps, opts.warmup, copy_rows,
+                                               [&] { psort::radix_sort(sorted_rows, {}, &Row::key, sort_opts); }, rows_sorted));
+        }
+        if (report.selected("struct/std::sort")) {
+            record("struct/std::sort", measureRuns(opts.reps, opts.warmup, copy_rows,
+                                                   [&] { psort::std_sort(sorted_rows, {}, &Row::key); }, rows_sorted));
+        }
+
+        for (SortEngine engine : engines) {
+            const string suffix = sortEngineName(engine);
+
+            vector<KeyPayload<uint32_t>> pairs32(n), sorted32;
+            vector<KeyPayload<uint64_t>> pairs64(n), sorted64;
+            for (ptrdiff_t i = 0; i < n; i++) {
+                pairs32[i] = {keys[i], (uint32_t)i};
+                pairs64[i] = {keys[i], (uint64_t)i};
+            }
+            auto by_key = [](const auto& a, const auto& b) { return a.key < b.key; };
+            if (report.selected("pairs/" + suffix + "/32")) {
+                record("pairs/" + suffix + "/32", measureRuns(opts.reps, opts.warmup, [&] { sorted32 = pairs32; },
+                                                              [&] { sortPairs(sorted32, engine, sort_opts); },
+                                                              [&] { return is_sorted(sorted32.begin(), sorted32.end(), by_key); }));
+            }
+            if (report.selected("pairs/" + suffix + "/64")) {
+                record("pairs/" + suffix + "/64", measureRuns(opts.reps, opts.warmup, [&] { sorted64 = pairs64; },
+                                                              [&] { sortPairs(sorted64, engine, sort_opts); },
+                                                              [&] { return is_sorted(sorted64.begin(), sorted64.end(), by_key); }));
+            }
+
+            // The permutation alone, then applied to all eight 8-byte columns of the row
+            vector<uint32_t> order;
+            auto ordered = [&] {
+                for (size_t i = 1; i < order.size(); i++) {
+                    if (keys[order[i]] < keys[order[i - 1]]) return false;
+                }
+                return true;
+            };
+            if (report.selected("argsort/" + suffix)) {
+                record("argsort/" + suffix, measureRuns(opts.reps, opts.warmup, [] {},
+                                                        [&] { argsort(keys, order, engine, sort_opts); }, ordered));
+            }
+            if (report.selected("argsort+gather/" + suffix)) {
+                vector<vector<double>> columns(8, vector<double>(n)), gathered(8, vector<double>(n));
+                for (ptrdiff_t i = 0; i < n; i++) {
+                    columns[0][i] = keys[i];
+                    columns[1][i] = (double)i;
+                    for (int c = 0; c < 6; c++) columns[2 + c][i] = rows[i].payload[c];
+                }
+                record("argsort+gather/" + suffix,
+                       measureRuns(opts.reps, opts.warmup, [] {},
+                                   [&] {
+                                       argsort(keys, order, engine, sort_opts);
+                                       for (int c = 0; c < 8; c++) gather(columns[c].data(), order.data(), n, gathered[c].data(), cfg.pool);
+                                   },
+                                   [&] { return is_sorted(gathered[0].begin(), gathered[0].end()); }));
+            }
+        }
+    });
+    return report.finish();
+}
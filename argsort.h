@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "threadpool.h"
+#include "parallel_merge.h"
+#include "psort.h"
+#include "ranksort.h"
+
+// Key-index sorting: argsort returns the permutation that sorts a column of doubles, so
+// any number of payload columns can be reordered later with gather; sortPairs sorts packed
+// (8-byte key, 4 or 8-byte row id) pairs without touching the rows they refer to. Both run
+// on the merge (psort::parallel_sort), radix (psort::radix_sort) or rank (ranksort.h)
+// engine and are stable: equal keys, -0.0 and +0.0 included, keep their input order.
+
+// Packed key + row id: 12 bytes with a 32-bit id, 16 with a 64-bit one
+#pragma pack(push, 4)
+template <typename Id>
+struct KeyPayload {
+    double key;
+    Id id;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(KeyPayload<uint32_t>) == 12, "32-bit ids are packed without padding");
+static_assert(sizeof(KeyPayload<uint64_t>) == 16, "64-bit ids take the second word");
+
+// Projection onto the key. It returns a copy: a 32-bit-id pair only guarantees 4-byte
+// alignment, so &KeyPayload::key would bind misaligned double references.
+struct PairKey {
+    template <typename Id>
+    double operator()(const KeyPayload<Id>& p) const { return p.key; }
+};
+
+enum class SortEngine { Merge, Radix, Rank };
+
+inline const char* sortEngineName(SortEngine e) {
+    switch (e) {
+        case SortEngine::Merge: return "merge";
+        case SortEngine::Radix: return "radix";
+        case SortEngine::Rank: return "rank";
+    }
+    return "?";
+}
+
+inline bool parseSortEngine(const std::string& name, SortEngine& e) {
+    for (SortEngine candidate : {SortEngine::Merge, SortEngine::Radix, SortEngine::Rank}) {
+        if (name == sortEngineName(candidate)) {
+            e = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// out[i] = column[order[i]] on the pool
+template <typename T, typename Index>
+void gather(const T* column, const Index* order, ptrdiff_t n, T* out, WorkStealingPool& pool = WorkStealingPool::instance()) {
+    parallelFor(n, pool, [&](ptrdiff_t lo, ptrdiff_t hi) {
+        for (ptrdiff_t i = lo; i < hi; i++) out[i] = column[order[i]];
+    });
+}
+
+template <typename T, typename Index>
+std::vector<T> gather(const std::vector<T>& column, const std::vector<Index>& order, WorkStealingPool& pool = WorkStealingPool::instance()) {
+    std::vector<T> out(order.size());
+    gather(column.data(), order.data(), (ptrdiff_t)order.size(), out.data(), pool);
+    return out;
+}
+
+// Sorts pairs by key. The rank engine sorts (key, position) Elements and moves every pair
+// once, to its final place.
+template <typename Id>
+void sortPairs(std::vector<KeyPayload<Id>>& pairs, SortEngine engine, psort::SortOptions opts = {}) {
+    WorkStealingPool& pool = opts.pool ? *opts.pool : WorkStealingPool::instance();
+    switch (engine) {
+        case SortEngine::Merge:
+            psort::parallel_sort(pairs, {}, PairKey{}, opts);
+            break;
+        case SortEngine::Radix:
+            psort::radix_sort(pairs, {}, PairKey{}, opts);
+            break;
+        case SortEngine::Rank: {
+            const ptrdiff_t n = pairs.size();
+            std::vector<double> keys(n);
+            parallelFor(n, pool, [&](ptrdiff_t lo, ptrdiff_t hi) {
+                for (ptrdiff_t i = lo; i < hi; i++) keys[i] = pairs[i].key;
+            });
+            std::vector<uint64_t> order;
+            parallel_rank_argsort(keys, order, optimized_parallel_merge, opts.workspace);
+            pairs = gather(pairs, order, pool);
+            break;
+        }
+    }
+}
+
+// Permutation that sorts keys: keys[order[0]] <= keys[order[1]] <= ..., equal keys in index
+// order. A 32-bit Index (columns of fewer than 2^32 rows) makes the pairs the merge and
+// radix engines move 12 bytes instead of 16.
+template <typename Index>
+void argsort(const std::vector<double>& keys, std::vector<Index>& order, SortEngine engine, psort::SortOptions opts = {}) {
+    const ptrdiff_t n = keys.size();
+    if (engine == SortEngine::Rank) {
+        parallel_rank_argsort(keys, order, optimized_parallel_merge, opts.workspace);
+        return;
+    }
+    WorkStealingPool& pool = opts.pool ? *opts.pool : WorkStealingPool::instance();
+    std::vector<KeyPayload<Index>> pairs(n);
+    parallelFor(n, pool, [&](ptrdiff_t lo, ptrdiff_t hi) {
+        for (ptrdiff_t i = lo; i < hi; i++) pairs[i] = {keys[i], static_cast<Index>(i)};
+    });
+    sortPairs(pairs, engine, opts);
+    order.resize(n);
+    parallelFor(n, pool, [&](ptrdiff_t lo, ptrdiff_t hi) {
+        for (ptrdiff_t i = lo; i < hi; i++) order[i] = pairs[i].id;
+    });
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "threadpool.h"
+#include "tuning.h"
+#include "psort.h"
+#include "bench.h"
+
+// Calibration of the tuning profile by successive halving: every (k, grain divisor, merge
+// kernel) candidate sorts a small array, the best 1/eta survive, and each round sorts an
+// array eta times larger until one candidate is left. Candidates are timed through
+// psort::parallel_sort, the consumer of the profile, on uniform random doubles.
+
+inline const std::vector<int> TUNE_K_VALUES = {8, 16, 32, 50, 64, 128};
+inline const std::vector<int> TUNE_GRAIN_DIVISORS = {1, 2, 4, 8, 16};
+
+struct AutotuneOptions {
+    ptrdiff_t n = 1 << 21;            // Array size of the last round
+    ptrdiff_t min_n = 1 << 16;        // Smallest array of the first round
+    int eta = 3;                      // 1/eta of the candidates survive each round
+    int reps = 3;                     // Timed sorts per candidate and round; the minimum counts
+    unsigned seed = 42;
+    WorkStealingPool* pool = nullptr; // nullptr = WorkStealingPool::instance()
+};
+
+struct TuneCandidate {
+    TuningProfile profile;
+    double ms = 0;   // Best time of the last round the candidate ran in
+};
+
+inline std::string describeProfile(const TuningProfile& p) {
+    return "k=" + std::to_string(p.k) + " grain_divisor=" + std::to_string(p.grain_divisor) + " kernel=" + p.kernel;
+}
+
+// Time of one candidate on arr: the minimum over opts.reps sorts
+inline double timeCandidate(const std::vector<double>& arr, const TuningProfile& p, const AutotuneOptions& opts, WorkStealingPool& pool) {
+    MergeRunsFn saved = activeMergeKernel();
+    activeMergeKernel() = mergeKernelByName(p.kernel);
+    psort::SortOptions sort_opts;
+    sort_opts.k = p.k;
+    sort_opts.min_thread_size = p.minThreadSize(arr.size(), (int)pool.size() + 1);
+    sort_opts.pool = &pool;
+    BenchStats stats = measureSort(arr, opts.reps, 0, [&](std::vector<double>& a, std::vector<double>&) {
+        psort::parallel_sort(a.begin(), a.end(), {}, {}, sort_opts);
+    });
+    activeMergeKernel() = saved;
+    return stats.min;
+}
+
+// Runs the search and returns the winning profile (tuned = true). Each round is logged to
+// log when it is not null.
+inline TuningProfile calibrate(const AutotuneOptions& opts = {}, std::ostream* log = nullptr) {
+    WorkStealingPool& pool = opts.pool ? *opts.pool : WorkStealingPool::instance();
+
+    std::vector<TuneCandidate> candidates;
+    for (int k : TUNE_K_VALUES) {
+        for (int divisor : TUNE_GRAIN_DIVISORS) {
+            for (const MergeKernelEntry& kernel : mergeKernels()) {
+                TuneCandidate c;
+                c.profile.k = k;
+                c.profile.grain_divisor = divisor;
+                c.profile.kernel = kernel.name;
+                c.profile.tuned = true;
+                candidates.push_back(c);
+            }
+        }
+    }
+
+    // Array size of every round: n / eta^(rounds - 1 - r), at least min_n
+    int rounds = 0;
+    for (size_t left = candidates.size(); left > 1; left = (left + opts.eta - 1) / opts.eta) rounds++;
+    std::vector<ptrdiff_t> sizes(std::max(rounds, 1));
+    ptrdiff_t size = opts.n;
+    for (int r = (int)sizes.size() - 1; r >= 0; r--) {
+        sizes[r] = std::max(size, std::min(opts.min_n, opts.n));
+        size /= opts.eta;
+    }
+
+    std::mt19937_64 gen(opts.seed);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::vector<double> input(opts.n);
+    for (double& x : input) x = dist(gen);
+
+    for (size_t r = 0; r < sizes.size(); r++) {
+        std::vector<double> arr(input.begin(), input.begin() + sizes[r]);
+        for (TuneCandidate& c : candidates) c.ms = timeCandidate(arr, c.profile, opts, pool);
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const TuneCandidate& a, const TuneCandidate& b) { return a.ms < b.ms; });
+        if (log) {
+            *log << "Round " << r + 1 << ": " << candidates.size() << " candidates at n = " << sizes[r]
+                 << ", best " << describeProfile(candidates[0].profile) << " (" << std::fixed << std::setprecision(3)
+                 << candidates[0].ms << " ms)" << std::endl;
+        }
+        candidates.resize(std::max<size_t>(1, (candidates.size() + opts.eta - 1) / opts.eta));
+    }
+    return candidates[0].profile;
+}
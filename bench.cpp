@@ -0,0 +1,123 @@
+// Single benchmark driver for every engine in the repository, e.g.
+//   bench --sizes 1e6,1e7 --threads 1,8 --inputs all --engines 'mergesorttk*,radixsort' --csv results.csv
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+#include "bench.h"
+#include "mergesorttk.h"
+#include "radixsort.h"
+#include "samplesort.h"
+#include "adaptivesort.h"
+#include "ranksort.h"
+#include "psort.h"
+#include "tuning.h"
+#include "numasort.h"
+#include "alloccount.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+// MIN_THREAD_SIZE of the original mergesorttk configuration
+static ptrdiff_t minThreadSize(ptrdiff_t n, const BenchContext& ctx) {
+    return max<ptrdiff_t>(10000, n / (4 * ctx.threads));
+}
+
+// One NUMA sorter (node-pinned pools and node-local buffers) per thread count
+static NumaSorter& numaSorter(int threads) {
+    static map<int, unique_ptr<NumaSorter>> sorters;
+    unique_ptr<NumaSorter>& sorter = sorters[threads];
+    if (!sorter) {
+        NumaSortOptions opts;
+        opts.threads = threads;
+        sorter = make_unique<NumaSorter>(opts);
+    }
+    return *sorter;
+}
+
+int main(int argc, char* argv[]) {
+    using Arr = vector<double>;
+    vector<BenchEngine> engines = {
+        {"std::sort", [](Arr& a, Arr&, const BenchContext&) { sort(a.begin(), a.end()); }},
+        {"std::stable_sort", [](Arr& a, Arr&, const BenchContext&) { stable_sort(a.begin(), a.end()); }},
+
+        // The four steps of the original files as configurations of the mergesorttk.h engine
+        {"mergesort", [](Arr& a, Arr& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             mergeSort(a, b, 0, n - 1, 1, n, ctx.pool);
+         }},
+        {"mergesortk", [](Arr& a, Arr& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             mergeSort(a, b, 0, n - 1, 50, n, ctx.pool);
+         }},
+        {"mergesortt", [](Arr& a, Arr& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             mergeSort(a, b, 0, n - 1, 1, minThreadSize(n, ctx), ctx.pool);
+         }},
+        {"mergesorttk", [](Arr& a, Arr& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             mergeSort(a, b, 0, n - 1, 50, minThreadSize(n, ctx), ctx.pool);
+         }},
+        {"mergesorttk/network", [](Arr& a, Arr& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             mergeSort(a, b, 0, n - 1, 50, minThreadSize(n, ctx), ctx.pool, networkSort);
+         }},
+        // k, grain and merge kernel from this host's profile (tune)
+        {"mergesorttk/tuned", [](Arr& a, Arr& b, const BenchContext& ctx) {
+             const TuningProfile& p = tunedProfile();
+             ptrdiff_t n = a.size();
+             mergeSort(a, b, 0, n - 1, p.k, p.minThreadSize(n, ctx.threads), ctx.pool, networkSort);
+         }},
+        {"mergesorttk/ping-pong", [](Arr& a, Arr& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             pingPongMergeSort(a, b, 0, n - 1, 50, minThreadSize(n, ctx), ctx.pool, networkSort);
+         }},
+        {"mergesorttk/k-way final merge", [](Arr& a, Arr& b, const BenchContext& ctx) {
+             multiwayMergeSort(a, b, 0, (ptrdiff_t)a.size() - 1, 50, ctx.pool, networkSort);
+         }},
+
+        {"numasort", [](Arr& a, Arr&, const BenchContext& ctx) { numaSorter(ctx.threads).sort(a); }, 5 * sizeof(double)},
+
+        {"radixsort", [](Arr& a, Arr& b, const BenchContext&) { radixSort(a, b); }},
+        {"radixsort/parallel", [](Arr& a, Arr& b, const BenchContext& ctx) { parallelRadixSort(a, b, 11, ctx.pool); }},
+        {"samplesort", [](Arr& a, Arr& b, const BenchContext& ctx) { sampleSort(a, b, 0, ctx.pool); }},
+        {"adaptive", [](Arr& a, Arr& b, const BenchContext& ctx) { adaptiveSort(a, b, 0, (ptrdiff_t)a.size() - 1, ctx.pool); }},
+        {"psort::sort", [](Arr& a, Arr&, const BenchContext& ctx) {
+             psort::SortOptions opts;
+             opts.pool = &ctx.pool;
+             psort::sort(a, {}, {}, opts);
+         }},
+        {"psort::parallel_sort", [](Arr& a, Arr&, const BenchContext& ctx) {
+             psort::SortOptions opts;
+             opts.pool = &ctx.pool;
+             psort::parallel_sort(a, {}, {}, opts);
+         }},
+        // A new workspace per sort: the allocation and page-fault cost the thread-local one saves
+        {"psort::parallel_sort/fresh workspace", [](Arr& a, Arr&, const BenchContext& ctx) {
+             SortWorkspace workspace;
+             psort::SortOptions opts;
+             opts.pool = &ctx.pool;
+             opts.workspace = &workspace;
+             psort::parallel_sort(a, {}, {}, opts);
+         }, 3 * sizeof(double), false},
+        // OpenMP tasks; serial when built without -fopenmp
+        {"ranksort", [](Arr& a, Arr&, [[maybe_unused]] const BenchContext& ctx) {
+#ifdef _OPENMP
+             omp_set_num_threads(ctx.threads);
+#endif
+             parallel_rank_sort(a);
+         }, 3 * sizeof(double) + 2 * sizeof(Element)},
+        {"ranksort/fresh workspace", [](Arr& a, Arr&, [[maybe_unused]] const BenchContext& ctx) {
+#ifdef _OPENMP
+             omp_set_num_threads(ctx.threads);
+#endif
+             SortWorkspace workspace;
+             parallel_rank_sort(a, optimized_parallel_merge, &workspace);
+         }, 3 * sizeof(double) + 2 * sizeof(Element), false},
+    };
+    vector<BenchCounter> counters = allocationCounters();
+    counters.push_back({"workspace_growths", [] { return (double)SortWorkspace::growths(); }});
+    return benchMain(argc, argv, engines, counters);
+}
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "threadpool.h"
+#include "benchsizes.h"
+#include "benchinputs.h"
+
+// Benchmark harness shared by every driver. Engines are registered by name, every
+// (input, size, thread count, engine) configuration runs `warmup` untimed and `reps`
+// timed sorts of the same input, each verified, and is reported as min / median / p95 /
+// stddev in ms plus elements/s and GB/s (the array bytes over the median time), as text,
+// CSV or JSON, so results of different builds can be diffed.
+
+// Everything an engine may use besides the arrays
+struct BenchContext {
+    WorkStealingPool& pool;
+    int threads;   // pool.size() + 1: the calling thread also runs tasks
+};
+
+using BenchSortFn = std::function<void(std::vector<double>& arr, std::vector<double>& aux, const BenchContext& ctx)>;
+
+struct BenchEngine {
+    std::string name;
+    BenchSortFn sort;
+    size_t bytes_per_element = 3 * sizeof(double);   // Input, timed copy and aux; sizes the large tier
+    bool by_default = true;                          // Otherwise only runs when named in --engines
+};
+
+// Process-wide monotonic counter (allocations, page faults, ...) read before and after
+// every timed run; the mean difference is reported next to the timings
+struct BenchCounter {
+    std::string name;
+    std::function<double()> read;
+};
+
+// Minor plus major page faults of the process so far; benchMain always reports them
+inline double pageFaults() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)(usage.ru_minflt + usage.ru_majflt);
+}
+
+// A "Vm...:" field of /proc/self/status in bytes (VmRSS resident now, VmHWM peak); 0 when
+// unavailable
+inline double residentBytes(const std::string& field = "VmRSS") {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind(field + ":", 0) == 0) return std::stod(line.substr(field.size() + 1)) * 1024;
+    }
+    return 0;
+}
+
+// Restarts VmHWM from the current RSS (Linux 4.0+); false where /proc/self/clear_refs
+// cannot be written
+inline bool resetPeakResident() {
+    std::ofstream clear("/proc/self/clear_refs");
+    return (bool)(clear << "5" << std::flush);
+}
+
+// Timings of the timed repetitions of one configuration, in ms
+struct BenchStats {
+    double min = 0, median = 0, p95 = 0, mean = 0, stddev = 0;
+    int reps = 0;
+};
+
+inline BenchStats summarize(std::vector<double> samples) {
+    BenchStats s;
+    s.reps = samples.size();
+    if (samples.empty()) return s;
+    std::sort(samples.begin(), samples.end());
+    const size_t m = samples.size();
+    s.min = samples[0];
+    s.median = m % 2 ? samples[m / 2] : (samples[m / 2 - 1] + samples[m / 2]) / 2;
+    s.p95 = samples[(size_t)std::ceil(0.95 * m) - 1];   // Nearest rank
+    for (double x : samples) s.mean += x;
+    s.mean /= m;
+    for (double x : samples) s.stddev += (x - s.mean) * (x - s.mean);
+    s.stddev = m > 1 ? std::sqrt(s.stddev / (m - 1)) : 0;
+    return s;
+}
+
+// Times sort(temp, aux) on `reps` fresh copies of arr after `warmup` untimed runs. Every
+// run is checked with is_sorted; counter_deltas receives the mean change of each counter.
+template <typename SortFn>
+BenchStats measureSort(const std::vector<double>& arr, int reps, int warmup, SortFn sort,
+                       const std::vector<BenchCounter>& counters = {}, std::vector<double>* counter_deltas = nullptr) {
+    const ptrdiff_t n = arr.size();
+    std::vector<double> aux(n);   // Preallocate auxiliary array
+    std::vector<double> temp(n);
+    std::vector<double> samples, before(counters.size()), after(counters.size()), deltas(counters.size(), 0.0);
+
+    for (int run = 0; run < warmup + reps; run++) {
+        std::memcpy(temp.data(), arr.data(), n * sizeof(double));
+        for (size_t c = 0; c < counters.size(); c++) before[c] = counters[c].read();
+
+        auto start = std::chrono::steady_clock::now();
+        sort(temp, aux);
+        auto stop = std::chrono::steady_clock::now();
+        // Read before any bookkeeping, which would count its own allocations
+        for (size_t c = 0; c < counters.size(); c++) after[c] = counters[c].read();
+
+        if (run >= warmup) {
+            samples.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+            for (size_t c = 0; c < counters.size(); c++) deltas[c] += (after[c] - before[c]) / reps;
+        }
+        if (!std::is_sorted(temp.begin(), temp.end())) {
+            std::cerr << "Sorting failed!" << std::endl;
+            std::exit(1);
+        }
+    }
+    if (counter_deltas) *counter_deltas = deltas;
+    return summarize(samples);
+}
+
+// Times run() `reps` times after `warmup` untimed runs, for engines whose data is not one
+// array of doubles: prepare() restores the input before every run and verify() checks the
+// output after it, both untimed.
+template <typename Prepare, typename Run, typename Verify>
+BenchStats measureRuns(int reps, int warmup, Prepare prepare, Run run, Verify verify) {
+    std::vector<double> samples;
+    for (int i = 0; i < warmup + reps; i++) {
+        prepare();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto stop = std::chrono::steady_clock::now();
+        if (i >= warmup) samples.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+        if (!verify()) {
+            std::cerr << "Sorting failed!" << std::endl;
+            std::exit(1);
+        }
+    }
+    return summarize(samples);
+}
+
+struct BenchResult {
+    std::string engine;
+    InputPattern input;
+    ptrdiff_t n;
+    int threads;
+    BenchStats stats;
+    std::vector<double> counters;   // Mean per-run deltas, in the order of the registered counters
+
+    double elementsPerSecond() const { return stats.median > 0 ? n / (stats.median / 1e3) : 0; }
+    double gbPerSecond() const { return stats.median > 0 ? n * sizeof(double) / (stats.median / 1e3) / 1e9 : 0; }
+};
+
+struct BenchOptions {
+    std::vector<ptrdiff_t> sizes = standardSizes();
+    bool large = false;   // Sizes come from largeSizes() for the selected engines
+    int reps = 10;
+    int warmup = 1;
+    std::vector<int> threads = {(int)WorkStealingPool::default_workers() + 1};
+    std::vector<InputPattern> inputs = {InputPattern::Uniform};
+    std::vector<std::string> engines;   // Empty: every engine registered by default
+    std::string csv_path, json_path;    // "-" writes to stdout instead of the text report
+    uint64_t seed = std::random_device{}();
+    bool list = false;
+};
+
+// Comma-separated list of items parsed by parse (which returns false on a bad item)
+template <typename T, typename Parse>
+bool parseList(const std::string& text, std::vector<T>& out, Parse parse) {
+    out.clear();
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        T value;
+        if (item.empty() || !parse(item, value)) return false;
+        out.push_back(value);
+    }
+    return !out.empty();
+}
+
+// Counts such as 1000, 1e6 or 2147483648
+inline bool parseCount(const std::string& text, ptrdiff_t& value) {
+    char* end = nullptr;
+    double d = std::strtod(text.c_str(), &end);
+    if (*end != '\0' || d < 1 || d != std::floor(d)) return false;
+    value = (ptrdiff_t)d;
+    return true;
+}
+
+inline void printBenchUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --sizes N,N,...|standard|large   array sizes (default standard: 1e3..1e8)\n"
+              << "  --reps R                        timed repetitions (default 10, 3 for large)\n"
+              << "  --warmup W                      untimed runs before the timed ones (default 1)\n"
+              << "  --threads T,T,...               total threads, the calling thread included (default all cores)\n"
+              << "  --inputs P,P,...|all            input patterns (default uniform)\n"
+              << "  --engines E,E,...               engines to run; a trailing * matches a prefix (default all)\n"
+              << "  --csv PATH, --json PATH         also write the results; - writes to stdout\n"
+              << "  --seed S                        input generator seed\n"
+              << "  --list                          list the engines and input patterns\n";
+}
+
+// Applies one option that takes a value; returns false for an unknown option or bad value
+inline bool applyBenchOption(const std::string& arg, const std::string& v, BenchOptions& opts) {
+    if (arg == "--sizes") {
+        opts.large = v == "large";
+        if (v == "standard" || v == "large") {
+            opts.sizes = standardSizes();
+            return true;
+        }
+        return parseList(v, opts.sizes, parseCount);
+    } else if (arg == "--reps") {
+        return (opts.reps = std::atoi(v.c_str())) > 0;
+    } else if (arg == "--warmup") {
+        return (opts.warmup = std::atoi(v.c_str())) >= 0;
+    } else if (arg == "--threads") {
+        return parseList(v, opts.threads, [](const std::string& s, int& t) { return (t = std::atoi(s.c_str())) > 0; });
+    } else if (arg == "--inputs") {
+        if (v == "all") {
+            opts.inputs = allInputPatterns();
+            return true;
+        }
+        return parseList(v, opts.inputs, parseInputPattern);
+    } else if (arg == "--engines") {
+        return parseList(v, opts.engines, [](const std::string& s, std::string& e) { e = s; return true; });
+    } else if (arg == "--csv") {
+        opts.csv_path = v;
+    } else if (arg == "--json") {
+        opts.json_path = v;
+    } else if (arg == "--seed") {
+        opts.seed = std::strtoull(v.c_str(), nullptr, 10);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parses the command line into opts; prints usage and returns false on an error or --help
+inline bool parseBenchOptions(int argc, char* argv[], BenchOptions& opts) {
+    bool reps_set = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--list") {
+            opts.list = true;
+            continue;
+        }
+        if (i + 1 >= argc || !applyBenchOption(arg, argv[i + 1], opts)) {
+            if (arg != "--help") std::cerr << "Bad or incomplete option " << arg << "\n";
+            printBenchUsage(argv[0]);
+            return false;
+        }
+        reps_set |= arg == "--reps";
+        i++;
+    }
+    if (opts.large && !reps_set) opts.reps = 3;   // Matches the old --large modes
+    return true;
+}
+
+inline bool engineSelected(const BenchEngine& engine, const std::vector<std::string>& names) {
+    if (names.empty()) return engine.by_default;
+    for (const std::string& name : names) {
+        if (name == engine.name) return true;
+        if (!name.empty() && name.back() == '*' && engine.name.compare(0, name.size() - 1, name, 0, name.size() - 1) == 0) return true;
+    }
+    return false;
+}
+
+inline void writeBenchCSV(std::ostream& out, const std::vector<BenchResult>& results, const std::vector<BenchCounter>& counters) {
+    out << "engine,input,n,threads,reps,min_ms,median_ms,p95_ms,mean_ms,stddev_ms,elements_per_sec,gb_per_sec";
+    for (const BenchCounter& c : counters) out << "," << c.name;
+    out << "\n";
+    for (const BenchResult& r : results) {
+        out << r.engine << "," << inputPatternName(r.input) << "," << r.n << "," << r.threads << "," << r.stats.reps << ","
+            << r.stats.min << "," << r.stats.median << "," << r.stats.p95 << "," << r.stats.mean << "," << r.stats.stddev << ","
+            << r.elementsPerSecond() << "," << r.gbPerSecond();
+        for (double c : r.counters) out << "," << c;
+        out << "\n";
+    }
+}
+
+inline std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+inline void writeBenchJSON(std::ostream& out, const std::vector<BenchResult>& results, const std::vector<BenchCounter>& counters,
+                           const BenchOptions& opts) {
+    out << "{\n  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n  \"seed\": " << opts.seed
+        << ",\n  \"warmup\": " << opts.warmup << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << "    {\"engine\": " << jsonString(r.engine) << ", \"input\": " << jsonString(inputPatternName(r.input))
+            << ", \"n\": " << r.n << ", \"threads\": " << r.threads << ", \"reps\": " << r.stats.reps
+            << ", \"min_ms\": " << r.stats.min << ", \"median_ms\": " << r.stats.median << ", \"p95_ms\": " << r.stats.p95
+            << ", \"mean_ms\": " << r.stats.mean << ", \"stddev_ms\": " << r.stats.stddev
+            << ", \"elements_per_sec\": " << r.elementsPerSecond() << ", \"gb_per_sec\": " << r.gbPerSecond();
+        for (size_t c = 0; c < counters.size(); c++) out << ", " << jsonString(counters[c].name) << ": " << r.counters[c];
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// One line of the text report
+inline void printBenchResult(const BenchResult& r, const std::vector<BenchCounter>& counters = {}) {
+    std::cout << "  " << r.engine << ": min " << r.stats.min << " ms, median " << r.stats.median
+              << " ms, p95 " << r.stats.p95 << " ms, stddev " << r.stats.stddev << " ms, "
+              << r.elementsPerSecond() / 1e6 << " M elements/s, " << r.gbPerSecond() << " GB/s";
+    for (size_t c = 0; c < counters.size() && c < r.counters.size(); c++) std::cout << ", " << counters[c].name << " " << r.counters[c];
+    std::cout << std::endl;
+}
+
+// Writes to path, or to stdout for "-"
+template <typename WriteFn>
+bool writeBenchFile(const std::string& path, WriteFn write) {
+    if (path == "-") {
+        write(std::cout);
+        return true;
+    }
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Cannot write " << path << "\n";
+        return false;
+    }
+    write(file);
+    return true;
+}
+
+// One configuration of BenchReport::run: the generated input, shared by every thread count
+// of its size, and a pool of threads - 1 workers (the calling thread is the last one).
+// gen is the report's generator, for drivers that draw more data per configuration.
+struct BenchConfig {
+    InputPattern input;
+    ptrdiff_t n;
+    int threads;
+    const std::vector<double>& arr;
+    WorkStealingPool& pool;
+    std::mt19937_64& gen;
+};
+
+// Results of one driver run, for drivers that time their own variants rather than
+// registered engines: walks the selected configurations, records and prints every result
+// and writes --csv / --json at the end. The text report is off while either file goes to
+// stdout. Counters are printed and written per result; those without a read function are
+// filled in by the driver.
+class BenchReport {
+public:
+    explicit BenchReport(const BenchOptions& opts, std::vector<BenchCounter> counters = {})
+        : opts_(opts), counters_(std::move(counters)), text_(opts.csv_path != "-" && opts.json_path != "-"), gen_(opts.seed) {}
+
+    const BenchOptions& options() const { return opts_; }
+    const std::vector<BenchCounter>& counters() const { return counters_; }
+    const std::vector<BenchResult>& results() const { return results_; }
+    bool text() const { return text_; }
+
+    // Whether a variant of this name was selected with --engines
+    bool selected(const std::string& name) const { return engineSelected({name, nullptr}, opts_.engines); }
+
+    // Calls body(input, n, threads) for every selected configuration, with a blank line of
+    // the text report after each
+    template <typename Body>
+    void forEach(Body body) {
+        for (InputPattern input : opts_.inputs) {
+            for (ptrdiff_t n : opts_.sizes) {
+                for (int threads : opts_.threads) {
+                    body(input, n, threads);
+                    if (text_) std::cout << std::endl;
+                }
+            }
+        }
+    }
+
+    // forEach with the input of every size from make_input(input, n, gen) (generateInput by
+    // default) and a pool per thread count: body(const BenchConfig&)
+    template <typename MakeInput, typename Body>
+    void run(MakeInput make_input, Body body) {
+        std::vector<double> arr;
+        InputPattern arr_input{};
+        ptrdiff_t arr_n = -1;
+        forEach([&](InputPattern input, ptrdiff_t n, int threads) {
+            if (input != arr_input || n != arr_n) {
+                arr = std::vector<double>();   // Free the last input before making the next
+                arr = make_input(input, n, gen_);
+                arr_input = input;
+                arr_n = n;
+            }
+            WorkStealingPool pool(threads - 1);
+            body(BenchConfig{input, n, threads, arr, pool, gen_});
+        });
+    }
+    template <typename Body>
+    void run(Body body) {
+        run([](InputPattern input, ptrdiff_t n, std::mt19937_64& gen) { return generateInput(n, input, gen); }, body);
+    }
+
+    // Adds a result and prints it; the driver may print more lines about it
+    const BenchResult& record(BenchResult r) {
+        results_.push_back(std::move(r));
+        if (text_) printBenchResult(results_.back(), counters_);
+        return results_.back();
+    }
+
+    // Writes the CSV and JSON files. Returns the process exit code: 1 if ok is false or a
+    // file cannot be written.
+    int finish(bool ok = true) const {
+        if (!opts_.csv_path.empty()) ok &= writeBenchFile(opts_.csv_path, [&](std::ostream& out) { writeBenchCSV(out, results_, counters_); });
+        if (!opts_.json_path.empty()) ok &= writeBenchFile(opts_.json_path, [&](std::ostream& out) { writeBenchJSON(out, results_, counters_, opts_); });
+        return ok ? 0 : 1;
+    }
+
+private:
+    BenchOptions opts_;
+    std::vector<BenchCounter> counters_;
+    bool text_;
+    std::mt19937_64 gen_;
+    std::vector<BenchResult> results_;
+};
+
+// Complete benchmark driver: parses the command line, runs every selected engine on every
+// selected configuration and reports the results, with page faults and extra_counters per
+// sort. Returns the process exit code.
+inline int benchMain(int argc, char* argv[], const std::vector<BenchEngine>& engines, const std::vector<BenchCounter>& extra_counters = {}) {
+    std::vector<BenchCounter> counters = {{"page_faults", pageFaults}};
+    counters.insert(counters.end(), extra_counters.begin(), extra_counters.end());
+    BenchOptions opts;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    std::vector<const BenchEngine*> selected;
+    for (const BenchEngine& e : engines) {
+        if (engineSelected(e, opts.engines)) selected.push_back(&e);
+    }
+    if (opts.list) {
+        for (const BenchEngine& e : engines) std::cout << e.name << (e.by_default ? "" : " (only when named)") << "\n";
+        std::cout << "inputs:";
+        for (InputPattern p : allInputPatterns()) std::cout << " " << inputPatternName(p);
+        std::cout << "\n";
+        return 0;
+    }
+    if (selected.empty()) {
+        std::cerr << "No engine matches --engines\n";
+        return 1;
+    }
+    if (opts.large) {
+        size_t bytes = 0;
+        for (const BenchEngine* e : selected) bytes = std::max(bytes, e->bytes_per_element);
+        std::vector<ptrdiff_t> skipped;
+        opts.sizes = largeSizes(bytes, &skipped);
+        for (ptrdiff_t n : skipped) {
+            std::cerr << "Skipping large size " << n << ": needs " << (double)n * bytes / 1e9 << " GB ("
+                      << bytes << " bytes per element), physical memory is " << physicalMemory() / 1e9 << " GB\n";
+        }
+        if (opts.sizes.empty()) {
+            std::cerr << "No large size fits in memory\n";
+            return 1;
+        }
+    }
+
+    BenchReport report(opts, counters);
+    report.run([&](const BenchConfig& cfg) {
+        BenchContext ctx{cfg.pool, cfg.threads};
+        if (report.text()) std::cout << "Sorting " << cfg.n << " " << inputPatternName(cfg.input) << " elements with " << cfg.threads << " threads..." << std::endl;
+
+        const BenchEngine* fastest = nullptr;
+        double fastest_ms = 0;
+        for (const BenchEngine* e : selected) {
+            BenchResult r{e->name, cfg.input, cfg.n, cfg.threads, {}, {}};
+            r.stats = measureSort(cfg.arr, opts.reps, opts.warmup,
+                                  [&](std::vector<double>& a, std::vector<double>& b) { e->sort(a, b, ctx); },
+                                  counters, &r.counters);
+            if (!fastest || r.stats.median < fastest_ms) {
+                fastest = e;
+                fastest_ms = r.stats.median;
+            }
+            report.record(r);
+        }
+        if (report.text() && selected.size() > 1) std::cout << "  Fastest: " << fastest->name << "\n";
+    });
+    return report.finish();
+}
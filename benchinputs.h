@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Input distributions for the benchmarks. Uniform is the original dist(gen) input; the
+// others exercise presortedness (and duplicates) the way real inputs often do.
+enum class InputPattern { Uniform, Sorted, Reverse, NearlySorted, SortedTail, Sawtooth, FewUnique };
+
+inline const std::vector<InputPattern>& allInputPatterns() {
+    static const std::vector<InputPattern> patterns = {InputPattern::Uniform,      InputPattern::Sorted,
+                                                       InputPattern::Reverse,      InputPattern::NearlySorted,
+                                                       InputPattern::SortedTail,   InputPattern::Sawtooth,
+                                                       InputPattern::FewUnique};
+    return patterns;
+}
+
+inline const char* inputPatternName(InputPattern pattern) {
+    switch (pattern) {
+        case InputPattern::Uniform: return "uniform";
+        case InputPattern::Sorted: return "sorted";
+        case InputPattern::Reverse: return "reverse";
+        case InputPattern::NearlySorted: return "nearly-sorted";
+        case InputPattern::SortedTail: return "sorted-tail";
+        case InputPattern::Sawtooth: return "sawtooth";
+        case InputPattern::FewUnique: return "few-unique";
+    }
+    return "?";
+}
+
+// Pattern with the given name; returns false for an unknown name
+inline bool parseInputPattern(const std::string& name, InputPattern& pattern) {
+    for (InputPattern p : allInputPatterns()) {
+        if (name == inputPatternName(p)) {
+            pattern = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr double NEARLY_SORTED_SWAPS = 0.01;   // Fraction of elements moved by random swaps
+constexpr double SORTED_TAIL_FRACTION = 0.05;  // Unsorted tail appended to a sorted prefix
+constexpr int SAWTOOTH_TEETH = 64;             // Ascending ramps in a sawtooth input
+constexpr int FEW_UNIQUE_VALUES = 16;
+
+// n doubles in [0, 1) following the pattern
+template <typename Gen>
+std::vector<double> generateInput(ptrdiff_t n, InputPattern pattern, Gen& gen) {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::vector<double> arr(n);
+    for (ptrdiff_t i = 0; i < n; i++) {
+        arr[i] = dist(gen);
+    }
+
+    switch (pattern) {
+        case InputPattern::Uniform:
+            break;
+        case InputPattern::Sorted:
+            std::sort(arr.begin(), arr.end());
+            break;
+        case InputPattern::Reverse:
+            std::sort(arr.begin(), arr.end(), std::greater<double>());
+            break;
+        case InputPattern::NearlySorted: {
+            std::sort(arr.begin(), arr.end());
+            std::uniform_int_distribution<ptrdiff_t> index(0, std::max<ptrdiff_t>(0, n - 1));
+            for (ptrdiff_t s = 0; s < (ptrdiff_t)(n * NEARLY_SORTED_SWAPS / 2); s++) std::swap(arr[index(gen)], arr[index(gen)]);
+            break;
+        }
+        case InputPattern::SortedTail:
+            std::sort(arr.begin(), arr.end() - (ptrdiff_t)(n * SORTED_TAIL_FRACTION));
+            break;
+        case InputPattern::Sawtooth:
+            for (int t = 0; t < SAWTOOTH_TEETH; t++) {
+                std::sort(arr.begin() + n * t / SAWTOOTH_TEETH, arr.begin() + n * (t + 1) / SAWTOOTH_TEETH);
+            }
+            break;
+        case InputPattern::FewUnique:
+            for (double& x : arr) x = (int)(x * FEW_UNIQUE_VALUES) / (double)FEW_UNIQUE_VALUES;
+            break;
+    }
+    return arr;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <unistd.h>
+
+// Array sizes of the standard benchmark tier
+inline std::vector<ptrdiff_t> standardSizes() {
+    return {1000, 10000, 100000, 1000000, 10000000, 100000000};
+}
+
+// Physical memory of the machine in bytes
+inline size_t physicalMemory() {
+    return (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE);
+}
+
+// Large tier for 64-bit index paths: from 1e9 to past 2^31 and up to 8e9 elements.
+// Sizes whose working set (n * bytes_per_element) does not fit in physical memory are left
+// out, and appended to skipped when it is given.
+inline std::vector<ptrdiff_t> largeSizes(size_t bytes_per_element, std::vector<ptrdiff_t>* skipped = nullptr) {
+    const size_t memory = physicalMemory();
+    std::vector<ptrdiff_t> sizes;
+    for (ptrdiff_t n : {1000000000LL, (1LL << 31) + (1LL << 20), 4000000000LL, 8000000000LL}) {
+        if ((size_t)n * bytes_per_element <= memory) sizes.push_back(n);
+        else if (skipped) skipped->push_back(n);
+    }
+    return sizes;
+}
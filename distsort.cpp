@@ -0,0 +1,130 @@
+// Distributed sample sort over forked rank processes on one box, e.g.
+//   distsort --sizes 1e8 --threads 1,4 --engines 'distributed/shm*'
+// The sizes are the total over all ranks, --threads is the pool size of every rank, and
+// every engine runs with 1, 2, 4 and 8 ranks. Each rank generates its part of the input;
+// rank 0 (this process) reports the median sort time (the slowest rank's), exchange
+// volume and skew, then every rank's elements, traffic and phase times (means over reps).
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "distsort.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    opts.sizes = {10000000, 100000000};
+    opts.threads = {1};
+    opts.reps = 5;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    const vector<int> rank_counts = {1, 2, 4, 8};
+    const vector<string> transports = {"distributed/shm", "distributed/socket"};
+    constexpr size_t SHM_AREA = 1 << 20;   // Doubles each rank sends per shared-memory round
+    if (opts.list) {
+        for (const string& t : transports) cout << t << endl;
+        return 0;
+    }
+
+    BenchReport report(opts, {{"exchange_bytes", nullptr}, {"skew", nullptr}});
+    const string tag = "psort-" + to_string(getpid());
+    int config = 0;
+    bool ok = true;
+
+    // No pool or input here: every rank makes its own
+    report.forEach([&](InputPattern input, ptrdiff_t n, int threads) {
+        for (int ranks : rank_counts) {
+            for (const string& transport : transports) {
+                if (!report.selected(transport)) continue;
+                const bool shm = transport == "distributed/shm";
+                const string name = "/" + tag;
+                const string prefix = "/tmp/" + tag + "-" + to_string(config++) + "-";
+                if (report.text()) cout << "Sorting " << n << " " << inputPatternName(input) << " elements on " << ranks << " ranks of " << threads
+                                        << " threads (" << transport << ")..." << endl;
+                if (shm) ShmTransport::create(name, ranks, SHM_AREA);
+
+                ok &= launchRanks(ranks, [&](int rank) {
+                    unique_ptr<Transport> link;
+                    if (shm) link = make_unique<ShmTransport>(name, rank);
+                    else link = make_unique<SocketTransport>(prefix, rank, ranks);
+                    WorkStealingPool pool(threads - 1);
+                    DistributedSortOptions sort_opts;
+                    sort_opts.pool = &pool;
+
+                    mt19937_64 gen(opts.seed + rank);
+                    const vector<double> part = generateInput(n * (rank + 1) / ranks - n * rank / ranks, input, gen);
+                    vector<double> work;
+                    vector<double> wall_ms;
+                    vector<vector<double>> rank_sums;   // At rank 0: per-rank sums of the packed stats
+                    size_t exchanged = 0;
+                    double skew = 0;
+                    for (int r = 0; r < opts.warmup + opts.reps; r++) {
+                        work = part;
+                        barrier(*link);
+                        DistributedSortStats stats = distributedSort(work, *link, sort_opts);
+                        const vector<double> packed = {(double)stats.elements_in, (double)stats.elements_out, (double)stats.bytes_sent,
+                                                       (double)stats.bytes_received, stats.local_sort_seconds, stats.splitter_seconds,
+                                                       stats.exchange_seconds, stats.merge_seconds, stats.total_seconds,
+                                                       (double)is_sorted(work.begin(), work.end()), work.empty() ? 0 : work.front(),
+                                                       work.empty() ? 0 : work.back()};
+                        vector<vector<double>> all = gatherToRoot(*link, packed);
+
+                        // Every part sorted, parts in order, nothing lost. Rank 0 checks and
+                        // tells every rank, so all of them stop together on a failure.
+                        double in = 0, out = 0, slowest = 0, largest = 0, previous = -numeric_limits<double>::infinity();
+                        size_t sent = 0;
+                        for (const vector<double>& s : all) {
+                            if (rank != 0) break;   // The other ranks received nothing
+                            in += s[0];
+                            out += s[1];
+                            sent += (size_t)s[2];
+                            slowest = max(slowest, s[8]);
+                            largest = max(largest, s[1]);
+                            if (s[9] != 1 || (s[1] > 0 && s[10] < previous)) out = -1;
+                            if (s[1] > 0) previous = s[11];
+                        }
+                        if (broadcastFromRoot(*link, {(double)(out == in)})[0] != 1) {
+                            if (rank == 0) cerr << "Sorting failed!" << endl;
+                            return 1;
+                        }
+                        if (rank != 0 || r < opts.warmup) continue;
+                        wall_ms.push_back(slowest * 1e3);
+                        exchanged += sent / opts.reps;
+                        skew = out > 0 ? largest / (out / ranks) : 1;
+                        rank_sums.resize(ranks, vector<double>(9, 0));
+                        for (int k = 0; k < ranks; k++) {
+                            for (int f = 0; f < 9; f++) rank_sums[k][f] += all[k][f] / opts.reps;
+                        }
+                    }
+                    if (rank != 0) return 0;
+
+                    // skew is the largest part over the mean
+                    report.record({transport + " ranks=" + to_string(ranks), input, n, threads, summarize(wall_ms), {(double)exchanged, skew}});
+                    if (report.text()) {
+                        cout << "    rank  elements in  elements out  sent MB  recv MB  sort ms  splitters ms  exchange ms  merge ms  total ms" << endl;
+                        cout << fixed << setprecision(2);
+                        for (int k = 0; k < ranks; k++) {
+                            const vector<double>& s = rank_sums[k];
+                            cout << "    " << setw(4) << k << setw(13) << (size_t)s[0] << setw(14) << (size_t)s[1] << setw(9) << s[2] / 1e6 << setw(9)
+                                 << s[3] / 1e6 << setw(9) << s[4] * 1e3 << setw(14) << s[5] * 1e3 << setw(13) << s[6] * 1e3 << setw(10) << s[7] * 1e3
+                                 << setw(10) << s[8] * 1e3 << endl;
+                        }
+                        cout << defaultfloat << setprecision(6);
+                    }
+                    return 0;
+                });
+                if (shm) ShmTransport::remove(name);
+            }
+        }
+    });
+
+    if (!ok) cerr << "A rank failed" << endl;
+    return report.finish(ok);
+}
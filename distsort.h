@@ -0,0 +1,527 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "threadpool.h"
+#include "mergesorttk.h"
+#include "kwaymerge.h"
+#include "tuning.h"
+
+// Distributed sample sort over ranks (processes) that each hold part of the data:
+//   1. every rank sorts its part with the hybrid mergeSort,
+//   2. every rank sends regular samples of its sorted part to all ranks, and all ranks
+//      pick the same p - 1 splitters from the sorted samples,
+//   3. the sorted part is cut at the splitters (keys equal to a splitter are shared by
+//      the ranks it separates, so duplicates do not pile up on one rank) and the pieces
+//      are exchanged all-to-all,
+//   4. every rank merges the p sorted pieces it received with the parallel k-way merge.
+// Afterwards rank r holds a sorted part and every key on rank r is <= every key on
+// rank r + 1. Ranks talk through a Transport; shared memory and Unix-domain sockets are
+// provided so the whole sort runs on one Linux box, and launchRanks forks the ranks.
+
+// Doubles to send to one rank
+struct Block {
+    const double* data;
+    size_t count;
+};
+
+class Transport {
+public:
+    virtual ~Transport() = default;
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+
+    // Collective all-to-all: send[r] goes to rank r and recv[r] is replaced by what rank
+    // r sent here. Every rank calls it with size() blocks.
+    virtual void allToAll(const std::vector<Block>& send, std::vector<std::vector<double>>& recv) = 0;
+};
+
+namespace distributed {
+
+// Shared segment: header, per-rank "more to send" flags, the counts[from][to] of the
+// current round, then one send area of `capacity` doubles per rank
+struct ShmHeader {
+    pthread_barrier_t barrier;
+    int ranks;
+    size_t capacity;
+};
+
+inline size_t alignUp(size_t bytes) { return (bytes + 63) & ~size_t(63); }
+inline size_t shmFlagsOffset() { return alignUp(sizeof(ShmHeader)); }
+inline size_t shmCountsOffset(int ranks) { return shmFlagsOffset() + alignUp(ranks * sizeof(int)); }
+inline size_t shmAreasOffset(int ranks) { return shmCountsOffset(ranks) + alignUp((size_t)ranks * ranks * sizeof(size_t)); }
+inline size_t shmBytes(int ranks, size_t capacity) { return shmAreasOffset(ranks) + (size_t)ranks * capacity * sizeof(double); }
+
+inline void readAll(int fd, void* buf, size_t bytes) {
+    char* p = static_cast<char*>(buf);
+    while (bytes > 0) {
+        ssize_t got = read(fd, p, bytes);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) throw std::system_error(errno, std::generic_category(), "read");
+        if (got == 0) throw std::runtime_error("peer closed the connection");
+        p += got;
+        bytes -= got;
+    }
+}
+
+inline void writeAll(int fd, const void* buf, size_t bytes) {
+    const char* p = static_cast<const char*>(buf);
+    while (bytes > 0) {
+        ssize_t put = write(fd, p, bytes);
+        if (put < 0 && errno == EINTR) continue;
+        if (put < 0) throw std::system_error(errno, std::generic_category(), "write");
+        p += put;
+        bytes -= put;
+    }
+}
+
+inline sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::invalid_argument("socket path too long: " + path);
+    std::strcpy(addr.sun_path, path.c_str());
+    return addr;
+}
+
+}  // namespace distributed
+
+// POSIX shared memory transport. One process creates the segment before the ranks
+// attach to it by name. An all-to-all runs in rounds: every rank copies as much of its
+// outgoing data as fits into its own send area and publishes the counts, a process-shared
+// barrier, every rank copies its pieces out of the other areas, a second barrier. Large
+// exchanges take several rounds, so the segment size is independent of the data size.
+class ShmTransport : public Transport {
+public:
+    // Creates segment `name` (e.g. "/psort") for `ranks` ranks with send areas of
+    // `capacity` doubles each
+    static void create(const std::string& name, int ranks, size_t capacity) {
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+        const size_t bytes = distributed::shmBytes(ranks, capacity);
+        if (ftruncate(fd, bytes) != 0) {
+            int err = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::system_error(err, std::generic_category(), "ftruncate " + name);
+        }
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            throw std::system_error(errno, std::generic_category(), "mmap " + name);
+        }
+        auto* header = static_cast<distributed::ShmHeader*>(p);
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_barrier_init(&header->barrier, &attr, ranks);
+        pthread_barrierattr_destroy(&attr);
+        header->ranks = ranks;
+        header->capacity = capacity;
+        munmap(p, bytes);
+    }
+
+    // Removes the segment name; attached ranks keep their mappings
+    static void remove(const std::string& name) { shm_unlink(name.c_str()); }
+
+    ShmTransport(const std::string& name, int rank) : rank_(rank) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            int err = errno;
+            close(fd);
+            throw std::system_error(err, std::generic_category(), "fstat " + name);
+        }
+        bytes_ = st.st_size;
+        base_ = static_cast<char*>(mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        close(fd);
+        if (base_ == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap " + name);
+        header_ = reinterpret_cast<distributed::ShmHeader*>(base_);
+        ranks_ = header_->ranks;
+        capacity_ = header_->capacity;
+        if (rank < 0 || rank >= ranks_) {
+            munmap(base_, bytes_);
+            throw std::invalid_argument("rank out of range");
+        }
+        more_ = reinterpret_cast<int*>(base_ + distributed::shmFlagsOffset());
+        counts_ = reinterpret_cast<size_t*>(base_ + distributed::shmCountsOffset(ranks_));
+        areas_ = reinterpret_cast<double*>(base_ + distributed::shmAreasOffset(ranks_));
+    }
+
+    ~ShmTransport() override { munmap(base_, bytes_); }
+
+    ShmTransport(const ShmTransport&) = delete;
+    ShmTransport& operator=(const ShmTransport&) = delete;
+
+    int rank() const override { return rank_; }
+    int size() const override { return ranks_; }
+
+    void allToAll(const std::vector<Block>& send, std::vector<std::vector<double>>& recv) override {
+        const int p = ranks_, me = rank_;
+        recv.assign(p, {});
+        recv[me].assign(send[me].data, send[me].data + send[me].count);
+        std::vector<size_t> sent(p, 0);
+        double* mine = areas_ + (size_t)me * capacity_;
+        while (true) {
+            size_t used = 0;
+            bool more = false;
+            for (int d = 0; d < p; d++) {
+                size_t take = 0;
+                if (d != me) {
+                    take = std::min(send[d].count - sent[d], capacity_ - used);
+                    if (take > 0) std::memcpy(mine + used, send[d].data + sent[d], take * sizeof(double));
+                    sent[d] += take;
+                    more |= sent[d] < send[d].count;
+                }
+                counts_[(size_t)me * p + d] = take;
+                used += take;
+            }
+            more_[me] = more;
+            barrier();
+
+            bool any = false;
+            for (int s = 0; s < p; s++) {
+                any |= more_[s] != 0;
+                if (s == me) continue;
+                const size_t* row = counts_ + (size_t)s * p;
+                size_t offset = 0;
+                for (int d = 0; d < me; d++) offset += row[d];
+                const double* from = areas_ + (size_t)s * capacity_ + offset;
+                recv[s].insert(recv[s].end(), from, from + row[me]);
+            }
+            barrier();   // Areas and flags may be rewritten
+            if (!any) break;
+        }
+    }
+
+private:
+    void barrier() {
+        int rc = pthread_barrier_wait(&header_->barrier);
+        if (rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD) throw std::system_error(rc, std::generic_category(), "pthread_barrier_wait");
+    }
+
+    int rank_, ranks_ = 0;
+    size_t capacity_ = 0, bytes_ = 0;
+    char* base_ = nullptr;
+    distributed::ShmHeader* header_ = nullptr;
+    int* more_ = nullptr;
+    size_t* counts_ = nullptr;
+    double* areas_ = nullptr;
+};
+
+// Unix-domain socket transport: a full mesh of stream connections. Rank r listens on
+// `<prefix><r>.sock`, connects to every lower rank and accepts every higher one. An
+// all-to-all sends to every peer from its own thread (count, then data) while the
+// calling thread receives, so large messages cannot deadlock.
+class SocketTransport : public Transport {
+public:
+    SocketTransport(const std::string& prefix, int rank, int ranks) : rank_(rank), ranks_(ranks), peers_(ranks, -1) {
+        using distributed::socketAddress;
+        const std::string path = prefix + std::to_string(rank) + ".sock";
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) throw std::system_error(errno, std::generic_category(), "socket");
+        sockaddr_un addr = socketAddress(path);
+        unlink(path.c_str());
+        if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, ranks) != 0) {
+            int err = errno;
+            close(listener);
+            throw std::system_error(err, std::generic_category(), "listen " + path);
+        }
+
+        try {
+            // Lower ranks may not be listening yet: retry for up to CONNECT_TIMEOUT
+            for (int s = 0; s < rank; s++) {
+                sockaddr_un to = socketAddress(prefix + std::to_string(s) + ".sock");
+                auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+                while (true) {
+                    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                    if (fd < 0) throw std::system_error(errno, std::generic_category(), "socket");
+                    if (connect(fd, (sockaddr*)&to, sizeof(to)) == 0) {
+                        peers_[s] = fd;
+                        break;
+                    }
+                    int err = errno;
+                    close(fd);
+                    if ((err != ENOENT && err != ECONNREFUSED) || std::chrono::steady_clock::now() > deadline) {
+                        throw std::system_error(err, std::generic_category(), std::string("connect ") + to.sun_path);
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                int32_t id = rank;
+                distributed::writeAll(peers_[s], &id, sizeof(id));
+            }
+            for (int accepted = rank + 1; accepted < ranks; accepted++) {
+                int fd = accept(listener, nullptr, nullptr);
+                if (fd < 0 && errno == EINTR) {
+                    accepted--;
+                    continue;
+                }
+                if (fd < 0) throw std::system_error(errno, std::generic_category(), "accept");
+                int32_t id = -1;
+                distributed::readAll(fd, &id, sizeof(id));
+                if (id <= rank || id >= ranks || peers_[id] >= 0) {
+                    close(fd);
+                    throw std::runtime_error("unexpected peer rank " + std::to_string(id));
+                }
+                peers_[id] = fd;
+            }
+        } catch (...) {
+            close(listener);
+            unlink(path.c_str());
+            closePeers();
+            throw;
+        }
+        close(listener);
+        unlink(path.c_str());
+    }
+
+    ~SocketTransport() override { closePeers(); }
+
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+
+    int rank() const override { return rank_; }
+    int size() const override { return ranks_; }
+
+    void allToAll(const std::vector<Block>& send, std::vector<std::vector<double>>& recv) override {
+        const int p = ranks_, me = rank_;
+        recv.assign(p, {});
+        recv[me].assign(send[me].data, send[me].data + send[me].count);
+
+        std::vector<std::exception_ptr> errors(p);
+        std::vector<std::thread> senders;
+        for (int d = 0; d < p; d++) {
+            if (d == me) continue;
+            senders.emplace_back([&, d] {
+                try {
+                    uint64_t count = send[d].count;
+                    distributed::writeAll(peers_[d], &count, sizeof(count));
+                    if (count > 0) distributed::writeAll(peers_[d], send[d].data, count * sizeof(double));
+                } catch (...) {
+                    errors[d] = std::current_exception();
+                }
+            });
+        }
+        std::exception_ptr error;
+        try {
+            for (int s = 0; s < p; s++) {
+                if (s == me) continue;
+                uint64_t count = 0;
+                distributed::readAll(peers_[s], &count, sizeof(count));
+                recv[s].resize(count);
+                if (count > 0) distributed::readAll(peers_[s], recv[s].data(), count * sizeof(double));
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (std::thread& t : senders) t.join();
+        if (error) std::rethrow_exception(error);
+        for (const std::exception_ptr& e : errors) {
+            if (e) std::rethrow_exception(e);
+        }
+    }
+
+    static constexpr std::chrono::seconds CONNECT_TIMEOUT{10};
+
+private:
+    void closePeers() {
+        for (int& fd : peers_) {
+            if (fd >= 0) close(fd);
+            fd = -1;
+        }
+    }
+
+    int rank_, ranks_;
+    std::vector<int> peers_;   // Connected socket per rank (-1 for this rank)
+};
+
+// Every rank's values, at rank 0 (empty elsewhere)
+inline std::vector<std::vector<double>> gatherToRoot(Transport& transport, const std::vector<double>& values) {
+    std::vector<Block> send(transport.size(), Block{nullptr, 0});
+    send[0] = {values.data(), values.size()};
+    std::vector<std::vector<double>> recv;
+    transport.allToAll(send, recv);
+    return recv;
+}
+
+// Rank 0's values, at every rank
+inline std::vector<double> broadcastFromRoot(Transport& transport, const std::vector<double>& values) {
+    std::vector<Block> send(transport.size(), Block{nullptr, 0});
+    if (transport.rank() == 0) std::fill(send.begin(), send.end(), Block{values.data(), values.size()});
+    std::vector<std::vector<double>> recv;
+    transport.allToAll(send, recv);
+    return recv[0];
+}
+
+// Returns once every rank has called it
+inline void barrier(Transport& transport) {
+    std::vector<std::vector<double>> recv;
+    transport.allToAll(std::vector<Block>(transport.size(), Block{nullptr, 0}), recv);
+}
+
+struct DistributedSortOptions {
+    WorkStealingPool* pool = nullptr;   // nullptr = WorkStealingPool::instance()
+    int k = 0;                          // Leaf size of the local sort; 0 = tunedProfile().k
+    int oversample = 32;                // Samples per rank for each splitter
+};
+
+// One rank's view of a distributed sort
+struct DistributedSortStats {
+    size_t elements_in = 0, elements_out = 0;
+    size_t bytes_sent = 0, bytes_received = 0;   // To and from the other ranks
+    double local_sort_seconds = 0, splitter_seconds = 0, exchange_seconds = 0, merge_seconds = 0, total_seconds = 0;
+};
+
+// Sorts the data of all ranks: collective, every rank passes its part and gets back its
+// part of the global order
+inline DistributedSortStats distributedSort(std::vector<double>& data, Transport& transport, const DistributedSortOptions& opts = {}) {
+    WorkStealingPool& pool = opts.pool ? *opts.pool : WorkStealingPool::instance();
+    const int p = transport.size(), me = transport.rank();
+    const ptrdiff_t n = data.size();
+    DistributedSortStats stats;
+    stats.elements_in = n;
+    auto since = [](std::chrono::steady_clock::time_point t) { return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count(); };
+    const auto start = std::chrono::steady_clock::now();
+
+    // 1. Local sort
+    auto phase = std::chrono::steady_clock::now();
+    if (n > 1) {
+        std::vector<double> aux(n);
+        const TuningProfile& profile = tunedProfile();
+        mergeSort(data, aux, 0, n - 1, opts.k ? opts.k : profile.k, profile.minThreadSize(n, pool.size() + 1), pool, networkSort);
+    }
+    stats.local_sort_seconds = since(phase);
+    if (p == 1) {
+        stats.elements_out = n;
+        stats.total_seconds = since(start);
+        return stats;
+    }
+
+    // 2. Regular samples of every sorted part, gathered everywhere; splitter j is the
+    // sample at rank (j + 1) / p of all samples
+    phase = std::chrono::steady_clock::now();
+    const ptrdiff_t per_rank = n > 0 ? (ptrdiff_t)opts.oversample * (p - 1) : 0;
+    std::vector<double> samples(per_rank);
+    for (ptrdiff_t i = 0; i < per_rank; i++) samples[i] = data[(2 * i + 1) * n / (2 * per_rank)];
+    std::vector<std::vector<double>> gathered;
+    transport.allToAll(std::vector<Block>(p, Block{samples.data(), samples.size()}), gathered);
+    std::vector<double> all;
+    for (const std::vector<double>& s : gathered) all.insert(all.end(), s.begin(), s.end());
+    std::sort(all.begin(), all.end());
+    std::vector<double> splitters(p - 1);
+    for (int j = 0; j < p - 1 && !all.empty(); j++) splitters[j] = all[(j + 1) * all.size() / p];
+
+    // 3. Cut points. Keys equal to splitter j are cut in the proportion its sample
+    // rank falls inside the samples equal to it, so heavy duplicates spread over ranks.
+    std::vector<ptrdiff_t> cut(p + 1, 0);
+    cut[p] = n;
+    const ptrdiff_t total_samples = all.size();
+    for (int j = 0; j < p - 1 && !all.empty(); j++) {
+        const ptrdiff_t q = (j + 1) * total_samples / p;
+        const ptrdiff_t below = std::lower_bound(all.begin(), all.end(), splitters[j]) - all.begin();
+        const ptrdiff_t equal = std::upper_bound(all.begin(), all.end(), splitters[j]) - all.begin() - below;
+        const ptrdiff_t lo = std::lower_bound(data.begin(), data.end(), splitters[j]) - data.begin();
+        const ptrdiff_t hi = std::upper_bound(data.begin(), data.end(), splitters[j]) - data.begin();
+        cut[j + 1] = lo + (hi - lo) * (q - below) / equal;
+    }
+    if (all.empty()) std::fill(cut.begin() + 1, cut.end(), n);
+    stats.splitter_seconds = since(phase);
+
+    phase = std::chrono::steady_clock::now();
+    std::vector<Block> send(p);
+    for (int r = 0; r < p; r++) {
+        send[r] = {data.data() + cut[r], (size_t)(cut[r + 1] - cut[r])};
+        if (r != me) stats.bytes_sent += send[r].count * sizeof(double);
+    }
+    std::vector<std::vector<double>> received;
+    transport.allToAll(send, received);
+    for (int r = 0; r < p; r++) {
+        if (r != me) stats.bytes_received += received[r].size() * sizeof(double);
+    }
+    stats.exchange_seconds = since(phase);
+
+    // 4. Merge the sorted pieces
+    phase = std::chrono::steady_clock::now();
+    std::vector<SortedRun> runs;
+    for (const std::vector<double>& piece : received) runs.push_back({piece.data(), piece.data() + piece.size()});
+    std::vector<double> merged(totalSize(runs.data(), p));
+    parallelKWayMerge(runs.data(), p, merged.data(), pool);
+    data.swap(merged);
+    stats.merge_seconds = since(phase);
+
+    stats.elements_out = data.size();
+    stats.total_seconds = since(start);
+    return stats;
+}
+
+// Runs fn(rank) for ranks 1..ranks-1 in forked child processes and fn(0) in the calling
+// process; true when fn(0) returned 0 and every child exited with status 0. When fn(0)
+// fails (throws or returns non-zero) the children are terminated, as they may be blocked
+// in a collective rank 0 left. Fork before the caller starts threads (pools, OpenMP) that
+// the children would not need.
+inline bool launchRanks(int ranks, const std::function<int(int rank)>& fn) {
+    std::cout.flush();
+    std::cerr.flush();
+    std::vector<pid_t> children;
+    for (int r = 1; r < ranks; r++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            int err = errno;
+            for (pid_t child : children) kill(child, SIGTERM);
+            for (pid_t child : children) waitpid(child, nullptr, 0);
+            throw std::system_error(err, std::generic_category(), "fork");
+        }
+        if (pid == 0) {
+            int status = 1;
+            try {
+                status = fn(r);
+            } catch (const std::exception& e) {
+                std::cerr << "rank " << r << ": " << e.what() << std::endl;
+            }
+            std::cout.flush();
+            _exit(status);
+        }
+        children.push_back(pid);
+    }
+
+    int status = 1;
+    try {
+        status = fn(0);
+    } catch (...) {
+        for (pid_t child : children) kill(child, SIGTERM);
+        for (pid_t child : children) waitpid(child, nullptr, 0);
+        throw;
+    }
+    bool ok = status == 0;
+    if (!ok) {
+        for (pid_t child : children) kill(child, SIGTERM);
+    }
+    for (pid_t child : children) {
+        int child_status = 0;
+        if (waitpid(child, &child_status, 0) < 0 || !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0) ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <string>
+#include "extsort.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Writes n uniform random doubles to path in 8 MB blocks
+void generateFile(const string& path, size_t n) {
+    random_device rd;
+    mt19937_64 gen(rd());
+    uniform_real_distribution<double> dist(0.0, 1.0);
+
+    external::File out = external::openFile(path, O_WRONLY | O_CREAT | O_TRUNC);
+    vector<double> block(1 << 20);
+    for (size_t done = 0; done < n; done += block.size()) {
+        size_t count = min(block.size(), n - done);
+        for (size_t i = 0; i < count; i++) block[i] = dist(gen);
+        external::writeFully(out.fd(), block.data(), count * sizeof(double), done * sizeof(double));
+    }
+}
+
+// Streams path and checks that it holds `expected` doubles in non-decreasing order
+bool verifyFile(const string& path, size_t expected) {
+    external::File in = external::openFile(path, O_RDONLY);
+    vector<double> block(1 << 20);
+    double last = -numeric_limits<double>::infinity();
+    size_t done = 0;
+    while (done < expected) {
+        size_t count = min(block.size(), expected - done);
+        external::readFully(in.fd(), block.data(), count * sizeof(double), done * sizeof(double));
+        if (block[0] < last || !is_sorted(block.begin(), block.begin() + count)) return false;
+        last = block[count - 1];
+        done += count;
+    }
+    struct stat st;
+    return fstat(in.fd(), &st) == 0 && (size_t)st.st_size == expected * sizeof(double);
+}
+
+void printPhase(const string& name, const ExternalPhaseStats& phase) {
+    cout << "  " << name << ": " << phase.seconds * 1e3 << " ms, read " << phase.bytes_read / 1e6 << " MB ("
+         << phase.readMBps() << " MB/s), wrote " << phase.bytes_written / 1e6 << " MB (" << phase.writeMBps() << " MB/s)\n";
+}
+
+int main(int argc, char* argv[]) {
+    // extsort <input> <output> [--memory-mb M] [--temp-dir D] [--k K]   sort a binary file of doubles
+    // extsort --generate <count> <file>                                  write random doubles
+    // extsort                                                            benchmark: 1e6..1e9 doubles with a 256 MB budget
+    ExternalSortOptions opts;
+    vector<string> positional;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--memory-mb" && i + 1 < argc) opts.memory_budget = stoull(argv[++i]) << 20;
+        else if (arg == "--temp-dir" && i + 1 < argc) opts.temp_dir = argv[++i];
+        else if (arg == "--k" && i + 1 < argc) opts.k = stoi(argv[++i]);
+        else positional.push_back(arg);
+    }
+
+    if (positional.size() == 3 && positional[0] == "--generate") {
+        generateFile(positional[2], stoull(positional[1]));
+        return 0;
+    }
+    if (positional.size() == 2) {
+        ExternalSortStats stats;
+        try {
+            externalSort(positional[0], positional[1], opts, &stats);
+        } catch (const exception& e) {
+            cerr << "extsort: " << e.what() << endl;
+            return 1;
+        }
+        cout << stats.num_runs << " runs, fan-in " << stats.fan_in << ", " << stats.merge_passes << " merge passes\n";
+        printPhase("run formation", stats.run_formation);
+        printPhase("merge", stats.merge);
+        return 0;
+    }
+
+    opts.memory_budget = size_t(256) << 20;
+    vector<size_t> sizes = {1000000, 10000000, 100000000, 1000000000}; // 8 MB to 8 GB of doubles
+    string input = opts.temp_dir + "/extsort-input.bin", output = opts.temp_dir + "/extsort-output.bin";
+
+    for (size_t n : sizes) {
+        generateFile(input, n);
+        cout << "Sorting " << n << " doubles (" << n * sizeof(double) / 1e6 << " MB) with a "
+             << (opts.memory_budget >> 20) << " MB budget..." << endl;
+
+        ExternalSortStats stats;
+        auto start = high_resolution_clock::now();
+        externalSort(input, output, opts, &stats);
+        double total = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count() / 1e6;
+        if (!verifyFile(output, n)) {
+            cerr << "Sorting failed!" << endl;
+            exit(1);
+        }
+
+        cout << "Total: " << total << " ms, " << stats.num_runs << " runs, fan-in " << stats.fan_in << ", "
+             << stats.merge_passes << " merge passes, run sorting " << stats.sort_seconds * 1e3 << " ms\n";
+        printPhase("run formation", stats.run_formation);
+        printPhase("merge", stats.merge);
+        cout << endl;
+    }
+    remove(input.c_str());
+    remove(output.c_str());
+
+    return 0;
+}
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "threadpool.h"
+#include "mergesorttk.h"
+#include "losertree.h"
+#include "tuning.h"
+
+// External-memory merge sort for binary files of doubles larger than RAM:
+//   1. run formation: the input is mmapped and consumed in runs that fit the memory
+//      budget; each run is sorted with the hybrid mergeSort and spilled to a temp file
+//      while the next run is being sorted,
+//   2. k-way merge: the runs are merged with a LoserTree; every run has two read
+//      buffers and the output has two write buffers, so reads and writes are issued
+//      asynchronously while the tree consumes the other buffer. When the budget cannot
+//      give every run a buffer of EXTERNAL_MIN_BLOCK bytes, runs are merged in groups
+//      over several passes.
+
+constexpr size_t EXTERNAL_MIN_BLOCK = 1 << 20;   // Smallest read/write block per buffer in the merge
+constexpr size_t EXTERNAL_MIN_BUDGET = 2 * 3 * EXTERNAL_MIN_BLOCK;   // Two blocks each for two runs and the output
+
+struct ExternalSortOptions {
+    size_t memory_budget = size_t(1) << 30;   // Bytes of RAM for run and merge buffers
+    std::string temp_dir = "/tmp";            // Where runs are spilled (files are unlinked on creation)
+    int k = 0;                                // Leaf size of the run sort; 0 = tunedProfile().k
+    WorkStealingPool* pool = nullptr;         // nullptr = WorkStealingPool::instance()
+};
+
+// Wall time and bytes moved by one phase
+struct ExternalPhaseStats {
+    double seconds = 0;
+    size_t bytes_read = 0;
+    size_t bytes_written = 0;
+
+    double readMBps() const { return seconds > 0 ? bytes_read / seconds / 1e6 : 0; }
+    double writeMBps() const { return seconds > 0 ? bytes_written / seconds / 1e6 : 0; }
+};
+
+struct ExternalSortStats {
+    ExternalPhaseStats run_formation;
+    ExternalPhaseStats merge;
+    double sort_seconds = 0;   // Part of run formation spent in mergeSort
+    int num_runs = 0;
+    int merge_passes = 0;
+    int fan_in = 0;
+};
+
+namespace external {
+
+inline void readFully(int fd, void* buf, size_t bytes, off_t offset) {
+    char* p = static_cast<char*>(buf);
+    while (bytes > 0) {
+        ssize_t got = pread(fd, p, bytes, offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) throw std::system_error(errno, std::generic_category(), "pread");
+        if (got == 0) throw std::runtime_error("unexpected end of file");
+        p += got;
+        bytes -= got;
+        offset += got;
+    }
+}
+
+inline void writeFully(int fd, const void* buf, size_t bytes, off_t offset) {
+    const char* p = static_cast<const char*>(buf);
+    while (bytes > 0) {
+        ssize_t put = pwrite(fd, p, bytes, offset);
+        if (put < 0 && errno == EINTR) continue;
+        if (put < 0) throw std::system_error(errno, std::generic_category(), "pwrite");
+        p += put;
+        bytes -= put;
+        offset += put;
+    }
+}
+
+// Owns a file descriptor
+class File {
+public:
+    File() = default;
+    explicit File(int fd) : fd_(fd) {}
+    File(File&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+    File& operator=(File&& other) noexcept {
+        std::swap(fd_, other.fd_);
+        return *this;
+    }
+    ~File() {
+        if (fd_ >= 0) close(fd_);
+    }
+    int fd() const { return fd_; }
+
+private:
+    int fd_ = -1;
+};
+
+inline File openFile(const std::string& path, int flags) {
+    int fd = open(path.c_str(), flags, 0644);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+    return File(fd);
+}
+
+// Anonymous spill file in dir: unlinked right away so it disappears with the descriptor
+inline File tempFile(const std::string& dir) {
+    std::string path = dir + "/psort-run-XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "mkstemp " + path);
+    unlink(path.c_str());
+    return File(fd);
+}
+
+// A sorted run: [offset, offset + count) doubles of file
+struct Run {
+    int fd;
+    off_t offset;
+    size_t count;
+};
+
+// Streams one run through two buffers: while the merge consumes one, the other is being
+// filled by an asynchronous read
+class RunReader {
+public:
+    RunReader(Run run, size_t block) : run_(run), block_(block) {
+        buf_[0].resize(block);
+        buf_[1].resize(block);
+        len_[0] = fill(0);
+        issue(1);
+    }
+
+    bool done() const { return pos_ == len_[cur_]; }
+    double head() const { return buf_[cur_][pos_]; }
+
+    // Advances past head(); returns false once the run is exhausted
+    bool advance() {
+        if (++pos_ < len_[cur_]) return true;
+        len_[cur_ ^ 1] = pending_.get();
+        cur_ ^= 1;
+        pos_ = 0;
+        if (len_[cur_] == 0) return false;
+        issue(cur_ ^ 1);
+        return true;
+    }
+
+    size_t bytesRead() const { return read_ * sizeof(double); }
+
+private:
+    size_t fill(int b) {
+        size_t n = std::min(block_, run_.count - read_);
+        readFully(run_.fd, buf_[b].data(), n * sizeof(double), run_.offset + read_ * sizeof(double));
+        read_ += n;
+        return n;
+    }
+
+    void issue(int b) {
+        pending_ = std::async(std::launch::async, [this, b] { return fill(b); });
+    }
+
+    Run run_;
+    size_t block_;
+    std::vector<double> buf_[2];
+    size_t len_[2] = {0, 0};
+    int cur_ = 0;
+    size_t pos_ = 0;
+    size_t read_ = 0;   // Doubles read from the run so far (touched only by the reading task)
+    std::future<size_t> pending_;
+};
+
+// Collects output in one buffer while the other is written asynchronously
+class RunWriter {
+public:
+    RunWriter(int fd, off_t offset, size_t block) : fd_(fd), offset_(offset), block_(block) {
+        buf_[0].resize(block);
+        buf_[1].resize(block);
+    }
+
+    void push(double x) {
+        buf_[cur_][fill_++] = x;
+        if (fill_ == block_) flush();
+    }
+
+    void flush() {
+        if (pending_.valid()) pending_.get();
+        pending_ = std::async(std::launch::async, [this, b = cur_, n = fill_, at = offset_] {
+            writeFully(fd_, buf_[b].data(), n * sizeof(double), at);
+        });
+        offset_ += fill_ * sizeof(double);
+        written_ += fill_ * sizeof(double);
+        cur_ ^= 1;
+        fill_ = 0;
+    }
+
+    void finish() {
+        if (fill_ > 0) flush();
+        if (pending_.valid()) pending_.get();
+    }
+
+    size_t bytesWritten() const { return written_; }
+
+private:
+    int fd_;
+    off_t offset_;
+    size_t block_;
+    std::vector<double> buf_[2];
+    int cur_ = 0;
+    size_t fill_ = 0;
+    size_t written_ = 0;
+    std::future<void> pending_;
+};
+
+// Merges runs into out starting at out_offset with a loser tree
+inline void mergeRunsToFile(const std::vector<Run>& runs, int out_fd, off_t out_offset, size_t block,
+                            ExternalPhaseStats& stats) {
+    std::vector<RunReader> readers;
+    readers.reserve(runs.size());
+    LoserTree tree(runs.size());
+    for (size_t r = 0; r < runs.size(); r++) {
+        readers.emplace_back(runs[r], block);
+        if (!readers[r].done()) tree.set(r, readers[r].head());
+    }
+    tree.build();
+
+    RunWriter writer(out_fd, out_offset, block);
+    while (!tree.empty()) {
+        RunReader& reader = readers[tree.winner()];
+        writer.push(tree.top());
+        if (reader.advance()) {
+            tree.replace(reader.head());
+        } else {
+            tree.pop();
+        }
+    }
+    writer.finish();
+
+    for (auto& reader : readers) stats.bytes_read += reader.bytesRead();
+    stats.bytes_written += writer.bytesWritten();
+}
+
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace external
+
+// Sorts the doubles in the binary file `input` into `output` using at most
+// opts.memory_budget bytes (at least EXTERNAL_MIN_BUDGET) for data buffers. The output
+// must be another file than the input: it is truncated before the input is read.
+inline void externalSort(const std::string& input, const std::string& output, const ExternalSortOptions& opts = {},
+                         ExternalSortStats* stats_out = nullptr) {
+    using namespace external;
+    WorkStealingPool& pool = opts.pool ? *opts.pool : WorkStealingPool::instance();
+    ExternalSortStats stats;
+    if (opts.memory_budget < EXTERNAL_MIN_BUDGET) {
+        throw std::invalid_argument("memory budget of " + std::to_string(opts.memory_budget) + " bytes is below the " +
+                                    std::to_string(EXTERNAL_MIN_BUDGET) + " the merge needs (two " +
+                                    std::to_string(EXTERNAL_MIN_BLOCK) + "-byte blocks for each of two runs and the output)");
+    }
+
+    File in = openFile(input, O_RDONLY);
+    struct stat st;
+    if (fstat(in.fd(), &st) != 0) throw std::system_error(errno, std::generic_category(), "fstat " + input);
+    if (st.st_size % sizeof(double) != 0) throw std::invalid_argument(input + " is not a whole number of doubles");
+    struct stat out_st;
+    if (stat(output.c_str(), &out_st) == 0 && out_st.st_dev == st.st_dev && out_st.st_ino == st.st_ino) {
+        throw std::invalid_argument(output + " is the input file; sort into another file");
+    }
+    const size_t n = st.st_size / sizeof(double);
+    File out = openFile(output, O_RDWR | O_CREAT | O_TRUNC);
+    if (n == 0) {
+        if (stats_out) *stats_out = stats;
+        return;
+    }
+
+    // Phase 1: two run buffers (one being sorted, one being written) plus aux
+    const size_t run_len = std::min(n, std::max<size_t>(opts.memory_budget / (3 * sizeof(double)), 1024));
+    const size_t num_runs = (n + run_len - 1) / run_len;
+    const TuningProfile& profile = tunedProfile();
+    const int k = opts.k ? opts.k : profile.k;
+    const ptrdiff_t min_thread_size = profile.minThreadSize(run_len, pool.size() + 1);
+    stats.num_runs = num_runs;
+
+    auto start = std::chrono::steady_clock::now();
+    const double* mapped = static_cast<const double*>(mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, in.fd(), 0));
+    if (mapped == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap " + input);
+    madvise(const_cast<double*>(mapped), st.st_size, MADV_SEQUENTIAL);
+
+    File spill = num_runs > 1 ? tempFile(opts.temp_dir) : File();
+    const int run_fd = num_runs > 1 ? spill.fd() : out.fd();
+    std::vector<double> buffers[2] = {std::vector<double>(run_len), std::vector<double>(num_runs > 1 ? run_len : 0)};
+    std::vector<double> aux(run_len);
+    std::future<void> pending_write;
+    std::vector<Run> runs;
+    try {
+        for (size_t r = 0; r < num_runs; r++) {
+            const size_t lo = r * run_len, len = std::min(run_len, n - lo);
+            std::vector<double>& arr = buffers[r % 2];   // Its previous run finished writing before run r - 1's write started
+            arr.resize(len);
+            parallelCopy(mapped + lo, arr.data(), len, pool);
+
+            // Drop the consumed pages so the mapping does not compete with the run buffers
+            const size_t page = sysconf(_SC_PAGE_SIZE);
+            const size_t drop_lo = lo * sizeof(double) / page * page, drop_hi = (lo + len) * sizeof(double) / page * page;
+            if (drop_hi > drop_lo) madvise((char*)mapped + drop_lo, drop_hi - drop_lo, MADV_DONTNEED);
+
+            auto sort_start = std::chrono::steady_clock::now();
+            mergeSort(arr, aux, 0, len - 1, k, min_thread_size, pool, networkSort);
+            stats.sort_seconds += secondsSince(sort_start);
+
+            if (pending_write.valid()) pending_write.get();   // Overlapped with this run's copy and sort
+            pending_write = std::async(std::launch::async, [&arr, fd = run_fd, at = (off_t)(lo * sizeof(double)), len] {
+                writeFully(fd, arr.data(), len * sizeof(double), at);
+            });
+            runs.push_back({run_fd, (off_t)(lo * sizeof(double)), len});
+        }
+        pending_write.get();
+    } catch (...) {
+        if (pending_write.valid()) pending_write.wait();
+        munmap(const_cast<double*>(mapped), st.st_size);
+        throw;
+    }
+    munmap(const_cast<double*>(mapped), st.st_size);
+    stats.run_formation = {secondsSince(start), n * sizeof(double), n * sizeof(double)};
+    std::vector<double>().swap(buffers[0]);
+    std::vector<double>().swap(buffers[1]);
+    std::vector<double>().swap(aux);
+
+    // Phase 2: k-way merge. Each run and the output get two blocks; cap the fan-in so a
+    // block stays at least EXTERNAL_MIN_BLOCK bytes and merge in several passes if needed.
+    start = std::chrono::steady_clock::now();
+    const size_t max_fan_in = std::max<size_t>(2, opts.memory_budget / (2 * EXTERNAL_MIN_BLOCK) - 1);
+    stats.fan_in = std::min(num_runs, max_fan_in);
+    File current = std::move(spill);
+    while (runs.size() > 1) {
+        const bool last_pass = runs.size() <= max_fan_in;
+        File next = last_pass ? File() : tempFile(opts.temp_dir);
+        const int dst_fd = last_pass ? out.fd() : next.fd();
+        std::vector<Run> merged;
+        for (size_t g = 0; g < runs.size(); g += max_fan_in) {
+            std::vector<Run> group(runs.begin() + g, runs.begin() + std::min(runs.size(), g + max_fan_in));
+            const size_t block = std::max<size_t>(
+                EXTERNAL_MIN_BLOCK / sizeof(double), opts.memory_budget / (2 * (group.size() + 1) * sizeof(double)));
+            Run result{dst_fd, group.front().offset, 0};
+            for (const Run& run : group) result.count += run.count;
+            if (group.size() == 1) {
+                std::vector<double> copy(run_len);   // A lone leftover run is copied through
+                for (size_t done = 0; done < result.count; done += copy.size()) {
+                    size_t c = std::min(copy.size(), result.count - done);
+                    readFully(group[0].fd, copy.data(), c * sizeof(double), group[0].offset + done * sizeof(double));
+                    writeFully(dst_fd, copy.data(), c * sizeof(double), result.offset + done * sizeof(double));
+                }
+                stats.merge.bytes_read += result.count * sizeof(double);
+                stats.merge.bytes_written += result.count * sizeof(double);
+            } else {
+                mergeRunsToFile(group, dst_fd, result.offset, block, stats.merge);
+            }
+            merged.push_back(result);
+        }
+        runs.swap(merged);
+        current = std::move(next);   // Closes (and frees) the runs this pass consumed
+        stats.merge_passes++;
+    }
+    stats.merge.seconds = secondsSince(start);
+
+    if (stats_out) *stats_out = stats;
+}
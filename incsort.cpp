@@ -0,0 +1,79 @@
+// Incremental re-sort against a full re-sort when a sorted column grows by a small batch,
+// e.g.
+//   incsort --sizes 1e8 --threads 1,16
+// For every delta ratio the sorted base of n elements gets n * ratio new values drawn like
+// the base; all engines end with the n + n * ratio values sorted in the column.
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "incsort.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    opts.sizes = {10000000, 100000000};
+    opts.reps = 5;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    const vector<double> ratios = {0.001, 0.003, 0.01, 0.03};
+
+    BenchReport report(opts);
+    // The base column of every size is generated and sorted once, for all thread counts
+    auto sorted_base = [](InputPattern input, ptrdiff_t n, mt19937_64& gen) {
+        vector<double> base = generateInput(n, input, gen);
+        sort(base.begin(), base.end());
+        return base;
+    };
+    report.run(sorted_base, [&](const BenchConfig& cfg) {
+        const ptrdiff_t n = cfg.n;
+        const vector<double>& base = cfg.arr;
+        WorkStealingPool& pool = cfg.pool;
+        if (report.text()) cout << "Adding to " << n << " sorted " << inputPatternName(cfg.input) << " elements with " << cfg.threads << " threads..." << endl;
+
+        for (double ratio : ratios) {
+            const ptrdiff_t m = max<ptrdiff_t>(1, (ptrdiff_t)(n * ratio));
+            const vector<double> fresh = generateInput(m, cfg.input, cfg.gen);
+            const string suffix = " delta " + to_string(ratio * 100).substr(0, 4) + "%";
+
+            // The column keeps room for the delta, as a growing column would
+            vector<double> column, delta, aux(n + m);
+            column.reserve(n + m);
+            auto prepare = [&] {
+                column.assign(base.begin(), base.end());
+                delta.assign(fresh.begin(), fresh.end());
+            };
+            auto sorted = [&] { return (ptrdiff_t)column.size() == n + m && is_sorted(column.begin(), column.end()); };
+
+            double full_ms = 0;
+            auto record = [&](const string& name, const BenchStats& stats) {
+                report.record({name + suffix, cfg.input, n + m, cfg.threads, stats, {}});
+                if (report.text() && full_ms > 0 && name != "full re-sort") cout << "    " << full_ms / stats.median << "x faster than the full re-sort" << endl;
+            };
+
+            if (report.selected("full re-sort" + suffix)) {
+                record("full re-sort", measureRuns(opts.reps, opts.warmup, prepare, [&] {
+                    column.insert(column.end(), delta.begin(), delta.end());
+                    mergeSort(column, aux, 0, n + m - 1, tunedProfile().k, tunedProfile().minThreadSize(n + m, cfg.threads), pool, networkSort);
+                }, sorted));
+                full_ms = report.results().back().stats.median;
+            }
+            if (report.selected("incremental" + suffix)) {
+                record("incremental", measureRuns(opts.reps, opts.warmup, prepare, [&] { incrementalSort(column, delta, pool); }, sorted));
+            }
+            // Sequential reference: sort the delta, append it and let the library merge
+            if (report.selected("std::inplace_merge" + suffix)) {
+                record("std::inplace_merge", measureRuns(opts.reps, opts.warmup, prepare, [&] {
+                    sort(delta.begin(), delta.end());
+                    column.insert(column.end(), delta.begin(), delta.end());
+                    inplace_merge(column.begin(), column.begin() + n, column.end());
+                }, sorted));
+            }
+        }
+    });
+    return report.finish();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "threadpool.h"
+#include "parallel_merge.h"
+#include "mergesorttk.h"
+#include "tuning.h"
+
+// Incremental re-sort: a small batch of new values is sorted on its own and merged into
+// an already sorted array, instead of sorting everything again. The merge runs in place
+// in the array (grown by the batch size): the output is cut into co-ranked partitions on
+// the pool, and each partition walks its delta from the largest value down, gallops
+// (exponential then binary search) to where that value goes among its base elements and
+// shifts the whole base block above it with one memmove. With 0.1-1% new values the
+// blocks are hundreds to thousands of elements long, so the merge costs about one
+// streaming pass over the array. Extra memory is the sorted delta plus the few base
+// elements at each partition's start that the partition before it overwrites.
+
+constexpr ptrdiff_t INCREMENTAL_SORT_LEAF = 50;   // Deltas up to this size are insertion sorted
+
+// Partition of the merge: base[bi, be) and delta[di, de) go to base[bi + di, be + de).
+// base[bi, split) may be overwritten by the partition below, so it is read from saved.
+struct DeltaPartition {
+    double* base;
+    ptrdiff_t bi, be, split;
+    const double* saved;
+    const double* delta;
+    ptrdiff_t di, de;
+
+    double at(ptrdiff_t i) const { return i < split ? saved[i - bi] : base[i]; }
+
+    // Moves base elements [from, to) right to base[dst..); dst >= from
+    void move(ptrdiff_t from, ptrdiff_t to, ptrdiff_t dst) const {
+        if (dst == from || from == to) return;
+        const ptrdiff_t mid = std::max(from, std::min(to, split));
+        if (to > mid) std::memmove(base + dst + (mid - from), base + mid, (to - mid) * sizeof(double));
+        if (mid > from) std::memcpy(base + dst, saved + (from - bi), (mid - from) * sizeof(double));
+    }
+
+    // First index p in [lo, hi) with at(p) > x, galloping down from hi
+    ptrdiff_t gallop(double x, ptrdiff_t lo, ptrdiff_t hi) const {
+        ptrdiff_t step = 1, upper = hi;
+        while (hi - step >= lo && at(hi - step) > x) {
+            upper = hi - step;
+            step *= 2;
+        }
+        ptrdiff_t first = std::max(lo, hi - step);
+        while (first < upper) {
+            ptrdiff_t mid = first + (upper - first) / 2;
+            if (at(mid) > x) upper = mid;
+            else first = mid + 1;
+        }
+        return first;
+    }
+
+    // Backward merge: every delta value goes after the base values equal to it
+    void merge() const {
+        ptrdiff_t hi = be, out = be + de;
+        for (ptrdiff_t t = de - 1; t >= di; t--) {
+            const double x = delta[t];
+            const ptrdiff_t p = gallop(x, bi, hi);
+            move(p, hi, out - (hi - p));
+            out -= hi - p + 1;
+            hi = p;
+            base[out] = x;
+        }
+        move(bi, hi, bi + di);
+    }
+};
+
+// Merges sorted delta[0..m) into sorted base[0..n); base has room for n + m elements
+inline void mergeSortedDelta(double* base, ptrdiff_t n, const double* delta, ptrdiff_t m, WorkStealingPool& pool = WorkStealingPool::instance()) {
+    if (m == 0) return;
+    const ptrdiff_t total = n + m;
+    const int chunks = parallelChunks(total, pool);
+
+    // Partition c produces output [rank[c], rank[c + 1]) from base[bi[c], bi[c + 1]) and
+    // delta[rank[c] - bi[c], rank[c + 1] - bi[c + 1])
+    std::vector<ptrdiff_t> rank(chunks + 1), bi(chunks + 1);
+    for (int c = 0; c <= chunks; c++) {
+        rank[c] = total * c / chunks;
+        bi[c] = coRank(rank[c], base, n, delta, m);
+    }
+    // Base elements below a partition's first output slot belong to outputs of the
+    // partitions before it; save them before anyone writes
+    std::vector<ptrdiff_t> saved_at(chunks + 1, 0);
+    for (int c = 0; c < chunks; c++) saved_at[c + 1] = saved_at[c] + std::max<ptrdiff_t>(0, std::min(bi[c + 1], rank[c]) - bi[c]);
+    std::vector<double> saved(saved_at[chunks]);
+    for (int c = 0; c < chunks; c++) {
+        if (saved_at[c + 1] > saved_at[c]) std::memcpy(saved.data() + saved_at[c], base + bi[c], (saved_at[c + 1] - saved_at[c]) * sizeof(double));
+    }
+
+    TaskGroup group(pool);
+    for (int c = 0; c < chunks; c++) {
+        const DeltaPartition part{base, bi[c], bi[c + 1], bi[c] + saved_at[c + 1] - saved_at[c], saved.data() + saved_at[c],
+                                  delta, rank[c] - bi[c], rank[c + 1] - bi[c + 1]};
+        group.run([part] { part.merge(); });
+    }
+    group.wait();
+}
+
+// Sorts delta (in place) with the hybrid merge sort, with the leaf size and grain of the
+// tuning profile, and merges it into sorted, which grows by delta.size(); reserve
+// sorted's capacity to keep that from reallocating
+inline void incrementalSort(std::vector<double>& sorted, std::vector<double>& delta, WorkStealingPool& pool = WorkStealingPool::instance()) {
+    const ptrdiff_t n = sorted.size(), m = delta.size();
+    if (m == 0) return;
+    if (m <= INCREMENTAL_SORT_LEAF) {
+        insertionSort(delta, 0, m - 1);
+    } else {
+        std::vector<double> aux(m);
+        const TuningProfile& profile = tunedProfile();
+        mergeSort(delta, aux, 0, m - 1, profile.k, profile.minThreadSize(m, pool.size() + 1), pool, networkSort);
+    }
+    sorted.resize(n + m);
+    mergeSortedDelta(sorted.data(), n, delta.data(), m, pool);
+}
@@ -0,0 +1,103 @@
+// Runtime against peak memory: the in-place merge sort next to the engines that need a
+// full-size scratch array, e.g.
+//   inplacesort --sizes 1e8 --threads 1,16 --engines 'inplace*,mergesorttk*'
+// Every engine allocates its own scratch inside the timed call, as a memory-capped caller
+// would, and "peak extra" is the rise of the process peak RSS (VmHWM) above the resident
+// input during one sort.
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "inplacesort.h"
+#include "mergesorttk.h"
+#include "psort.h"
+#include "ranksort.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    opts.sizes = {1000000, 10000000, 100000000};
+    opts.reps = 3;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    auto minThreadSize = [](ptrdiff_t n, const BenchContext& ctx) { return max<ptrdiff_t>(10000, n / (4 * ctx.threads)); };
+    const vector<BenchEngine> engines = {
+        {"inplace/sqrt buffer", [&](vector<double>& a, vector<double>&, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             inplaceMergeSort(a, 0, n - 1, 50, minThreadSize(n, ctx), inplaceBufferSize(n), ctx.pool, networkSort);
+         }},
+        {"inplace/rotations only", [&](vector<double>& a, vector<double>&, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             inplaceMergeSort(a, 0, n - 1, 50, minThreadSize(n, ctx), 0, ctx.pool, networkSort);
+         }},
+        {"mergesorttk/network", [&](vector<double>& a, vector<double>&, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             vector<double> aux(n);
+             mergeSort(a, aux, 0, n - 1, 50, minThreadSize(n, ctx), ctx.pool, networkSort);
+         }},
+        {"psort::parallel_sort", [](vector<double>& a, vector<double>&, const BenchContext& ctx) {
+             SortWorkspace workspace;
+             psort::SortOptions sort_opts;
+             sort_opts.pool = &ctx.pool;
+             sort_opts.workspace = &workspace;
+             psort::parallel_sort(a, {}, {}, sort_opts);
+         }},
+        {"ranksort", [](vector<double>& a, vector<double>&, const BenchContext& ctx) {
+#ifdef _OPENMP
+             omp_set_num_threads(ctx.threads);
+#endif
+             SortWorkspace workspace;
+             parallel_rank_sort(a, optimized_parallel_merge, &workspace);
+         }},
+        {"std::sort", [](vector<double>& a, vector<double>&, const BenchContext&) { sort(a.begin(), a.end()); }},
+        {"std::stable_sort", [](vector<double>& a, vector<double>&, const BenchContext&) { stable_sort(a.begin(), a.end()); }},
+    };
+    if (opts.list) {
+        for (const BenchEngine& e : engines) cout << e.name << endl;
+        return 0;
+    }
+    if (!resetPeakResident()) cerr << "Cannot reset the peak RSS (/proc/self/clear_refs); peak extra is not measured" << endl;
+
+    BenchReport report(opts, {{"peak_extra_bytes", nullptr}});
+    report.run([&](const BenchConfig& cfg) {
+        const ptrdiff_t n = cfg.n;
+        vector<double> work(n), unused;
+        BenchContext ctx{cfg.pool, cfg.threads};
+        if (report.text()) cout << "Sorting " << n << " " << inputPatternName(cfg.input) << " elements with " << cfg.threads << " threads..." << endl;
+
+        double baseline_ms = 0;
+        for (const BenchEngine& engine : engines) {
+            if (!engineSelected(engine, opts.engines)) continue;
+            auto prepare = [&] { memcpy(work.data(), cfg.arr.data(), n * sizeof(double)); };
+            auto sorted = [&] { return is_sorted(work.begin(), work.end()); };
+
+            // Peak first, on the engine's first run, so nothing it allocates is already resident
+            prepare();
+            const double resident = residentBytes("VmRSS");
+            double peak_extra = 0;
+            if (resetPeakResident()) {
+                engine.sort(work, unused, ctx);
+                peak_extra = max(0.0, residentBytes("VmHWM") - resident);
+            }
+
+            BenchResult r{engine.name, cfg.input, n, cfg.threads, {}, {peak_extra}};
+            r.stats = measureRuns(opts.reps, opts.warmup, prepare, [&] { engine.sort(work, unused, ctx); }, sorted);
+            report.record(r);
+            if (engine.name == "mergesorttk/network") baseline_ms = r.stats.median;
+            if (report.text()) {
+                cout << "    peak extra " << peak_extra / n << " bytes/element";
+                if (baseline_ms > 0 && engine.name != "mergesorttk/network") cout << ", " << r.stats.median / baseline_ms << "x the time of mergesorttk";
+                cout << endl;
+            }
+        }
+    });
+    return report.finish();
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "threadpool.h"
+#include "mergesorttk.h"
+
+// In-place mode of the threaded hybrid merge sort for memory-capped hosts: the same
+// recursion as mergeSort (leaves below k, halves above MIN_THREAD_SIZE on the pool), but
+// the merges run in place instead of through a full-size aux array. A merge whose shorter
+// run fits the buffer (about sqrt(n) doubles per thread) copies that run out and merges
+// straight back into the array; longer merges are split SymMerge-style (Kim & Kutzner):
+// one rotation swaps the middle blocks, leaving two independent merges that run
+// concurrently when large. With a buffer of 0 only rotations are used and the sort needs
+// O(1) extra memory besides the recursion stack. Stable, like mergeSort.
+
+constexpr ptrdiff_t INPLACE_PARALLEL_MERGE = 1 << 16;   // Split merges at least this long run both halves on the pool
+
+// The calling thread's merge buffer, grown to at least size doubles and kept between sorts
+inline double* inplaceMergeBuffer(ptrdiff_t size) {
+    thread_local std::vector<double> buffer;
+    if ((ptrdiff_t)buffer.size() < size) buffer.resize(size);
+    return buffer.data();
+}
+
+// Default buffer: sqrt(n) doubles, so a thread's buffer is under 0.1% of a 100M-element array
+inline ptrdiff_t inplaceBufferSize(ptrdiff_t n) {
+    return (ptrdiff_t)std::sqrt((double)n);
+}
+
+// Stable merge of a[lo..mid) and a[mid..hi) through buf, which holds the shorter run: a
+// left run is merged forward, a right run backward, so the output never overtakes the
+// elements still to be read from the array
+inline void bufferedMerge(double* a, ptrdiff_t lo, ptrdiff_t mid, ptrdiff_t hi, double* buf) {
+    if (mid - lo <= hi - mid) {
+        const ptrdiff_t n = mid - lo;
+        std::copy(a + lo, a + mid, buf);
+        ptrdiff_t i = 0, j = mid, out = lo;
+        while (i < n && j < hi) {
+            const bool right = a[j] < buf[i];
+            a[out++] = right ? a[j] : buf[i];
+            j += right;
+            i += !right;
+        }
+        std::copy(buf + i, buf + n, a + out);
+    } else {
+        const ptrdiff_t n = hi - mid;
+        std::copy(a + mid, a + hi, buf);
+        ptrdiff_t i = mid - 1, j = n - 1, out = hi - 1;
+        while (i >= lo && j >= 0) {
+            const bool left = buf[j] < a[i];
+            a[out--] = left ? a[i] : buf[j];
+            i -= left;
+            j -= !left;
+        }
+        std::copy(buf, buf + j + 1, a + lo);
+    }
+}
+
+// Stable in-place merge of a[lo..mid) and a[mid..hi) using at most `buffer` doubles of
+// scratch per thread
+inline void inplaceMerge(double* a, ptrdiff_t lo, ptrdiff_t mid, ptrdiff_t hi, ptrdiff_t buffer, WorkStealingPool& pool) {
+    if (lo == mid || mid == hi || !(a[mid] < a[mid - 1])) return;   // A run is empty or the runs are already in order
+    const ptrdiff_t shorter = std::min(mid - lo, hi - mid);
+    if (shorter <= buffer) {
+        bufferedMerge(a, lo, mid, hi, inplaceMergeBuffer(shorter));
+        return;
+    }
+    if (mid - lo == 1) {
+        // One element on the left: rotate it past every smaller element on the right
+        double* pos = std::lower_bound(a + mid, a + hi, a[lo]);
+        std::rotate(a + lo, a + lo + 1, pos);
+        return;
+    }
+    if (hi - mid == 1) {
+        double* pos = std::upper_bound(a + lo, a + mid, a[mid]);
+        std::rotate(pos, a + mid, a + hi);
+        return;
+    }
+
+    // SymMerge: find the cut `start` on the left so that rotating a[start..mid) with
+    // a[mid..end) (end = half + mid - start) leaves a[lo..half) and a[half..hi) as two
+    // merges of the same kind, with every element of the first no greater than the second
+    const ptrdiff_t half = lo + (hi - lo) / 2;
+    const ptrdiff_t n = half + mid;
+    ptrdiff_t start, r;
+    if (mid > half) {
+        start = n - hi;
+        r = half;
+    } else {
+        start = lo;
+        r = mid;
+    }
+    const ptrdiff_t p = n - 1;
+    while (start < r) {
+        const ptrdiff_t c = start + (r - start) / 2;
+        if (!(a[p - c] < a[c])) {
+            start = c + 1;
+        } else {
+            r = c;
+        }
+    }
+    const ptrdiff_t end = n - start;
+    if (start < mid && mid < end) std::rotate(a + start, a + mid, a + end);
+
+    if (hi - lo >= INPLACE_PARALLEL_MERGE) {
+        TaskGroup group(pool);
+        group.run([=, &pool] {
+            if (lo < start && start < half) inplaceMerge(a, lo, start, half, buffer, pool);
+        });
+        if (half < end && end < hi) inplaceMerge(a, half, end, hi, buffer, pool);
+        group.wait();
+    } else {
+        if (lo < start && start < half) inplaceMerge(a, lo, start, half, buffer, pool);
+        if (half < end && end < hi) inplaceMerge(a, half, end, hi, buffer, pool);
+    }
+}
+
+// mergeSort with in-place merges: sorts arr[left..right] using `buffer` doubles of merge
+// scratch per thread (inplaceBufferSize(n) for the default, 0 for rotations only)
+inline void inplaceMergeSort(std::vector<double>& arr, ptrdiff_t left, ptrdiff_t right, int k, ptrdiff_t MIN_THREAD_SIZE, ptrdiff_t buffer,
+                             WorkStealingPool& pool = WorkStealingPool::instance(), LeafSortFn leaf = insertionSort) {
+    const ptrdiff_t n = right - left + 1;
+    if (n <= k) {
+        PSORT_PHASE(Leaf, n);
+        leaf(arr, left, right);
+        return;
+    }
+    if (left < right) {
+        ptrdiff_t mid = left + (right - left) / 2;
+        if ((right - left) > MIN_THREAD_SIZE) {
+            TaskGroup group(pool);
+            group.run([&] { inplaceMergeSort(arr, left, mid, k, MIN_THREAD_SIZE, buffer, pool, leaf); });
+            inplaceMergeSort(arr, mid + 1, right, k, MIN_THREAD_SIZE, buffer, pool, leaf);
+            group.wait();
+        } else {
+            inplaceMergeSort(arr, left, mid, k, MIN_THREAD_SIZE, buffer, pool, leaf);
+            inplaceMergeSort(arr, mid + 1, right, k, MIN_THREAD_SIZE, buffer, pool, leaf);
+        }
+        PSORT_PHASE(Merge, n);
+        // inplaceMerge returns at once when the halves are already in order
+        if (arr[mid + 1] < arr[mid]) PSORT_COUNT_MERGE(n, 2 * n * sizeof(double));   // At least; rotations move more
+        inplaceMerge(arr.data(), left, mid + 1, right + 1, buffer, pool);
+    }
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Opt-in instrumentation of the sort engines. Build with -DPARALLELSORT_INSTRUMENT to
+// enable it; otherwise the PSORT_ macros expand to nothing and the engines
+// compile exactly as before.
+//
+// PSORT_PHASE(phase, size) times the rest of the enclosing scope. Times are exclusive: a
+// scope opened inside another (a leaf under a join that helped run it, say) is subtracted
+// from the outer one, so the phases of a sort add up to the thread time spent in them.
+// Every phase is also keyed by its level, log2 of the subarray size, which the report
+// turns into recursion depth below the largest level seen. PSORT_COUNT(counter, value)
+// adds to a counter and PSORT_COUNT_MERGE(n, bytes) records one merge. All of them write
+// per-thread slots, so a sort takes no locks or shared cache lines while it runs.
+
+namespace instrument {
+
+enum class Phase { Leaf, Merge, ParallelMerge, Spawn, Join, Pack, Unpack, Copy, Count };
+enum class Counter { Merges, ComparisonBound, BytesMoved, Tasks, Count };
+
+constexpr int PHASES = static_cast<int>(Phase::Count);
+constexpr int COUNTERS = static_cast<int>(Counter::Count);
+constexpr int LEVELS = 64;
+
+inline const char* phaseName(Phase p) {
+    static const char* names[] = {"leaf", "merge", "parallel merge", "spawn", "join", "pack", "unpack", "copy"};
+    return names[static_cast<int>(p)];
+}
+
+inline const char* counterName(Counter c) {
+    static const char* names[] = {"merges", "comparison bound", "bytes moved", "tasks"};
+    return names[static_cast<int>(c)];
+}
+
+// floor(log2(size)), 0 for empty ranges
+inline int levelOf(ptrdiff_t size) {
+    return size > 1 ? std::bit_width(static_cast<uint64_t>(size)) - 1 : 0;
+}
+
+// Written only by its own thread (relaxed load + store, no read-modify-write); read by
+// report() once the sort has joined
+struct ThreadSlots {
+    std::array<std::array<std::atomic<uint64_t>, LEVELS>, PHASES> ns{};
+    std::array<std::array<std::atomic<uint64_t>, LEVELS>, PHASES> calls{};
+    std::array<std::atomic<uint64_t>, COUNTERS> counters{};
+};
+
+inline void add(std::atomic<uint64_t>& slot, uint64_t x) {
+    slot.store(slot.load(std::memory_order_relaxed) + x, std::memory_order_relaxed);
+}
+
+// Slots of every thread that has recorded anything; they outlive their threads so pools
+// torn down before the report still count
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadSlots>> slots;
+};
+
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+inline ThreadSlots& threadSlots() {
+    thread_local ThreadSlots* mine = [] {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.slots.push_back(std::make_unique<ThreadSlots>());
+        return r.slots.back().get();
+    }();
+    return *mine;
+}
+
+inline void count(Counter c, uint64_t value) {
+    add(threadSlots().counters[static_cast<int>(c)], value);
+}
+
+// One two-way merge of n elements moving `bytes`, read plus written as mergeTraffic counts
+// them (4n elements for a copy into aux and a merge back, 2n for a ping-pong merge). The
+// comparison bound adds n - 1, the most a merge can take; it is not a count of comparisons
+// made, and leaf sorts add nothing to it. Record a merge only once it is known to run, not
+// for halves that are already in order.
+inline void countMerge(ptrdiff_t n, uint64_t bytes) {
+    ThreadSlots& slots = threadSlots();
+    add(slots.counters[static_cast<int>(Counter::Merges)], 1);
+    add(slots.counters[static_cast<int>(Counter::ComparisonBound)], n > 0 ? n - 1 : 0);
+    add(slots.counters[static_cast<int>(Counter::BytesMoved)], bytes);
+}
+
+class ScopedPhase {
+public:
+    ScopedPhase(Phase phase, ptrdiff_t size)
+        : phase_(static_cast<int>(phase)), level_(std::min(levelOf(size), LEVELS - 1)), parent_(current()),
+          start_(std::chrono::steady_clock::now()) {
+        current() = this;
+    }
+
+    ~ScopedPhase() {
+        const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+        ThreadSlots& slots = threadSlots();
+        add(slots.ns[phase_][level_], elapsed > children_ns_ ? elapsed - children_ns_ : 0);
+        add(slots.calls[phase_][level_], 1);
+        if (parent_) parent_->children_ns_ += elapsed;
+        current() = parent_;
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    static ScopedPhase*& current() {
+        thread_local ScopedPhase* top = nullptr;
+        return top;
+    }
+
+    int phase_, level_;
+    ScopedPhase* parent_;
+    uint64_t children_ns_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// cycles, branch-misses and LLC-misses through perf_event_open, one counter group per
+// thread of the process. Threads are enumerated from /proc/self/task when start() runs,
+// so pool and OpenMP threads must exist by then (a warm-up sort creates them); threads
+// spawned during the sort are not counted. available() is false where perf events are
+// not permitted (perf_event_paranoid, containers) or not Linux.
+class HardwareCounters {
+public:
+    static constexpr int EVENTS = 3;
+    static const char* eventName(int e) {
+        static const char* names[] = {"cycles", "branch-misses", "LLC-misses"};
+        return names[e];
+    }
+
+    HardwareCounters() = default;
+    HardwareCounters(const HardwareCounters&) = delete;
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+    ~HardwareCounters() { close(); }
+
+    bool start() {
+        close();
+#ifdef __linux__
+        DIR* dir = opendir("/proc/self/task");
+        if (!dir) return false;
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.') continue;
+            openThread(std::stoi(entry->d_name));
+        }
+        closedir(dir);
+        for (const std::array<int, EVENTS>& group : fds_) {
+            ioctl(group[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(group[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+        return available();
+    }
+
+    // Event totals over all threads since start()
+    std::array<uint64_t, EVENTS> stop() {
+        std::array<uint64_t, EVENTS> totals{};
+#ifdef __linux__
+        for (const std::array<int, EVENTS>& group : fds_) {
+            ioctl(group[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            for (int e = 0; e < EVENTS; e++) {
+                uint64_t value = 0;
+                if (read(group[e], &value, sizeof(value)) == sizeof(value)) totals[e] += value;
+            }
+        }
+#endif
+        return totals;
+    }
+
+    bool available() const { return !fds_.empty(); }
+
+private:
+#ifdef __linux__
+    void openThread(int tid) {
+        static const uint64_t configs[EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+        std::array<int, EVENTS> group;
+        for (int e = 0; e < EVENTS; e++) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[e];
+            attr.disabled = e == 0;   // The leader starts the whole group
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            group[e] = (int)syscall(SYS_perf_event_open, &attr, tid, -1, e == 0 ? -1 : group[0], 0);
+            if (group[e] < 0) {
+                for (int f = 0; f < e; f++) ::close(group[f]);
+                return;
+            }
+        }
+        fds_.push_back(group);
+    }
+#endif
+
+    void close() {
+#ifdef __linux__
+        for (const std::array<int, EVENTS>& group : fds_) {
+            for (int fd : group) ::close(fd);
+        }
+#endif
+        fds_.clear();
+    }
+
+    std::vector<std::array<int, EVENTS>> fds_;
+};
+
+// Sums of every thread's slots
+struct Report {
+    std::array<std::array<uint64_t, LEVELS>, PHASES> ns{};
+    std::array<std::array<uint64_t, LEVELS>, PHASES> calls{};
+    std::array<uint64_t, COUNTERS> counters{};
+
+    // Means over `runs` sorts recorded together
+    void divide(uint64_t runs) {
+        for (int p = 0; p < PHASES; p++) {
+            for (int l = 0; l < LEVELS; l++) {
+                ns[p][l] /= runs;
+                calls[p][l] /= runs;
+            }
+        }
+        for (uint64_t& c : counters) c /= runs;
+    }
+};
+
+inline Report report() {
+    Report r;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const std::unique_ptr<ThreadSlots>& slots : reg.slots) {
+        for (int p = 0; p < PHASES; p++) {
+            for (int l = 0; l < LEVELS; l++) {
+                r.ns[p][l] += slots->ns[p][l].load(std::memory_order_relaxed);
+                r.calls[p][l] += slots->calls[p][l].load(std::memory_order_relaxed);
+            }
+        }
+        for (int c = 0; c < COUNTERS; c++) r.counters[c] += slots->counters[c].load(std::memory_order_relaxed);
+    }
+    return r;
+}
+
+// Zeroes every thread's slots; call between sorts, not during one
+inline void reset() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const std::unique_ptr<ThreadSlots>& slots : reg.slots) {
+        for (int p = 0; p < PHASES; p++) {
+            for (int l = 0; l < LEVELS; l++) {
+                slots->ns[p][l].store(0, std::memory_order_relaxed);
+                slots->calls[p][l].store(0, std::memory_order_relaxed);
+            }
+        }
+        for (int c = 0; c < COUNTERS; c++) slots->counters[c].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Per-phase totals (thread ms and share of all recorded time), then the same time split
+// by recursion depth: depth 0 is the largest level recorded, each halving one deeper
+inline void printReport(std::ostream& out, const Report& r, double wall_ms) {
+    uint64_t total_ns = 0;
+    int top = 0;
+    for (int p = 0; p < PHASES; p++) {
+        for (int l = 0; l < LEVELS; l++) {
+            total_ns += r.ns[p][l];
+            if (r.calls[p][l]) top = std::max(top, l);
+        }
+    }
+    out << std::fixed << std::setprecision(2);
+    out << "  wall " << wall_ms << " ms, thread time in phases " << total_ns / 1e6 << " ms" << std::endl;
+    for (int p = 0; p < PHASES; p++) {
+        uint64_t ns = 0, calls = 0;
+        for (int l = 0; l < LEVELS; l++) {
+            ns += r.ns[p][l];
+            calls += r.calls[p][l];
+        }
+        if (!calls) continue;
+        out << "  " << std::left << std::setw(15) << phaseName(static_cast<Phase>(p)) << std::right << std::setw(10) << ns / 1e6
+            << " ms " << std::setw(6) << (total_ns ? 100.0 * ns / total_ns : 0.0) << "% " << std::setw(12) << calls << " calls" << std::endl;
+    }
+    out << "  by depth (subarray size 2^level):" << std::endl;
+    for (int l = top; l >= 0; l--) {
+        uint64_t ns = 0;
+        for (int p = 0; p < PHASES; p++) ns += r.ns[p][l];
+        if (!ns) continue;
+        out << "    depth " << std::setw(2) << top - l << " (2^" << std::setw(2) << l << ") " << std::setw(10) << ns / 1e6 << " ms:";
+        for (int p = 0; p < PHASES; p++) {
+            if (r.ns[p][l]) out << " " << phaseName(static_cast<Phase>(p)) << " " << r.ns[p][l] / 1e6;
+        }
+        out << std::endl;
+    }
+    out << "  counters:";
+    for (int c = 0; c < COUNTERS; c++) out << " " << counterName(static_cast<Counter>(c)) << " " << r.counters[c];
+    out << std::endl;
+    out.unsetf(std::ios::floatfield);
+}
+
+}  // namespace instrument
+
+#ifdef PARALLELSORT_INSTRUMENT
+#define PSORT_CONCAT_(a, b) a##b
+#define PSORT_CONCAT(a, b) PSORT_CONCAT_(a, b)
+#define PSORT_PHASE(phase, size) instrument::ScopedPhase PSORT_CONCAT(psort_phase_, __LINE__)(instrument::Phase::phase, (size))
+#define PSORT_COUNT(counter, value) instrument::count(instrument::Counter::counter, (value))
+#define PSORT_COUNT_MERGE(n, bytes) instrument::countMerge((n), (bytes))
+#else
+#define PSORT_PHASE(phase, size) ((void)0)
+#define PSORT_COUNT(counter, value) ((void)0)
+#define PSORT_COUNT_MERGE(n, bytes) ((void)0)
+#endif
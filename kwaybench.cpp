@@ -0,0 +1,102 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include "kwaymerge.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Baseline: log2(k) passes of two-way merges, ping-ponging between out and a buffer
+void pairwiseMerge(const SortedRun* runs, int k, double* out, vector<double>& buffer) {
+    vector<SortedRun> level(runs, runs + k);
+    const double* base = runs[0].begin;
+    double* dst = buffer.data();
+    while (level.size() > 1) {
+        vector<SortedRun> next;
+        for (size_t i = 0; i < level.size(); i += 2) {
+            double* at = dst + (level[i].begin - base);
+            if (i + 1 == level.size()) {
+                copy(level[i].begin, level[i].end, at);
+                next.push_back({at, at + level[i].size()});
+            } else {
+                mergeRuns(level[i].begin, level[i].size(), level[i + 1].begin, level[i + 1].size(), at);
+                next.push_back({at, at + level[i].size() + level[i + 1].size()});
+            }
+        }
+        level.swap(next);
+        base = dst;
+        dst = (dst == buffer.data()) ? out : buffer.data();
+    }
+    if (level[0].begin != out) copy(level[0].begin, level[0].end, out);
+}
+
+// K-way merge throughput for k = 2..1024 runs over the same total input. GB/s counts
+// every input byte read plus every output byte written once, so the pairwise baseline's
+// extra passes show up as lower throughput.
+int main() {
+    random_device rd;
+    mt19937 gen(rd());
+    uniform_real_distribution<double> dist(0.0, 1.0);
+
+    const ptrdiff_t n = 1 << 24; // 128 MB of input
+    int num_runs = 5; // Number of times to run each test
+    WorkStealingPool& pool = WorkStealingPool::instance();
+
+    vector<double> in(n), out(n), buffer(n);
+    for (ptrdiff_t i = 0; i < n; i++) {
+        in[i] = dist(gen);
+    }
+
+    for (int k = 2; k <= 1024; k *= 2) {
+        // k equal runs, each sorted in place
+        vector<SortedRun> runs(k);
+        for (int r = 0; r < k; r++) {
+            double* lo = in.data() + n * r / k;
+            double* hi = in.data() + n * (r + 1) / k;
+            sort(lo, hi);
+            runs[r] = {lo, hi};
+        }
+
+        vector<pair<string, function<void()>>> variants = {
+            {"pairwise two-way", [&] { pairwiseMerge(runs.data(), k, out.data(), buffer); }},
+            {"loser tree", [&] { kWayMergeLoserTree(runs.data(), k, out.data()); }},
+            {"merge tree", [&] { kWayMergeTree(runs.data(), k, out.data()); }},
+            {"kWayMerge", [&] { kWayMerge(runs.data(), k, out.data()); }},
+            {"parallelKWayMerge", [&] { parallelKWayMerge(runs.data(), k, out.data(), pool); }},
+        };
+        if (k <= KWAY_SIMD_MAX_RUNS && kWaySIMDKernel()) {
+            variants.insert(variants.begin() + 2, {"simd", [&] { kWaySIMDKernel()(runs.data(), k, out.data()); }});
+        }
+
+        cout << "Merging " << k << " runs of " << n / k << " elements...\n";
+        for (auto& [name, merge] : variants) {
+            vector<double> runtimes;
+            for (int run = 0; run < num_runs; run++) {
+                auto start = high_resolution_clock::now();
+                merge();
+                auto stop = high_resolution_clock::now();
+                runtimes.push_back(duration_cast<nanoseconds>(stop - start).count() / 1e6);
+            }
+            if (!is_sorted(out.begin(), out.end())) {
+                cerr << "Merge failed!" << endl;
+                exit(1);
+            }
+
+            // Compute average runtime (excluding the first run)
+            double sum = 0;
+            for (size_t i = 1; i < runtimes.size(); i++) {
+                sum += runtimes[i];
+            }
+            double avg_time = sum / (num_runs - 1);
+            double gbps = 2.0 * n * sizeof(double) / (avg_time / 1e3) / 1e9;
+            cout << "  " << name << ": " << avg_time << " ms, " << gbps << " GB/s\n";
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
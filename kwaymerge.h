@@ -0,0 +1,347 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "threadpool.h"
+#include "merge.h"
+#include "parallel_merge.h"
+#include "radixsort.h"
+#include "losertree.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KWAY_X86 1
+#endif
+
+// K-way merge of k sorted runs into one output in a single pass, instead of log2(k)
+// passes of two-way merges. Ties are taken from the lower-numbered run, so merging
+// consecutive slices of a stable sort keeps it stable.
+
+constexpr int KWAY_SIMD_MAX_RUNS = 8;   // Runs held in registers by the SIMD kernels
+
+// A sorted input run [begin, end)
+struct SortedRun {
+    const double* begin;
+    const double* end;
+
+    ptrdiff_t size() const { return end - begin; }
+};
+
+using KWayMergeFn = void (*)(const SortedRun* runs, int k, double* out);
+
+inline ptrdiff_t totalSize(const SortedRun* runs, int k) {
+    ptrdiff_t total = 0;
+    for (int i = 0; i < k; i++) total += runs[i].size();
+    return total;
+}
+
+// Loser tree (losertree.h) for any k: every output takes the winner's head, advances
+// that run and replays the winner's path
+inline void kWayMergeLoserTree(const SortedRun* runs, int k, double* out) {
+    LoserTree tree(k);
+    std::vector<const double*> cur(k);
+    for (int i = 0; i < k; i++) {
+        cur[i] = runs[i].begin;
+        if (cur[i] < runs[i].end) tree.set(i, *cur[i]);
+    }
+    tree.build();
+    for (ptrdiff_t o = 0; !tree.empty(); o++) {
+        const int r = tree.winner();
+        out[o] = *cur[r];
+        if (++cur[r] < runs[r].end) {
+            tree.replace(*cur[r]);
+        } else {
+            tree.pop();
+        }
+    }
+}
+
+#ifdef KWAY_X86
+// Branchless kernels for up to 8 runs: the heads of all runs sit in vector registers,
+// every output is a horizontal minimum, a compare that finds the lowest live run holding
+// it, and one lane insert of that run's next element. Exhausted runs hold +inf and are
+// masked out of the run choice.
+__attribute__((target("avx2"))) inline void kWayMergeAVX2(const SortedRun* runs, int k, double* out) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const double* cur[8];
+    const double* end[8];
+    alignas(32) double heads[8];
+    int live = 0;
+    for (int i = 0; i < 8; i++) {
+        bool has = i < k && runs[i].begin < runs[i].end;
+        cur[i] = has ? runs[i].begin : nullptr;
+        end[i] = has ? runs[i].end : nullptr;
+        heads[i] = has ? *cur[i] : inf;
+        live |= has << i;
+    }
+    alignas(32) static const int64_t lane_masks[8][8] = {
+        {-1, 0, 0, 0, 0, 0, 0, 0}, {0, -1, 0, 0, 0, 0, 0, 0}, {0, 0, -1, 0, 0, 0, 0, 0}, {0, 0, 0, -1, 0, 0, 0, 0},
+        {0, 0, 0, 0, -1, 0, 0, 0}, {0, 0, 0, 0, 0, -1, 0, 0}, {0, 0, 0, 0, 0, 0, -1, 0}, {0, 0, 0, 0, 0, 0, 0, -1}};
+
+    __m256d lo = _mm256_load_pd(heads), hi = _mm256_load_pd(heads + 4);
+    const ptrdiff_t total = totalSize(runs, k);
+    for (ptrdiff_t o = 0; o < total; o++) {
+        __m256d m = _mm256_min_pd(lo, hi);
+        m = _mm256_min_pd(m, _mm256_permute2f128_pd(m, m, 1));
+        m = _mm256_min_pd(m, _mm256_permute_pd(m, 0x5));
+        int eq = _mm256_movemask_pd(_mm256_cmp_pd(lo, m, _CMP_EQ_OQ)) |
+                 (_mm256_movemask_pd(_mm256_cmp_pd(hi, m, _CMP_EQ_OQ)) << 4);
+        const int r = __builtin_ctz(eq & live);
+        out[o] = *cur[r];   // The run's own element, so -0.0 and +0.0 are never swapped
+
+        const bool more = ++cur[r] < end[r];
+        live &= ~((!more) << r);
+        const __m256d next = _mm256_set1_pd(more ? *cur[r] : inf);
+        lo = _mm256_blendv_pd(lo, next, _mm256_load_pd((const double*)lane_masks[r]));
+        hi = _mm256_blendv_pd(hi, next, _mm256_load_pd((const double*)lane_masks[r] + 4));
+    }
+}
+
+__attribute__((target("avx512f"))) inline void kWayMergeAVX512(const SortedRun* runs, int k, double* out) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const double* cur[8];
+    const double* end[8];
+    alignas(64) double heads[8];
+    __mmask8 live = 0;
+    for (int i = 0; i < 8; i++) {
+        bool has = i < k && runs[i].begin < runs[i].end;
+        cur[i] = has ? runs[i].begin : nullptr;
+        end[i] = has ? runs[i].end : nullptr;
+        heads[i] = has ? *cur[i] : inf;
+        live |= has << i;
+    }
+
+    __m512d h = _mm512_load_pd(heads);
+    const ptrdiff_t total = totalSize(runs, k);
+    for (ptrdiff_t o = 0; o < total; o++) {
+        __m512d m = _mm512_min_pd(h, _mm512_shuffle_f64x2(h, h, 0x4E));
+        m = _mm512_min_pd(m, _mm512_permutex_pd(m, 0x4E));
+        m = _mm512_min_pd(m, _mm512_permute_pd(m, 0x55));
+        const int r = __builtin_ctz(_mm512_mask_cmp_pd_mask(live, h, m, _CMP_EQ_OQ));
+        out[o] = *cur[r];
+
+        const bool more = ++cur[r] < end[r];
+        live &= ~((!more) << r);
+        h = _mm512_mask_broadcastsd_pd(h, __mmask8(1 << r), _mm_set_sd(more ? *cur[r] : inf));
+    }
+}
+#endif
+
+constexpr ptrdiff_t KWAY_TREE_BUFFER_BYTES = 1 << 20;   // All internal node buffers together (about one L2)
+
+// Streaming tree of two-way merges for any k: every internal node owns a small buffer
+// that it refills by merging blocks of its children's buffers with the SIMD two-way
+// kernel. The data still crosses memory once, as with the loser tree, but almost all
+// of the work runs in mergeRuns. A node only emits the prefix it is sure of: every
+// element up to the smaller of its children's last buffered keys.
+class KWayMergeTree {
+public:
+    KWayMergeTree(const SortedRun* runs, int k)
+        : block_(std::max<ptrdiff_t>(512, KWAY_TREE_BUFFER_BYTES / (ptrdiff_t)sizeof(double) / std::max(1, k - 1))) {
+        nodes_.reserve(2 * k);
+        root_ = build(runs, 0, k);
+    }
+
+    // Writes the whole merge to out
+    void mergeInto(double* out) {
+        Node& root = nodes_[root_];
+        if (root.left < 0) {
+            std::copy(root.data, root.data + root.len, out);
+            return;
+        }
+        while (!root.done) out += produce(root, out, std::numeric_limits<ptrdiff_t>::max());
+    }
+
+private:
+    struct Node {
+        int left = -1, right = -1;   // -1 for a leaf, which streams its run directly
+        const double* data = nullptr;
+        ptrdiff_t pos = 0, len = 0;  // Unread elements are data[pos, len)
+        bool done = false;           // Nothing arrives beyond data[len)
+        std::vector<double> buffer;
+
+        ptrdiff_t avail() const { return len - pos; }
+    };
+
+    int build(const SortedRun* runs, int lo, int hi) {
+        const int id = nodes_.size();
+        nodes_.emplace_back();
+        if (hi - lo == 1) {
+            nodes_[id].data = runs[lo].begin;
+            nodes_[id].len = runs[lo].size();
+            nodes_[id].done = true;
+            return id;
+        }
+        const int mid = lo + (hi - lo) / 2;
+        const int left = build(runs, lo, mid);
+        const int right = build(runs, mid, hi);
+        Node& node = nodes_[id];
+        node.left = left;
+        node.right = right;
+        node.buffer.resize(block_);
+        node.data = node.buffer.data();
+        return id;
+    }
+
+    void refill(Node& node) {
+        const ptrdiff_t keep = node.avail();
+        std::memmove(node.buffer.data(), node.buffer.data() + node.pos, keep * sizeof(double));
+        node.pos = 0;
+        node.len = keep + produce(node, node.buffer.data() + keep, block_ - keep);
+    }
+
+    // Merges up to cap elements from node's children into dst and returns the count;
+    // marks node done once both children are exhausted
+    ptrdiff_t produce(Node& node, double* dst, ptrdiff_t cap) {
+        Node& A = nodes_[node.left];
+        Node& B = nodes_[node.right];
+        ptrdiff_t produced = 0;
+        while (produced < cap) {
+            if (A.avail() == 0 && !A.done) refill(A);
+            if (B.avail() == 0 && !B.done) refill(B);
+            const double* a = A.data + A.pos;
+            const double* b = B.data + B.pos;
+            const ptrdiff_t na = A.avail(), nb = B.avail();
+            if (na == 0 && nb == 0) {
+                node.done = true;
+                break;
+            }
+
+            // A child that is not done has buffered data, so the safe prefix is never empty
+            ptrdiff_t ta = na, tb = nb;
+            if (!A.done && (B.done || a[na - 1] <= b[nb - 1])) {
+                tb = std::lower_bound(b, b + nb, a[na - 1]) - b;   // Equal b elements follow A's pending ones
+            } else if (!B.done) {
+                ta = std::upper_bound(a, a + na, b[nb - 1]) - a;
+            }
+            ptrdiff_t t = std::min(ta + tb, cap - produced);
+            ptrdiff_t i = t < ta + tb ? coRank(t, a, ta, b, tb) : ta;
+            mergeRuns(a, i, b, t - i, dst + produced);
+            A.pos += i;
+            B.pos += t - i;
+            produced += t;
+        }
+        return produced;
+    }
+
+    ptrdiff_t block_;
+    std::vector<Node> nodes_;
+    int root_;
+};
+
+inline void kWayMergeTree(const SortedRun* runs, int k, double* out) {
+    KWayMergeTree(runs, k).mergeInto(out);
+}
+
+// Kernel for k <= KWAY_SIMD_MAX_RUNS on this CPU, or nullptr without AVX2
+inline KWayMergeFn kWaySIMDKernel() {
+    static const KWayMergeFn kernel = [] {
+#ifdef KWAY_X86
+        if (__builtin_cpu_supports("avx512f")) return (KWayMergeFn)kWayMergeAVX512;
+        if (__builtin_cpu_supports("avx2")) return (KWayMergeFn)kWayMergeAVX2;
+#endif
+        return (KWayMergeFn) nullptr;
+    }();
+    return kernel;
+}
+
+// Merges runs[0..k) into out: one run is a copy, two runs use the two-way merge kernel,
+// more use the streaming merge tree
+inline void kWayMerge(const SortedRun* runs, int k, double* out) {
+    if (k == 1) {
+        if (runs[0].size() > 0) std::memcpy(out, runs[0].begin, runs[0].size() * sizeof(double));
+    } else if (k == 2) {
+        mergeRuns(runs[0].begin, runs[0].size(), runs[1].begin, runs[1].size(), out);
+    } else if (k > 0) {
+        kWayMergeTree(runs, k, out);
+    }
+}
+
+// Multiway co-rank: per-run split positions whose sum is `rank`, such that everything
+// left of the splits precedes everything right of them in the stable merge. The rank-th
+// key is found by bisecting the order-preserving key space (see doubleToKey); its equal
+// elements are then handed out to the lowest-numbered runs first.
+inline void multiwaySplit(const SortedRun* runs, int k, ptrdiff_t rank, ptrdiff_t* split) {
+    auto count_le = [&](double x) {
+        ptrdiff_t count = 0;
+        for (int i = 0; i < k; i++) count += std::upper_bound(runs[i].begin, runs[i].end, x) - runs[i].begin;
+        return count;
+    };
+    if (rank >= totalSize(runs, k)) {
+        for (int i = 0; i < k; i++) split[i] = runs[i].size();
+        return;
+    }
+
+    // Smallest key whose count of elements <= it exceeds rank
+    uint64_t lo = doubleToKey(-std::numeric_limits<double>::infinity());
+    uint64_t hi = doubleToKey(std::numeric_limits<double>::infinity());
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (count_le(keyToDouble(mid)) > rank) hi = mid;
+        else lo = mid + 1;
+    }
+    const double x = keyToDouble(lo);
+
+    ptrdiff_t remaining = rank;
+    for (int i = 0; i < k; i++) {
+        split[i] = std::lower_bound(runs[i].begin, runs[i].end, x) - runs[i].begin;
+        remaining -= split[i];
+    }
+    for (int i = 0; i < k && remaining > 0; i++) {
+        ptrdiff_t equal = (std::upper_bound(runs[i].begin, runs[i].end, x) - runs[i].begin) - split[i];
+        ptrdiff_t take = std::min(equal, remaining);
+        split[i] += take;
+        remaining -= take;
+    }
+}
+
+// kWayMerge with the output cut into equal chunks on the pool: each chunk finds its
+// start in every run with multiwaySplit and merges its slices independently
+inline void parallelKWayMerge(const SortedRun* runs, int k, double* out, WorkStealingPool& pool, int max_chunks = 0) {
+    const ptrdiff_t total = totalSize(runs, k);
+    const int chunks = parallelChunks(total, pool, max_chunks);
+    if (chunks == 1) {
+        kWayMerge(runs, k, out);
+        return;
+    }
+
+    std::vector<ptrdiff_t> splits((chunks + 1) * k);
+    {
+        TaskGroup group(pool);
+        for (int c = 0; c <= chunks; c++) {
+            group.run([&, c] { multiwaySplit(runs, k, total * c / chunks, splits.data() + c * k); });
+        }
+        group.wait();
+    }
+
+    TaskGroup group(pool);
+    for (int c = 0; c < chunks; c++) {
+        group.run([&, c] {
+            std::vector<SortedRun> slices(k);
+            for (int i = 0; i < k; i++) {
+                slices[i] = {runs[i].begin + splits[c * k + i], runs[i].begin + splits[(c + 1) * k + i]};
+            }
+            kWayMerge(slices.data(), k, out + total * c / chunks);
+        });
+    }
+    group.wait();
+}
+
+// Convenience entry point for already-sorted partitions
+inline std::vector<double> mergeSortedRuns(const std::vector<std::vector<double>>& partitions,
+                                           WorkStealingPool& pool = WorkStealingPool::instance()) {
+    std::vector<SortedRun> runs;
+    size_t total = 0;
+    for (const auto& p : partitions) {
+        runs.push_back({p.data(), p.data() + p.size()});
+        total += p.size();
+    }
+    std::vector<double> out(total);
+    if (!runs.empty()) parallelKWayMerge(runs.data(), runs.size(), out.data(), pool);
+    return out;
+}
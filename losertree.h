@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Tournament tree of losers over k sources of sorted doubles. Every internal node keeps
+// the loser of the match played there and the overall winner sits in node 0, so
+// replacing the winner's key replays only the log2(k) matches on its path to the root.
+// Ties go to the lower source index, which keeps a merge of runs stable. Nodes hold
+// (key, source) so a replay never leaves the tree array. An exhausted source enters as
+// (+inf, k + source), which loses to every live key, so the data itself may contain
+// +infinity.
+class LoserTree {
+public:
+    explicit LoserTree(int k) : k_(k), leaves_(k), tree_(std::max(k, 1)) {
+        for (int i = 0; i < k; i++) leaves_[i] = exhausted(i);
+    }
+
+    int size() const { return k_; }
+
+    // Set the first key of every source (or leave it empty), then build()
+    void set(int source, double key) { leaves_[source] = {key, source}; }
+
+    void build() {
+        std::vector<Node> winners(2 * k_);
+        for (int i = 0; i < k_; i++) winners[k_ + i] = leaves_[i];
+        for (int node = k_ - 1; node > 0; node--) {
+            const Node& a = winners[2 * node];
+            const Node& b = winners[2 * node + 1];
+            const bool a_wins = beats(a, b);
+            winners[node] = a_wins ? a : b;
+            tree_[node] = a_wins ? b : a;
+        }
+        tree_[0] = k_ > 0 ? winners[1] : exhausted(0);
+    }
+
+    bool empty() const { return tree_[0].source >= k_; }
+    int winner() const { return tree_[0].source; }
+    double top() const { return tree_[0].key; }
+
+    // The winner's source produced its next key
+    void replace(double key) {
+        const int source = tree_[0].source;
+        replay({key, source}, source);
+    }
+
+    // The winner's source is exhausted
+    void pop() {
+        const int source = tree_[0].source;
+        replay(exhausted(source), source);
+    }
+
+private:
+    struct Node {
+        double key;
+        int source;
+    };
+
+    Node exhausted(int source) const { return {std::numeric_limits<double>::infinity(), k_ + source}; }
+
+    static bool beats(const Node& a, const Node& b) { return a.key < b.key || (a.key == b.key && a.source < b.source); }
+
+    void replay(Node winner, int source) {
+        for (int node = (source + k_) / 2; node > 0; node /= 2) {
+            if (beats(tree_[node], winner)) std::swap(tree_[node], winner);
+        }
+        tree_[0] = winner;
+    }
+
+    int k_;
+    std::vector<Node> leaves_;   // First key of every source, for build()
+    std::vector<Node> tree_;     // tree_[0] = winner, tree_[1..k) = losers
+};
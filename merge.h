@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>  // For std::memcpy
+#include <map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MERGE_X86 1
+#endif
+
+// Merge kernels shared by every merge sort variant. Each kernel merges the sorted runs
+// a[0..na) and b[0..nb) into out, taking ties from a first.
+using MergeRunsFn = void (*)(const double* a, ptrdiff_t na, const double* b, ptrdiff_t nb, double* out);
+
+// Reference kernel: the original `(aux[i] <= aux[j]) ? aux[i++] : aux[j++]` loop
+inline void mergeRunsBranchy(const double* a, ptrdiff_t na, const double* b, ptrdiff_t nb, double* out) {
+    ptrdiff_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        out[k++] = (a[i] <= b[j]) ? a[i++] : b[j++];
+    }
+    while (i < na) out[k++] = a[i++];
+    while (j < nb) out[k++] = b[j++];
+}
+
+// Branchless scalar kernel: the comparison result selects the value and advances the
+// indices arithmetically, so random input costs no mispredictions in the main loop
+inline void mergeRunsBranchless(const double* a, ptrdiff_t na, const double* b, ptrdiff_t nb, double* out) {
+    ptrdiff_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        double x = a[i], y = b[j];
+        bool take_b = y < x;
+        out[k++] = take_b ? y : x;
+        j += take_b;
+        i += !take_b;
+    }
+    if (i < na) std::memcpy(out + k, a + i, (na - i) * sizeof(double));
+    if (j < nb) std::memcpy(out + k, b + j, (nb - j) * sizeof(double));
+}
+
+// Finishes a vector merge: `held` sorted elements still in registers plus the rest of
+// both runs (at least one of them shorter than a register). The held elements are first
+// merged with the short remainder into a small buffer, then with the long remainder.
+inline void mergeRunsTail(const double* held, ptrdiff_t nheld, const double* a, ptrdiff_t na, const double* b, ptrdiff_t nb, double* out) {
+    double small[16];
+    if (na < nb) {
+        mergeRunsBranchless(held, nheld, a, na, small);
+        mergeRunsBranchless(small, nheld + na, b, nb, out);
+    } else {
+        mergeRunsBranchless(held, nheld, b, nb, small);
+        mergeRunsBranchless(small, nheld + nb, a, na, out);
+    }
+}
+
+#ifdef MERGE_X86
+// Bitonic merge network kernels (Inoue/Chhugani style): two sorted registers are merged
+// by reversing one, a min/max step and log2(W) in-register clean-up steps. The low half
+// is stored, the high half stays in a register and is merged with the next block of
+// whichever run has the smaller head.
+__attribute__((target("avx2"), always_inline)) inline void bitonicMerge4(__m256d& lo, __m256d& hi) {
+    __m256d r = _mm256_permute4x64_pd(hi, 0x1B);
+    __m256d l = _mm256_min_pd(lo, r), h = _mm256_max_pd(lo, r);
+    // Clean-up steps on both bitonic halves: compare distance 2, then distance 1
+    __m256d ls = _mm256_permute2f128_pd(l, l, 1), hs = _mm256_permute2f128_pd(h, h, 1);
+    l = _mm256_blend_pd(_mm256_min_pd(l, ls), _mm256_max_pd(l, ls), 0b1100);
+    h = _mm256_blend_pd(_mm256_min_pd(h, hs), _mm256_max_pd(h, hs), 0b1100);
+    ls = _mm256_permute_pd(l, 0x5);
+    hs = _mm256_permute_pd(h, 0x5);
+    lo = _mm256_blend_pd(_mm256_min_pd(l, ls), _mm256_max_pd(l, ls), 0b1010);
+    hi = _mm256_blend_pd(_mm256_min_pd(h, hs), _mm256_max_pd(h, hs), 0b1010);
+}
+
+__attribute__((target("avx2"))) inline void mergeRunsAVX2(const double* a, ptrdiff_t na, const double* b, ptrdiff_t nb, double* out) {
+    if (na < 4 || nb < 4) {
+        mergeRunsBranchless(a, na, b, nb, out);
+        return;
+    }
+    __m256d lo = _mm256_loadu_pd(a), hi = _mm256_loadu_pd(b);
+    ptrdiff_t i = 4, j = 4, k = 0;
+    while (true) {
+        bitonicMerge4(lo, hi);
+        _mm256_storeu_pd(out + k, lo);
+        k += 4;
+        lo = hi;
+        if (i + 4 > na || j + 4 > nb) break;
+        if (a[i] <= b[j]) {
+            hi = _mm256_loadu_pd(a + i);
+            i += 4;
+        } else {
+            hi = _mm256_loadu_pd(b + j);
+            j += 4;
+        }
+    }
+    alignas(32) double held[4];
+    _mm256_store_pd(held, lo);
+    mergeRunsTail(held, 4, a + i, na - i, b + j, nb - j, out + k);
+}
+
+__attribute__((target("avx512f"), always_inline)) inline void bitonicMerge8(__m512d& lo, __m512d& hi) {
+    __m512d r = _mm512_permutexvar_pd(_mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7), hi);
+    __m512d l = _mm512_min_pd(lo, r), h = _mm512_max_pd(lo, r);
+    __m512d ls = _mm512_shuffle_f64x2(l, l, 0x4E), hs = _mm512_shuffle_f64x2(h, h, 0x4E);
+    l = _mm512_mask_blend_pd(0xF0, _mm512_min_pd(l, ls), _mm512_max_pd(l, ls));
+    h = _mm512_mask_blend_pd(0xF0, _mm512_min_pd(h, hs), _mm512_max_pd(h, hs));
+    ls = _mm512_permutex_pd(l, 0x4E);
+    hs = _mm512_permutex_pd(h, 0x4E);
+    l = _mm512_mask_blend_pd(0xCC, _mm512_min_pd(l, ls), _mm512_max_pd(l, ls));
+    h = _mm512_mask_blend_pd(0xCC, _mm512_min_pd(h, hs), _mm512_max_pd(h, hs));
+    ls = _mm512_permute_pd(l, 0x55);
+    hs = _mm512_permute_pd(h, 0x55);
+    lo = _mm512_mask_blend_pd(0xAA, _mm512_min_pd(l, ls), _mm512_max_pd(l, ls));
+    hi = _mm512_mask_blend_pd(0xAA, _mm512_min_pd(h, hs), _mm512_max_pd(h, hs));
+}
+
+__attribute__((target("avx512f"))) inline void mergeRunsAVX512(const double* a, ptrdiff_t na, const double* b, ptrdiff_t nb, double* out) {
+    if (na < 8 || nb < 8) {
+        mergeRunsBranchless(a, na, b, nb, out);
+        return;
+    }
+    __m512d lo = _mm512_loadu_pd(a), hi = _mm512_loadu_pd(b);
+    ptrdiff_t i = 8, j = 8, k = 0;
+    while (true) {
+        bitonicMerge8(lo, hi);
+        _mm512_storeu_pd(out + k, lo);
+        k += 8;
+        lo = hi;
+        if (i + 8 > na || j + 8 > nb) break;
+        if (a[i] <= b[j]) {
+            hi = _mm512_loadu_pd(a + i);
+            i += 8;
+        } else {
+            hi = _mm512_loadu_pd(b + j);
+            j += 8;
+        }
+    }
+    alignas(64) double held[8];
+    _mm512_store_pd(held, lo);
+    mergeRunsTail(held, 8, a + i, na - i, b + j, nb - j, out + k);
+}
+#endif
+
+// SIMD bitonic-merge kernel for the widest instruction set of this CPU (branchless scalar otherwise)
+inline void mergeRunsSIMD(const double* a, ptrdiff_t na, const double* b, ptrdiff_t nb, double* out) {
+    static const MergeRunsFn kernel = [] {
+#ifdef MERGE_X86
+        if (__builtin_cpu_supports("avx512f")) return (MergeRunsFn)mergeRunsAVX512;
+        if (__builtin_cpu_supports("avx2")) return (MergeRunsFn)mergeRunsAVX2;
+#endif
+        return (MergeRunsFn)mergeRunsBranchless;
+    }();
+    kernel(a, na, b, nb, out);
+}
+
+// Kernel used by merge() and the parallel merge; replaceable for benchmarking and tuning
+inline MergeRunsFn& activeMergeKernel() {
+    static MergeRunsFn kernel = mergeRunsSIMD;
+    return kernel;
+}
+
+inline void mergeRuns(const double* a, ptrdiff_t na, const double* b, ptrdiff_t nb, double* out) {
+    activeMergeKernel()(a, na, b, nb, out);
+}
+
+// Optimized Merge function using a preallocated auxiliary array
+inline void merge(std::vector<double>& arr, std::vector<double>& aux, ptrdiff_t left, ptrdiff_t mid, ptrdiff_t right) {
+    std::memcpy(aux.data() + left, arr.data() + left, (right - left + 1) * sizeof(double));
+    mergeRuns(aux.data() + left, mid - left + 1, aux.data() + mid + 1, right - mid, arr.data() + left);
+}
+
+// Bytes read plus written by the merge steps of a top-down merge sort of n elements with
+// leaves of up to k elements. The copy mode pays a memcpy into aux and the merge itself
+// at every level; ping-pong mode pays only the merge, plus one up-front copy.
+inline long long mergeTraffic(long long n, int k, bool ping_pong) {
+    long long bytes = ping_pong ? 2 * n * (long long)sizeof(double) : 0;
+    std::map<long long, long long> level = {{n, 1}};   // Subarray length -> count at this depth
+    while (!level.empty()) {
+        std::map<long long, long long> next;
+        for (auto [len, count] : level) {
+            if (len <= k || len < 2) continue;
+            bytes += count * (ping_pong ? 2 : 4) * len * (long long)sizeof(double);
+            next[(len + 1) / 2] += count;
+            next[len / 2] += count;
+        }
+        level.swap(next);
+    }
+    return bytes;
+}
+
+// mergeTraffic summed over the sorts a benchmark runs, for its merge_bytes counter. A sort
+// only records its (n, k, mode) with add(); bytes() does the arithmetic, so none of it
+// lands in the timed region.
+class MergeTrafficTally {
+public:
+    void add(long long n, int k, bool ping_pong) {
+        if (pending_ > 0 && (n != n_ || k != k_ || ping_pong != ping_pong_)) flush();
+        n_ = n;
+        k_ = k;
+        ping_pong_ = ping_pong;
+        pending_++;
+    }
+
+    double bytes() {
+        flush();
+        return total_;
+    }
+
+private:
+    void flush() {
+        if (pending_ > 0) total_ += (double)pending_ * mergeTraffic(n_, k_, ping_pong_);
+        pending_ = 0;
+    }
+
+    long long n_ = 0, pending_ = 0;
+    int k_ = 1;
+    bool ping_pong_ = false;
+    double total_ = 0;
+};
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "merge.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Merge throughput of each kernel, from L1-resident to DRAM-resident run lengths.
+// GB/s counts every byte read from the two runs plus every byte written to the output.
+int main() {
+    // Use high-quality random number generator
+    random_device rd;
+    mt19937 gen(rd());
+    uniform_real_distribution<double> dist(0.0, 1.0);
+
+    // Total elements per merge: 16 KB, 128 KB, 1 MB, 8 MB, 64 MB and 512 MB of input
+    vector<int> sizes = {2048, 16384, 131072, 1048576, 8388608, 67108864};
+    vector<pair<const char*, MergeRunsFn>> kernels = {
+        {"branchy", mergeRunsBranchy},
+        {"branchless", mergeRunsBranchless},
+        {"simd", mergeRunsSIMD},
+    };
+    int num_runs = 10; // Number of times to run each test
+    const double min_run_ms = 20; // Repeat small merges until a run takes at least this long
+
+    for (int n : sizes) {
+        vector<double> in(n), out(n);
+        for (int i = 0; i < n; i++) {
+            in[i] = dist(gen);
+        }
+        int half = n / 2;
+        sort(in.begin(), in.begin() + half);
+        sort(in.begin() + half, in.end());
+
+        cout << "Merging " << half << " + " << n - half << " elements (" << n * sizeof(double) / 1024 << " KB input)...\n";
+
+        for (auto& [name, kernel] : kernels) {
+            // Calibrate the repeat count so every timed run is long enough to measure
+            int reps = 1;
+            while (true) {
+                auto start = high_resolution_clock::now();
+                for (int r = 0; r < reps; r++) kernel(in.data(), half, in.data() + half, n - half, out.data());
+                double ms = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count() / 1e6;
+                if (ms >= min_run_ms || reps >= (1 << 20)) break;
+                reps *= 2;
+            }
+
+            vector<double> runtimes;
+            for (int run = 0; run < num_runs; run++) {
+                auto start = high_resolution_clock::now();
+                for (int r = 0; r < reps; r++) kernel(in.data(), half, in.data() + half, n - half, out.data());
+                auto stop = high_resolution_clock::now();
+                runtimes.push_back(duration_cast<nanoseconds>(stop - start).count() / 1e6 / reps);
+            }
+            if (!is_sorted(out.begin(), out.end())) {
+                cerr << "Merge failed!" << endl;
+                exit(1);
+            }
+
+            // Compute average runtime (excluding the first run)
+            double sum = 0;
+            for (size_t i = 1; i < runtimes.size(); i++) {
+                sum += runtimes[i];
+            }
+            double avg_time = sum / (num_runs - 1);
+            double gbps = 2.0 * n * sizeof(double) / (avg_time / 1e3) / 1e9;
+            cout << "  " << name << ": " << avg_time << " ms per merge, " << gbps << " GB/s\n";
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
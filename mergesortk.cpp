@@ -1,16 +1,15 @@
-#include <iostream>
 #include <vector>
-#include <random>
-#include <ctime>
-#include <chrono>
 #include <cstring>  // For std::memcpy
+#include <string>
+#include "merge.h"
+#include "sortnet.h"
+#include "bench.h"
 
 using namespace std;
-using namespace std::chrono;
-void insertionSort(vector<double>& arr, int left, int right) {
-    for (int i = left + 1; i <= right; i++) {
+void insertionSort(vector<double>& arr, ptrdiff_t left, ptrdiff_t right) {
+    for (ptrdiff_t i = left + 1; i <= right; i++) {
         double key = arr[i];
-        int j = i - 1;
+        ptrdiff_t j = i - 1;
         while (j >= left && arr[j] > key) {
             arr[j + 1] = arr[j];
             j--;
@@ -18,141 +17,78 @@ void insertionSort(vector<double>& arr, int left, int right) {
         arr[j + 1] = key;
     }
 }
-// Optimized Merge function using a preallocated auxiliary array
-void merge(vector<double>& arr, vector<double>& aux, int left, int mid, int right) {
-    memcpy(aux.data() + left, arr.data() + left, (right - left + 1) * sizeof(double));
-
-    int i = left, j = mid + 1, k = left;
-    
-    while (i <= mid && j <= right) {
-        arr[k++] = (aux[i] <= aux[j]) ? aux[i++] : aux[j++];
-    }
-
-    while (i <= mid) arr[k++] = aux[i++];
-    while (j <= right) arr[k++] = aux[j++];
-}
 
-// Optimized Merge Sort with preallocated auxiliary array
-void mergeSort(vector<double>& arr, vector<double>& aux, int left, int right, int k) {
+// Optimized Merge Sort with preallocated auxiliary array; leaves of up to k elements go to leaf
+void mergeSort(vector<double>& arr, vector<double>& aux, ptrdiff_t left, ptrdiff_t right, int k, LeafSortFn leaf = insertionSort) {
     if (right - left + 1 <= k) {
         // sort(arr.begin() + left, arr.begin() + right + 1);
         //insetionsort is faster than built in sort
-        insertionSort(arr, left, right);
+        leaf(arr, left, right);
         return;
     }
     if (left < right) {
-        int mid = left + (right - left) / 2;
-        mergeSort(arr, aux, left, mid, k);
-        mergeSort(arr, aux, mid + 1, right, k);
+        ptrdiff_t mid = left + (right - left) / 2;
+        mergeSort(arr, aux, left, mid, k, leaf);
+        mergeSort(arr, aux, mid + 1, right, k, leaf);
         merge(arr, aux, left, mid, right);
     }
 }
 
-int main() {
-    // Use high-quality random number generator
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<double> dist(0.0, 1.0);
-
-    vector<int> sizes = {1000, 10000, 100000, 1000000, 10000000, 100000000}; // Array sizes
-    vector<int> k_values = {5, 10, 20, 30, 50, 100};
-    int num_runs = 10; // Number of times to run each test
-
-    for (int n : sizes) {
-        vector<double> arr(n);
-        arr.reserve(n);  // Preallocate memory
-
-        for (int i = 0; i < n; i++) {
-            arr[i] = dist(gen);  // Faster random number generation
-        }
-
-        cout << "Optimizing k for n = " << n << " elements...\n";
-
-        double best_time = 1e9;
-        int best_k = k_values[0];
-
-        vector<double> runtimes;
-        vector<double> aux(n); // Preallocate auxiliary array
-        for(int k : k_values) {
-            vector<double> runtimes;
-            for (int run = 0; run < num_runs; run++) {
-                vector<double> temp(n);
-                memcpy(temp.data(), arr.data(), n * sizeof(double)); // Faster copying
-
-                auto start = high_resolution_clock::now();
-                mergeSort(temp, aux, 0, n - 1, k);
-                auto stop = high_resolution_clock::now();
-
-                double duration = duration_cast<nanoseconds>(stop - start).count() / 1e6; // Convert to ms
-                if (!is_sorted(temp.begin(), temp.end())) {
-                    cerr << "Sorting failed!" << endl;
-                    exit(1);
-                }
-                runtimes.push_back(duration);
-
-            }
+// Ping-pong variant: src and dst hold the same data on entry and the sorted range ends up
+// in dst. Halves are sorted into src (roles swap every level) and merged straight into dst,
+// so each level writes every element once; leaves are sorted in place in dst.
+void mergeSortInto(vector<double>& src, vector<double>& dst, ptrdiff_t left, ptrdiff_t right, int k, LeafSortFn leaf = insertionSort) {
+    if (right - left + 1 <= k) {
+        leaf(dst, left, right);
+        return;
+    }
+    if (left < right) {
+        ptrdiff_t mid = left + (right - left) / 2;
+        mergeSortInto(dst, src, left, mid, k, leaf);
+        mergeSortInto(dst, src, mid + 1, right, k, leaf);
+        mergeRuns(src.data() + left, mid - left + 1, src.data() + mid + 1, right - mid, dst.data() + left);
+    }
+}
 
-            // Compute average runtime (excluding the first run)
-            double sum = 0;
-            for (size_t i = 1; i < runtimes.size(); i++) {
-                sum += runtimes[i];
-            }
-            double avg_time = sum / (num_runs - 1);
+// One up-front copy into aux replaces the memcpy of every merge
+void pingPongMergeSort(vector<double>& arr, vector<double>& aux, ptrdiff_t left, ptrdiff_t right, int k, LeafSortFn leaf = insertionSort) {
+    memcpy(aux.data() + left, arr.data() + left, (right - left + 1) * sizeof(double));
+    mergeSortInto(aux, arr, left, right, k, leaf);
+}
 
-            cout << "k = " << k << ", Avg runtime: " << avg_time << " ms\n";
-            if (avg_time < best_time) {
-                best_time = avg_time;
-                best_k = k;
-            }
+int main(int argc, char* argv[]) {
+    vector<int> k_values = {5, 8, 10, 16, 20, 30, 32, 50, 64, 100};
+
+    // Variants to compare at every k: scalar insertion sort vs. SIMD sorting-network leaves,
+    // each with a copy into aux per merge or with ping-pong buffers
+    struct Variant {
+        const char* name;
+        LeafSortFn leaf;
+        bool ping_pong;
+    };
+    vector<Variant> variants = {
+        {"insertion", insertionSort, false},
+        {"network", networkSort, false},
+        {"insertion+ping-pong", insertionSort, true},
+        {"network+ping-pong", networkSort, true},
+    };
+
+    // One engine per (k, variant); the harness reports the fastest for every size, with the
+    // bytes its merges move (mergeTraffic) as merge_bytes
+    MergeTrafficTally traffic;
+    vector<BenchEngine> engines;
+    for (int k : k_values) {
+        for (auto& [name, leaf, ping_pong] : variants) {
+            engines.push_back({string(name) + "/k=" + to_string(k), [k, leaf, ping_pong, &traffic](vector<double>& arr, vector<double>& aux, const BenchContext&) {
+                                   ptrdiff_t n = arr.size();
+                                   if (ping_pong) {
+                                       pingPongMergeSort(arr, aux, 0, n - 1, k, leaf);
+                                   } else {
+                                       mergeSort(arr, aux, 0, n - 1, k, leaf);
+                                   }
+                                   traffic.add(n, k, ping_pong);
+                               }});
         }
-        cout << "Best k for n = " << n << " is " << best_k << " with avg time: " << best_time << " ms\n\n";
     }
-
-    return 0;
+    return benchMain(argc, argv, engines, {{"merge_bytes", [&] { return traffic.bytes(); }}});
 }
-// int main() {
-//     // Use high-quality random number generator
-//     random_device rd;
-//     mt19937 gen(rd());
-//     uniform_real_distribution<double> dist(0.0, 1.0);
-
-//     vector<int> sizes = {1000, 10000, 100000, 1000000, 10000000, 100000000}; // Array sizes
-//     vector<int> k_values = {5, 10, 20, 30, 50, 100};
-//     int num_runs = 10; // Number of times to run each test
-
-//     for (int n : sizes) {
-//         vector<double> arr(n);
-//         arr.reserve(n);  // Preallocate memory
-
-//         for (int i = 0; i < n; i++) {
-//             arr[i] = dist(gen);  // Faster random number generation
-//         }
-
-//         cout << "Sorting " << n << " elements..." << endl;
-
-//         vector<double> runtimes;
-//         vector<double> aux(n); // Preallocate auxiliary array
-//         for (int run = 0; run < num_runs; run++) {
-//             vector<double> temp(n);
-//             memcpy(temp.data(), arr.data(), n * sizeof(double)); // Faster copying
-
-//             auto start = high_resolution_clock::now();
-//             mergeSort(temp, aux, 0, n - 1, 50);
-//             auto stop = high_resolution_clock::now();
-
-//             double duration = duration_cast<nanoseconds>(stop - start).count() / 1e6; // Convert to ms
-//             runtimes.push_back(duration);
-
-//         }
-
-//         // Compute average runtime (excluding the first run)
-//         double sum = 0;
-//         for (size_t i = 1; i < runtimes.size(); i++) {
-//             sum += runtimes[i];
-//         }
-//         double avg_time = sum / (num_runs - 1);
-//         cout << "Average runtime for n = " << n << ": " << avg_time << " ms\n" << endl;
-//     }
-
-//     return 0;
-// }
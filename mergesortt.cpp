@@ -1,46 +1,32 @@
-#include <iostream>
 #include <vector>
-#include <random>
-#include <ctime>
-#include <chrono>
-#include <cstring>  // For std::memcpy
-#include <thread>
+#include <string>
+#include "threadpool.h"
+#include "merge.h"
+#include "parallel_merge.h"
+#include "bench.h"
 
 using namespace std;
-using namespace std::chrono;
 
-const int MAX_THREADS = thread::hardware_concurrency(); // Get number of CPU cores
-
-// Optimized Merge function using a preallocated auxiliary array
-void merge(vector<double>& arr, vector<double>& aux, int left, int mid, int right) {
-    memcpy(aux.data() + left, arr.data() + left, (right - left + 1) * sizeof(double));
-
-    int i = left, j = mid + 1, k = left;
-    
-    while (i <= mid && j <= right) {
-        arr[k++] = (aux[i] <= aux[j]) ? aux[i++] : aux[j++];
-    }
-
-    while (i <= mid) arr[k++] = aux[i++];
-    while (j <= right) arr[k++] = aux[j++];
-}
-
-// Parallel Merge Sort with adjustable MIN_THREAD_SIZE
-void mergeSort(vector<double>& arr, vector<double>& aux, int left, int right, int MIN_THREAD_SIZE) {
+// Parallel Merge Sort with adjustable MIN_THREAD_SIZE, left halves run on the work-stealing pool
+void mergeSort(vector<double>& arr, vector<double>& aux, ptrdiff_t left, ptrdiff_t right, ptrdiff_t MIN_THREAD_SIZE,
+               WorkStealingPool& pool = WorkStealingPool::instance()) {
     if (left < right) {
-        int mid = left + (right - left) / 2;
+        ptrdiff_t mid = left + (right - left) / 2;
 
-        // Use threads if the subarray is large enough
+        // Use the pool if the subarray is large enough
         if ((right - left) > MIN_THREAD_SIZE) {
-            thread leftThread(mergeSort, ref(arr), ref(aux), left, mid, MIN_THREAD_SIZE);
-            mergeSort(arr, aux, mid + 1, right, MIN_THREAD_SIZE);
-            leftThread.join(); // Ensure left half is sorted before merging
+            TaskGroup group(pool);
+            group.run([&] { mergeSort(arr, aux, left, mid, MIN_THREAD_SIZE, pool); });
+            mergeSort(arr, aux, mid + 1, right, MIN_THREAD_SIZE, pool);
+            group.wait(); // Ensure left half is sorted before merging
+
+            // Large merges are split by co-ranking so the top levels use every core
+            parallelMerge(arr, aux, left, mid, right, pool);
         } else {
-            mergeSort(arr, aux, left, mid, MIN_THREAD_SIZE);
-            mergeSort(arr, aux, mid + 1, right, MIN_THREAD_SIZE);
+            mergeSort(arr, aux, left, mid, MIN_THREAD_SIZE, pool);
+            mergeSort(arr, aux, mid + 1, right, MIN_THREAD_SIZE, pool);
+            merge(arr, aux, left, mid, right);
         }
-
-        merge(arr, aux, left, mid, right);
     }
 }
 
@@ -90,88 +76,19 @@ void mergeSort(vector<double>& arr, vector<double>& aux, int left, int right, in
 //     return 0;
 // }
 
-int main() {
-    // Use high-quality random number generator
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<double> dist(0.0, 1.0);
-
-    vector<int> sizes = {1000, 10000, 100000, 1000000, 10000000, 100000000}; // Large array sizes for testing
-    vector<int> thread_sizes = {10000, 50000, 100000, 250000, 500000, 1000000}; // Different MIN_THREAD_SIZE values
-    int num_runs = 10; // Number of times to run each test
-
-    for (int n : sizes) {
-        vector<double> arr(n);
-        for (int i = 0; i < n; i++) {
-            arr[i] = dist(gen);
-        }
-
-        cout << "Finding best MIN_THREAD_SIZE for n = " << n << " elements...\n";
-
-        double best_time = 1e9;
-        int best_thread_size = thread_sizes[0];
-
-        for (int MIN_THREAD_SIZE : thread_sizes) {
-            vector<double> runtimes;
-            vector<double> aux(n); // Preallocate auxiliary array
-
-            for (int run = 0; run < num_runs; run++) {
-                vector<double> temp(n);
-                memcpy(temp.data(), arr.data(), n * sizeof(double)); // Faster copying
-
-                auto start = high_resolution_clock::now();
-                mergeSort(temp, aux, 0, n - 1, MIN_THREAD_SIZE);
-                auto stop = high_resolution_clock::now();
+int main(int argc, char* argv[]) {
+    vector<ptrdiff_t> thread_sizes = {10000, 50000, 100000, 250000, 500000, 1000000}; // Different MIN_THREAD_SIZE values
 
-                double duration = duration_cast<milliseconds>(stop - start).count();
-                runtimes.push_back(duration);
-            }
-
-            // Compute average runtime
-            double sum = 0;
-            for (double time : runtimes) {
-                sum += time;
-            }
-            double avg_time = sum / num_runs;
-
-            cout << "MIN_THREAD_SIZE = " << MIN_THREAD_SIZE << ", Avg runtime: " << avg_time << " ms\n";
-
-            if (avg_time < best_time) {
-                best_time = avg_time;
-                best_thread_size = MIN_THREAD_SIZE;
-            }
-        }
-        vector<double> runtimes;
-        vector<double> aux(n); // Preallocate auxiliary array
-
-        for (int run = 0; run < num_runs; run++) {
-            vector<double> temp(n);
-            memcpy(temp.data(), arr.data(), n * sizeof(double)); // Faster copying
-
-            auto start = high_resolution_clock::now();
-            mergeSort(temp, aux, 0, n - 1, n/(4*MAX_THREADS));
-            auto stop = high_resolution_clock::now();
-
-            double duration = duration_cast<milliseconds>(stop - start).count();
-            runtimes.push_back(duration);
-        }
-
-        // Compute average runtime
-        double sum = 0;
-        for (double time : runtimes) {
-            sum += time;
-        }
-        double avg_time = sum / num_runs;
-
-        cout << "MIN_THREAD_SIZE = " << n/(4*MAX_THREADS) << ", Avg runtime: " << avg_time << " ms\n";
-
-        if (avg_time < best_time) {
-            best_time = avg_time;
-            best_thread_size = n/(4*MAX_THREADS);
-        }
-
-        cout << "Best MIN_THREAD_SIZE for n = " << n << " is " << best_thread_size << " with avg time: " << best_time << " ms\n\n";
+    // One engine per MIN_THREAD_SIZE plus n/(4*threads); the harness reports the fastest for every size
+    vector<BenchEngine> engines;
+    for (ptrdiff_t MIN_THREAD_SIZE : thread_sizes) {
+        engines.push_back({"MIN_THREAD_SIZE=" + to_string(MIN_THREAD_SIZE), [MIN_THREAD_SIZE](vector<double>& arr, vector<double>& aux, const BenchContext& ctx) {
+                               mergeSort(arr, aux, 0, (ptrdiff_t)arr.size() - 1, MIN_THREAD_SIZE, ctx.pool);
+                           }});
     }
-
-    return 0;
-}
\ No newline at end of file
+    engines.push_back({"MIN_THREAD_SIZE=n/(4*threads)", [](vector<double>& arr, vector<double>& aux, const BenchContext& ctx) {
+                           ptrdiff_t n = arr.size();
+                           mergeSort(arr, aux, 0, n - 1, n / (4 * ctx.threads), ctx.pool);
+                       }});
+    return benchMain(argc, argv, engines);
+}
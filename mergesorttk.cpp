@@ -106,116 +106,71 @@
 
 //     return 0;
 // }
-#include <iostream>
 #include <vector>
-#include <random>
-#include <ctime>
-#include <chrono>
-#include <cstring>  // For std::memcpy
+#include <string>
 #include <thread>
+#include "mergesorttk.h"
+#include "bench.h"
+#include "tuning.h"
 
 using namespace std;
-using namespace std::chrono;
 
-const int MAX_THREADS = thread::hardware_concurrency(); // Get number of CPU cores
-
-void insertionSort(vector<double>& arr, int left, int right) {
-    for (int i = left + 1; i <= right; i++) {
-        double key = arr[i];
-        int j = i - 1;
-        while (j >= left && arr[j] > key) {
-            arr[j + 1] = arr[j];
-            j--;
-        }
-        arr[j + 1] = key;
-    }
-}
-// Optimized Merge function using a preallocated auxiliary array
-void merge(vector<double>& arr, vector<double>& aux, int left, int mid, int right) {
-    memcpy(aux.data() + left, arr.data() + left, (right - left + 1) * sizeof(double));
-
-    int i = left, j = mid + 1, k = left;
-    
-    while (i <= mid && j <= right) {
-        arr[k++] = (aux[i] <= aux[j]) ? aux[i++] : aux[j++];
-    }
-
-    while (i <= mid) arr[k++] = aux[i++];
-    while (j <= right) arr[k++] = aux[j++];
-}
-
-// Optimized Merge Sort with preallocated auxiliary array
-void mergeSort(vector<double>& arr, vector<double>& aux, int left, int right, int k, int MIN_THREAD_SIZE) {
+// Previous version: spawns a fresh std::thread for every split above MIN_THREAD_SIZE (the spawn-per-split engines)
+void mergeSortSpawn(vector<double>& arr, vector<double>& aux, ptrdiff_t left, ptrdiff_t right, int k, ptrdiff_t MIN_THREAD_SIZE) {
     if (right - left + 1 <= k) {
-        // sort(arr.begin() + left, arr.begin() + right + 1);
-        //insertionSort is faster than built-in sort
         insertionSort(arr, left, right);
         return;
     }
     if (left < right) {
-        int mid = left + (right - left) / 2;
+        ptrdiff_t mid = left + (right - left) / 2;
 
-        // Use threads if the subarray is large enough
         if ((right - left) > MIN_THREAD_SIZE) {
-            thread leftThread(mergeSort, ref(arr), ref(aux), left, mid, k, MIN_THREAD_SIZE);
-            mergeSort(arr, aux, mid + 1, right, k, MIN_THREAD_SIZE);
-            leftThread.join(); // Ensure left half is sorted before merging
+            thread leftThread(mergeSortSpawn, ref(arr), ref(aux), left, mid, k, MIN_THREAD_SIZE);
+            mergeSortSpawn(arr, aux, mid + 1, right, k, MIN_THREAD_SIZE);
+            leftThread.join();
         } else {
-            mergeSort(arr, aux, left, mid, k, MIN_THREAD_SIZE);
-            mergeSort(arr, aux, mid + 1, right, k, MIN_THREAD_SIZE);
+            mergeSortSpawn(arr, aux, left, mid, k, MIN_THREAD_SIZE);
+            mergeSortSpawn(arr, aux, mid + 1, right, k, MIN_THREAD_SIZE);
         }
 
         merge(arr, aux, left, mid, right);
     }
 }
 
-int main() {
-    // Use high-quality random number generator
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<double> dist(0.0, 1.0);
-
-    vector<int> sizes = {1000, 10000, 100000, 1000000, 10000000, 100000000}; // Array sizes
-    int num_runs = 10; // Number of times to run each test
+int main(int argc, char* argv[]) {
+    // The old --scaling curve is --threads 1,2,4,...; --large is --sizes large
     vector<int> k_values = {5, 10, 20, 30, 50}; // Different values of k to test
 
-    for (int n : sizes) {
-        vector<double> arr(n);
-        arr.reserve(n);  // Preallocate memory
-
-        for (int i = 0; i < n; i++) {
-            arr[i] = dist(gen);  // Faster random number generation
-        }
-
-        cout << "Sorting " << n << " elements..." << endl;
-
-        // Loop through different values of k
-        for (int k : k_values) {
-            vector<double> runtimes;
-            vector<double> aux(n); // Preallocate auxiliary array
-            int min_thread_size = max(10000,n/(4*MAX_THREADS));
-            for (int run = 0; run < num_runs; run++) {
-                vector<double> temp(n);
-                memcpy(temp.data(), arr.data(), n * sizeof(double)); // Faster copying
-
-                auto start = high_resolution_clock::now();
-                mergeSort(temp, aux, 0, n - 1, k, min_thread_size);
-                auto stop = high_resolution_clock::now();
-
-                double duration = duration_cast<nanoseconds>(stop - start).count() / 1e6; // Convert to ms
-                runtimes.push_back(duration);
-            }
-
-            // Compute average runtime (excluding the first run)
-            double sum = 0;
-            for (size_t i = 1; i < runtimes.size(); i++) {
-                sum += runtimes[i];
-            }
-            double avg_time = sum / (num_runs - 1);
-            cout << "k = " << k << ", MIN_THREAD_SIZE = " << min_thread_size << ", Avg runtime: " << avg_time << " ms\n";
-        }
+    auto minThreadSize = [](ptrdiff_t n, const BenchContext& ctx) { return max<ptrdiff_t>(10000, n / (4 * ctx.threads)); };
+    vector<BenchEngine> engines;
+    for (int k : k_values) {
+        string name = "k=" + to_string(k);
+        engines.push_back({name, [=](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+                               ptrdiff_t n = a.size();
+                               mergeSort(a, b, 0, n - 1, k, minThreadSize(n, ctx), ctx.pool);
+                           }});
+        engines.push_back({name + "/network", [=](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+                               ptrdiff_t n = a.size();
+                               mergeSort(a, b, 0, n - 1, k, minThreadSize(n, ctx), ctx.pool, networkSort);
+                           }});
+        engines.push_back({name + "/ping-pong", [=](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+                               ptrdiff_t n = a.size();
+                               pingPongMergeSort(a, b, 0, n - 1, k, minThreadSize(n, ctx), ctx.pool);
+                           }});
+        engines.push_back({name + "/k-way final merge", [=](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+                               multiwayMergeSort(a, b, 0, (ptrdiff_t)a.size() - 1, k, ctx.pool);
+                           }});
+        // One std::thread per split instead of the pool (formerly --compare-spawn)
+        engines.push_back({name + "/spawn-per-split", [=](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+                               ptrdiff_t n = a.size();
+                               mergeSortSpawn(a, b, 0, n - 1, k, minThreadSize(n, ctx));
+                           }, 3 * sizeof(double), false});
     }
-
-    return 0;
+    // k, grain and merge kernel from this host's profile (tune); the defaults above if it was never calibrated
+    engines.push_back({"tuned", [](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+                           const TuningProfile& p = tunedProfile();
+                           ptrdiff_t n = a.size();
+                           mergeSort(a, b, 0, n - 1, p.k, p.minThreadSize(n, ctx.threads), ctx.pool, networkSort);
+                       }});
+    return benchMain(argc, argv, engines);
 }
-
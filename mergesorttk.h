@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "threadpool.h"
+#include "merge.h"
+#include "parallel_merge.h"
+#include "kwaymerge.h"
+#include "sortnet.h"
+#include "instrument.h"
+
+inline void insertionSort(std::vector<double>& arr, ptrdiff_t left, ptrdiff_t right) {
+    for (ptrdiff_t i = left + 1; i <= right; i++) {
+        double key = arr[i];
+        ptrdiff_t j = i - 1;
+        while (j >= left && arr[j] > key) {
+            arr[j + 1] = arr[j];
+            j--;
+        }
+        arr[j + 1] = key;
+    }
+}
+
+// Hybrid Merge Sort: leaf sorter (insertion sort by default) below k, left halves above MIN_THREAD_SIZE go to the work-stealing pool
+inline void mergeSort(std::vector<double>& arr, std::vector<double>& aux, ptrdiff_t left, ptrdiff_t right, int k, ptrdiff_t MIN_THREAD_SIZE,
+                      WorkStealingPool& pool = WorkStealingPool::instance(), LeafSortFn leaf = insertionSort) {
+    const ptrdiff_t n = right - left + 1;
+    if (n <= k) {
+        // sort(arr.begin() + left, arr.begin() + right + 1);
+        //insertionSort is faster than built-in sort
+        PSORT_PHASE(Leaf, n);
+        leaf(arr, left, right);
+        return;
+    }
+    if (left < right) {
+        ptrdiff_t mid = left + (right - left) / 2;
+
+        // Use the pool if the subarray is large enough
+        if ((right - left) > MIN_THREAD_SIZE) {
+            TaskGroup group(pool);
+            {
+                PSORT_PHASE(Spawn, n);
+                PSORT_COUNT(Tasks, 1);
+                group.run([&] { mergeSort(arr, aux, left, mid, k, MIN_THREAD_SIZE, pool, leaf); });
+            }
+            mergeSort(arr, aux, mid + 1, right, k, MIN_THREAD_SIZE, pool, leaf);
+            {
+                PSORT_PHASE(Join, n);
+                group.wait(); // Ensure left half is sorted before merging
+            }
+
+            // Large merges are split by co-ranking so the top levels use every core
+            PSORT_PHASE(ParallelMerge, n);
+            PSORT_COUNT_MERGE(n, 4 * n * sizeof(double));   // Copy into aux, then merge back
+            parallelMerge(arr, aux, left, mid, right, pool);
+        } else {
+            mergeSort(arr, aux, left, mid, k, MIN_THREAD_SIZE, pool, leaf);
+            mergeSort(arr, aux, mid + 1, right, k, MIN_THREAD_SIZE, pool, leaf);
+            PSORT_PHASE(Merge, n);
+            PSORT_COUNT_MERGE(n, 4 * n * sizeof(double));
+            merge(arr, aux, left, mid, right);
+        }
+    }
+}
+
+// Ping-pong variant of the hybrid sort: src and dst hold the same data on entry and the
+// sorted range ends up in dst. Halves are sorted into src (roles swap every level) and
+// merged straight into dst, so no level copies into aux before merging.
+inline void mergeSortInto(std::vector<double>& src, std::vector<double>& dst, ptrdiff_t left, ptrdiff_t right, int k, ptrdiff_t MIN_THREAD_SIZE,
+                          WorkStealingPool& pool = WorkStealingPool::instance(), LeafSortFn leaf = insertionSort) {
+    const ptrdiff_t n = right - left + 1;
+    if (n <= k) {
+        PSORT_PHASE(Leaf, n);
+        leaf(dst, left, right);
+        return;
+    }
+    if (left < right) {
+        ptrdiff_t mid = left + (right - left) / 2;
+        const double* a = src.data() + left;
+        const double* b = src.data() + mid + 1;
+
+        if ((right - left) > MIN_THREAD_SIZE) {
+            TaskGroup group(pool);
+            {
+                PSORT_PHASE(Spawn, n);
+                PSORT_COUNT(Tasks, 1);
+                group.run([&] { mergeSortInto(dst, src, left, mid, k, MIN_THREAD_SIZE, pool, leaf); });
+            }
+            mergeSortInto(dst, src, mid + 1, right, k, MIN_THREAD_SIZE, pool, leaf);
+            {
+                PSORT_PHASE(Join, n);
+                group.wait();
+            }
+            PSORT_PHASE(ParallelMerge, n);
+            PSORT_COUNT_MERGE(n, 2 * n * sizeof(double));
+            parallelMergeRuns(a, mid - left + 1, b, right - mid, dst.data() + left, pool);
+        } else {
+            mergeSortInto(dst, src, left, mid, k, MIN_THREAD_SIZE, pool, leaf);
+            mergeSortInto(dst, src, mid + 1, right, k, MIN_THREAD_SIZE, pool, leaf);
+            PSORT_PHASE(Merge, n);
+            PSORT_COUNT_MERGE(n, 2 * n * sizeof(double));
+            mergeRuns(a, mid - left + 1, b, right - mid, dst.data() + left);
+        }
+    }
+}
+
+// One up-front parallel copy into aux replaces the memcpy of every merge
+inline void pingPongMergeSort(std::vector<double>& arr, std::vector<double>& aux, ptrdiff_t left, ptrdiff_t right, int k, ptrdiff_t MIN_THREAD_SIZE,
+                              WorkStealingPool& pool = WorkStealingPool::instance(), LeafSortFn leaf = insertionSort) {
+    {
+        PSORT_PHASE(Copy, right - left + 1);
+        PSORT_COUNT(BytesMoved, 2 * (right - left + 1) * sizeof(double));
+        parallelCopy(arr.data() + left, aux.data() + left, right - left + 1, pool);
+    }
+    mergeSortInto(aux, arr, left, right, k, MIN_THREAD_SIZE, pool, leaf);
+}
+
+// Alternative final stage: instead of log2(threads) levels of parallel two-way merges,
+// every thread sorts one contiguous chunk sequentially and a single parallel k-way merge
+// combines the chunks
+inline void multiwayMergeSort(std::vector<double>& arr, std::vector<double>& aux, ptrdiff_t left, ptrdiff_t right, int k,
+                              WorkStealingPool& pool = WorkStealingPool::instance(), LeafSortFn leaf = insertionSort) {
+    const ptrdiff_t n = right - left + 1;
+    const int chunks = static_cast<int>(std::min<ptrdiff_t>(pool.size() + 1, std::max<ptrdiff_t>(1, n / PARALLEL_MERGE_GRAIN)));
+    if (chunks == 1) {
+        mergeSort(arr, aux, left, right, k, n, pool, leaf);
+        return;
+    }
+
+    // Chunks are sorted into aux (ping-pong), so the k-way merge writes straight into arr
+    parallelCopy(arr.data() + left, aux.data() + left, n, pool);
+    std::vector<SortedRun> runs(chunks);
+    {
+        TaskGroup group(pool);
+        for (int c = 0; c < chunks; c++) {
+            ptrdiff_t lo = left + n * c / chunks, hi = left + n * (c + 1) / chunks;
+            runs[c] = {aux.data() + lo, aux.data() + hi};
+            group.run([&, lo, hi] { mergeSortInto(arr, aux, lo, hi - 1, k, n, pool, leaf); });
+        }
+        group.wait();
+    }
+    parallelKWayMerge(runs.data(), chunks, arr.data() + left, pool);
+}
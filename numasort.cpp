@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "numasort.h"
+#include "mergesorttk.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    // numasort [--sizes N,N,...] [--threads T,T,...] [--pinning none|node|core] [--reps R]
+    // For every thread count, the same NUMA sort runs on node-local buffers (each partition
+    // first touched by its node) and on remote buffers (every page first touched by the main
+    // thread, as in the other drivers), next to mergesorttk on the shared pool.
+    vector<ptrdiff_t> sizes = {10000000, 100000000};
+    vector<NumaNode> topology = numaNodes();
+    int all = 0;
+    for (const NumaNode& node : topology) all += (int)node.cpus.size();
+    vector<int> thread_counts;
+    for (int t = 1; t < all; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(all);
+    NumaPinning pinning = NumaPinning::Node;
+    int reps = 5;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool ok = i + 1 < argc;
+        if (ok && arg == "--sizes") ok = parseList(argv[++i], sizes, parseCount);
+        else if (ok && arg == "--threads") ok = parseList(argv[++i], thread_counts, [](const string& s, int& t) { return (t = stoi(s)) > 0; });
+        else if (ok && arg == "--pinning") ok = parseNumaPinning(argv[++i], pinning);
+        else if (ok && arg == "--reps") ok = (reps = stoi(argv[++i])) > 0;
+        else ok = false;
+        if (!ok) {
+            cerr << "Usage: " << argv[0] << " [--sizes N,N,...] [--threads T,T,...] [--pinning none|node|core] [--reps R]" << endl;
+            return 1;
+        }
+    }
+
+    cout << topology.size() << " NUMA node(s):";
+    for (const NumaNode& node : topology) cout << " node" << node.id << " (" << node.cpus.size() << " CPUs)";
+    cout << ", pinning " << numaPinningName(pinning) << endl;
+    if (topology.size() == 1) cout << "Single node: local and remote placement are the same memory" << endl;
+
+    mt19937_64 gen(random_device{}());
+    uniform_real_distribution<double> dist(0.0, 1.0);
+    for (ptrdiff_t n : sizes) {
+        vector<double> input(n);
+        for (double& x : input) x = dist(gen);
+        cout << "\nArray size: " << n << endl;
+
+        double local_base = 0, remote_base = 0;
+        for (int threads : thread_counts) {
+            NumaSortOptions opts;
+            opts.threads = threads;
+            opts.pinning = pinning;
+            NumaSorter sorter(opts);
+            const vector<ptrdiff_t> offsets = sorter.partition(n);
+
+            // Node-local: each node copies its partition of the input into pages it touched first
+            double local_ms;
+            {
+                NumaBuffer data = sorter.allocate(n), aux = sorter.allocate(n);
+                auto fill = [&] {
+                    sorter.onNodes([&](int p, WorkStealingPool& pool) {
+                        parallelCopy(input.data() + offsets[p], data.data() + offsets[p], offsets[p + 1] - offsets[p], pool);
+                    });
+                };
+                local_ms = measureRuns(reps, 0, fill, [&] { sorter.sort(data.data(), aux.data(), n); },
+                                       [&] { return is_sorted(data.data(), data.data() + n); }).median;
+            }
+
+            // Remote: the same sort on vectors filled by the main thread
+            double remote_ms;
+            {
+                vector<double> data(n), aux(n);
+                auto fill = [&] { memcpy(data.data(), input.data(), n * sizeof(double)); };
+                remote_ms = measureRuns(reps, 0, fill, [&] { sorter.sort(data.data(), aux.data(), n); },
+                                        [&] { return is_sorted(data.begin(), data.end()); }).median;
+            }
+
+            double baseline_ms;
+            {
+                WorkStealingPool pool(threads - 1);
+                vector<double> data(n), aux(n);
+                auto fill = [&] { memcpy(data.data(), input.data(), n * sizeof(double)); };
+                baseline_ms = measureRuns(reps, 0, fill, [&] {
+                    mergeSort(data, aux, 0, n - 1, tunedProfile().k, tunedProfile().minThreadSize(n, threads), pool, networkSort);
+                }, [&] { return is_sorted(data.begin(), data.end()); }).median;
+            }
+
+            if (local_base == 0) {
+                local_base = local_ms;
+                remote_base = remote_ms;
+            }
+            cout << "Threads: " << sorter.threads() << " on " << sorter.nodes() << " node(s), local: " << local_ms
+                 << " ms (" << local_base / local_ms << "x), remote: " << remote_ms << " ms (" << remote_base / remote_ms
+                 << "x), remote/local: " << remote_ms / local_ms << ", mergesorttk: " << baseline_ms << " ms" << endl;
+        }
+    }
+    return 0;
+}
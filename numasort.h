@@ -0,0 +1,341 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <sys/mman.h>
+#ifdef PARALLELSORT_LIBNUMA
+#include <numa.h>
+#endif
+#include "threadpool.h"
+#include "parallel_merge.h"
+#include "kwaymerge.h"
+#include "psort.h"
+
+// NUMA-aware parallel sort. The array is cut into one partition per node in proportion
+// to the node's threads; each partition and its aux buffer are first touched by threads
+// pinned to that node, so every page of the sort phase is local. Each node sorts its
+// partition with its own work-stealing pool, and a single cross-node k-way merge comes
+// last, in which each node writes its own slice of the output.
+//
+// Topology comes from /sys/devices/system/node with sched_setaffinity pinning. Built with
+// -DPARALLELSORT_LIBNUMA -lnuma it comes from libnuma instead, and partitions are also
+// bound to their node, so placement holds even without pinning. On a single-node machine
+// this is one pool sorting the whole array.
+
+enum class NumaPinning {
+    None,   // Threads float; placement relies on the scheduler (or libnuma binding)
+    Node,   // Every thread of a node may run on any CPU of that node
+    Core,   // Every thread gets its own CPU
+};
+
+inline const char* numaPinningName(NumaPinning p) {
+    switch (p) {
+        case NumaPinning::None: return "none";
+        case NumaPinning::Node: return "node";
+        case NumaPinning::Core: return "core";
+    }
+    return "?";
+}
+
+inline bool parseNumaPinning(const std::string& name, NumaPinning& p) {
+    for (NumaPinning candidate : {NumaPinning::None, NumaPinning::Node, NumaPinning::Core}) {
+        if (name == numaPinningName(candidate)) {
+            p = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct NumaNode {
+    int id;                  // Kernel node number
+    std::vector<int> cpus;   // CPUs of the node this process may run on
+};
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        int lo = std::atoi(range.c_str());
+        int hi = dash == std::string::npos ? lo : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = lo; cpu <= hi; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Nodes with at least one CPU in this process's affinity mask. A machine that reports no
+// topology is one node holding every allowed CPU.
+inline std::vector<NumaNode> numaNodes() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++) CPU_SET(cpu, &allowed);
+    }
+
+    std::vector<NumaNode> nodes;
+    auto add = [&](int id, const std::vector<int>& cpus) {
+        NumaNode node{id, {}};
+        for (int cpu : cpus) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) node.cpus.push_back(cpu);
+        }
+        if (!node.cpus.empty()) nodes.push_back(node);
+    };
+#ifdef PARALLELSORT_LIBNUMA
+    if (numa_available() >= 0) {
+        struct bitmask* mask = numa_allocate_cpumask();
+        for (int id = 0; id <= numa_max_node(); id++) {
+            if (numa_node_to_cpus(id, mask) != 0) continue;
+            std::vector<int> cpus;
+            for (unsigned cpu = 0; cpu < mask->size; cpu++) {
+                if (numa_bitmask_isbitset(mask, cpu)) cpus.push_back(cpu);
+            }
+            add(id, cpus);
+        }
+        numa_free_cpumask(mask);
+    }
+#else
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string ids;
+    if (std::getline(online, ids)) {
+        for (int id : parseCpuList(ids)) {
+            std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string list;
+            if (std::getline(cpulist, list)) add(id, parseCpuList(list));
+        }
+    }
+#endif
+    if (nodes.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+        }
+        nodes.push_back({0, cpus});
+    }
+    return nodes;
+}
+
+// Keeps `threads` CPUs, dealt round-robin over the nodes so the nodes in use get equal
+// shares; nodes left without a CPU are dropped. threads <= 0 keeps every CPU.
+inline std::vector<NumaNode> selectNumaCpus(const std::vector<NumaNode>& nodes, int threads) {
+    if (threads <= 0) return nodes;
+    std::vector<NumaNode> selected;
+    for (const NumaNode& node : nodes) selected.push_back({node.id, {}});
+    for (size_t round = 0; threads > 0; round++) {
+        bool any = false;
+        for (size_t p = 0; p < nodes.size() && threads > 0; p++) {
+            if (round < nodes[p].cpus.size()) {
+                selected[p].cpus.push_back(nodes[p].cpus[round]);
+                threads--;
+                any = true;
+            }
+        }
+        if (!any) break;
+    }
+    selected.erase(std::remove_if(selected.begin(), selected.end(), [](const NumaNode& n) { return n.cpus.empty(); }),
+                   selected.end());
+    return selected;
+}
+
+// Restricts the calling thread to cpus
+inline bool pinThread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Anonymous mapping of n doubles whose pages are not touched on allocation, unlike a
+// std::vector, so their placement is decided by whoever writes them first
+class NumaBuffer {
+public:
+    NumaBuffer() = default;
+    explicit NumaBuffer(ptrdiff_t n) : size_(n) {
+        if (n == 0) return;
+        void* p = mmap(nullptr, n * sizeof(double), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+        data_ = static_cast<double*>(p);
+    }
+    NumaBuffer(NumaBuffer&& other) noexcept : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    NumaBuffer& operator=(NumaBuffer&& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+    ~NumaBuffer() {
+        if (data_) munmap(data_, size_ * sizeof(double));
+    }
+
+    double* data() const { return data_; }
+    ptrdiff_t size() const { return size_; }
+
+private:
+    double* data_ = nullptr;
+    ptrdiff_t size_ = 0;
+};
+
+struct NumaSortOptions {
+    int threads = 0;                        // CPUs used, spread evenly over the nodes; 0 = every allowed CPU
+    NumaPinning pinning = NumaPinning::Node;
+    int k = 0;                              // Leaf size; 0 = tunedProfile().k
+    ptrdiff_t min_thread_size = 0;          // 0 = tunedProfile().minThreadSize(partition, node threads)
+};
+
+// Owns one pinned pool per node; reuse it across sorts, as creating it starts the threads
+class NumaSorter {
+public:
+    explicit NumaSorter(const NumaSortOptions& opts = {}) : NumaSorter(opts, numaNodes()) {}
+
+    // Explicit topology, e.g. one "node" per L3 domain of a single socket
+    NumaSorter(const NumaSortOptions& opts, const std::vector<NumaNode>& topology)
+        : opts_(opts), nodes_(selectNumaCpus(topology, opts.threads)) {
+        for (size_t p = 0; p < nodes_.size(); p++) {
+            pools_.push_back(std::make_unique<WorkStealingPool>(
+                (unsigned)nodes_[p].cpus.size() - 1, [this, p](unsigned worker) { pin(p, worker + 1); }));
+        }
+    }
+
+    NumaSorter(const NumaSorter&) = delete;
+    NumaSorter& operator=(const NumaSorter&) = delete;
+
+    int nodes() const { return (int)nodes_.size(); }
+
+    int threads() const {
+        int total = 0;
+        for (const NumaNode& node : nodes_) total += (int)node.cpus.size();
+        return total;
+    }
+
+    const std::vector<NumaNode>& topology() const { return nodes_; }
+
+    // Partition bounds: node p owns [offsets[p], offsets[p + 1]), a share of n in proportion
+    // to its threads, cut at page boundaries
+    std::vector<ptrdiff_t> partition(ptrdiff_t n) const {
+        constexpr ptrdiff_t PAGE = 4096 / sizeof(double);
+        std::vector<ptrdiff_t> offsets(nodes_.size() + 1, n);
+        offsets[0] = 0;
+        ptrdiff_t before = 0, total = threads();
+        for (size_t p = 1; p < nodes_.size(); p++) {
+            before += nodes_[p - 1].cpus.size();
+            offsets[p] = std::max(offsets[p - 1], std::min(n, (ptrdiff_t)((double)n * before / total) / PAGE * PAGE));
+        }
+        return offsets;
+    }
+
+    // Buffer of n doubles whose partitions are first touched (and with libnuma bound) on their nodes
+    NumaBuffer allocate(ptrdiff_t n) {
+        NumaBuffer buffer(n);
+        const std::vector<ptrdiff_t> offsets = partition(n);
+        onNodes([&](int p, WorkStealingPool& pool) {
+            ptrdiff_t lo = offsets[p], hi = offsets[p + 1];
+            if (hi == lo) return;
+#ifdef PARALLELSORT_LIBNUMA
+            if (numa_available() >= 0) numa_tonode_memory(buffer.data() + lo, (hi - lo) * sizeof(double), nodes_[p].id);
+#endif
+            parallelFill(buffer.data() + lo, hi - lo, 0.0, pool);
+        });
+        return buffer;
+    }
+
+    // Runs body(p, pool) for every node at once, each on a thread pinned to its node
+    void onNodes(const std::function<void(int, WorkStealingPool&)>& body) {
+        std::vector<std::thread> drivers;
+        for (size_t p = 0; p < nodes_.size(); p++) {
+            drivers.emplace_back([this, p, &body] {
+                pin(p, 0);
+                body((int)p, *pools_[p]);
+            });
+        }
+        for (std::thread& t : drivers) t.join();
+    }
+
+    // Sorts data[0..n) in place; data and aux should come from allocate(n) so each node works
+    // on its own pages (any memory works, only slower)
+    void sort(double* data, double* aux, ptrdiff_t n) { sortImpl(data, data, aux, data, n); }
+
+    // Sorts arr through node-local buffers kept between calls: one copy in, the sort, and the
+    // cross-node merge straight back into arr
+    void sort(std::vector<double>& arr) {
+        const ptrdiff_t n = arr.size();
+        if (aux_.size() != n) {
+            data_ = nodes_.size() > 1 ? allocate(n) : NumaBuffer();
+            aux_ = allocate(n);
+        }
+        sortImpl(arr.data(), nodes_.size() > 1 ? data_.data() : arr.data(), aux_.data(), arr.data(), n);
+    }
+
+private:
+    void pin(size_t p, unsigned slot) {
+        const std::vector<int>& cpus = nodes_[p].cpus;
+        if (opts_.pinning == NumaPinning::Node) pinThread(cpus);
+        if (opts_.pinning == NumaPinning::Core) pinThread({cpus[slot % cpus.size()]});
+    }
+
+    // Reads src, sorts node-locally with data and aux, and writes the result to out. src and
+    // out may be data.
+    void sortImpl(const double* src, double* data, double* aux, double* out, ptrdiff_t n) {
+        if (n < 2) return;
+        const std::vector<ptrdiff_t> offsets = partition(n);
+        const bool single = nodes_.size() == 1;
+
+        // Every node sorts its partition into aux (into data when there is nothing to merge)
+        onNodes([&](int p, WorkStealingPool& pool) {
+            ptrdiff_t lo = offsets[p], hi = offsets[p + 1];
+            if (hi == lo) return;
+            if (src != data) parallelCopy(src + lo, data + lo, hi - lo, pool);
+            parallelCopy(data + lo, aux + lo, hi - lo, pool);
+            const TuningProfile& profile = tunedProfile();
+            const ptrdiff_t k = opts_.k ? opts_.k : profile.k;
+            const ptrdiff_t grain = opts_.min_thread_size ? opts_.min_thread_size : profile.minThreadSize(hi - lo, pool.size() + 1);
+            std::ranges::less less;
+            std::identity id;
+            if (single) {
+                psort::detail::sortInto(aux, data, lo, hi, k, grain, &pool, less, id);
+            } else {
+                psort::detail::sortInto(data, aux, lo, hi, k, grain, &pool, less, id);
+            }
+        });
+        if (single) {
+            if (out != data) parallelCopy(data, out, n, *pools_[0]);
+            return;
+        }
+
+        // Cross-node merge: node p produces outputs [offsets[p], offsets[p + 1]) from every
+        // node's sorted partition, so its writes stay local when out is node-partitioned
+        std::vector<SortedRun> runs;
+        for (size_t p = 0; p < nodes_.size(); p++) {
+            if (offsets[p + 1] > offsets[p]) runs.push_back({aux + offsets[p], aux + offsets[p + 1]});
+        }
+        const int k = (int)runs.size();
+        onNodes([&](int p, WorkStealingPool& pool) {
+            ptrdiff_t lo = offsets[p], hi = offsets[p + 1];
+            if (hi == lo) return;
+            std::vector<ptrdiff_t> begin(k), end(k);
+            multiwaySplit(runs.data(), k, lo, begin.data());
+            multiwaySplit(runs.data(), k, hi, end.data());
+            std::vector<SortedRun> slices(k);
+            for (int i = 0; i < k; i++) slices[i] = {runs[i].begin + begin[i], runs[i].begin + end[i]};
+            parallelKWayMerge(slices.data(), k, out + lo, pool);
+        });
+    }
+
+    NumaSortOptions opts_;
+    std::vector<NumaNode> nodes_;
+    std::vector<std::unique_ptr<WorkStealingPool>> pools_;
+    NumaBuffer data_, aux_;   // Node-local buffers of sort(std::vector&)
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "threadpool.h"
+#include "merge.h"
+
+// Smallest output chunk worth handing to another thread
+constexpr ptrdiff_t PARALLEL_MERGE_GRAIN = 1 << 15;
+
+// Co-rank (merge path) search: how many of the first `rank` outputs of a stable merge
+// of a[0..m) and b[0..n) come from a. Ties are taken from a first, like merge().
+inline ptrdiff_t coRank(ptrdiff_t rank, const double* a, ptrdiff_t m, const double* b, ptrdiff_t n) {
+    ptrdiff_t lo = std::max<ptrdiff_t>(0, rank - n);
+    ptrdiff_t hi = std::min(rank, m);
+    while (true) {
+        ptrdiff_t i = lo + (hi - lo) / 2;
+        ptrdiff_t j = rank - i;
+        if (i > 0 && j < n && a[i - 1] > b[j]) {
+            hi = i - 1;     // a[i-1] belongs after b[j]: take fewer from a
+        } else if (j > 0 && i < m && b[j - 1] >= a[i]) {
+            lo = i + 1;     // a[i] belongs before b[j-1]: take more from a
+        } else {
+            return i;
+        }
+    }
+}
+
+// Number of chunks a parallel copy or merge of `total` elements is split into
+inline int parallelChunks(ptrdiff_t total, WorkStealingPool& pool, int max_chunks = 0) {
+    int chunks = max_chunks > 0 ? max_chunks : static_cast<int>(pool.size()) + 1;
+    return static_cast<int>(std::max<ptrdiff_t>(1, std::min<ptrdiff_t>(chunks, total / PARALLEL_MERGE_GRAIN)));
+}
+
+// memcpy of n doubles split into equal chunks on the pool
+inline void parallelCopy(const double* src, double* dst, ptrdiff_t n, WorkStealingPool& pool) {
+    int chunks = parallelChunks(n, pool);
+    TaskGroup group(pool);
+    for (int c = 0; c < chunks; c++) {
+        group.run([&, c] {
+            ptrdiff_t lo = n * c / chunks;
+            ptrdiff_t hi = n * (c + 1) / chunks;
+            std::memcpy(dst + lo, src + lo, (hi - lo) * sizeof(double));
+        });
+    }
+    group.wait();
+}
+
+// body(lo, hi) for equal chunks of [0, n) on the pool
+template <typename Body>
+void parallelFor(ptrdiff_t n, WorkStealingPool& pool, Body body) {
+    int chunks = parallelChunks(n, pool);
+    TaskGroup group(pool);
+    for (int c = 0; c < chunks; c++) {
+        group.run([&, c] { body(n * c / chunks, n * (c + 1) / chunks); });
+    }
+    group.wait();
+}
+
+// Fills n doubles with value in equal chunks on the pool; the first write of a page
+// places it on the NUMA node of the thread that makes it (numasort.h)
+inline void parallelFill(double* dst, ptrdiff_t n, double value, WorkStealingPool& pool) {
+    int chunks = parallelChunks(n, pool);
+    TaskGroup group(pool);
+    for (int c = 0; c < chunks; c++) {
+        group.run([&, c] { std::fill(dst + n * c / chunks, dst + n * (c + 1) / chunks, value); });
+    }
+    group.wait();
+}
+
+// Merges a[0..m) and b[0..n) into out: the output is split into equal chunks, each chunk
+// finds its starting point in both runs with coRank and merges independently on the pool
+inline void parallelMergeRuns(const double* a, ptrdiff_t m, const double* b, ptrdiff_t n, double* out,
+                              WorkStealingPool& pool, int max_chunks = 0) {
+    ptrdiff_t total = m + n;
+    int chunks = parallelChunks(total, pool, max_chunks);
+    if (chunks == 1) {
+        mergeRuns(a, m, b, n, out);
+        return;
+    }
+
+    TaskGroup group(pool);
+    for (int c = 0; c < chunks; c++) {
+        group.run([&, c] {
+            ptrdiff_t out_lo = total * c / chunks;
+            ptrdiff_t out_hi = total * (c + 1) / chunks;
+            ptrdiff_t i_lo = coRank(out_lo, a, m, b, n), j_lo = out_lo - i_lo;
+            ptrdiff_t i_hi = coRank(out_hi, a, m, b, n), j_hi = out_hi - i_hi;
+            mergeRuns(a + i_lo, i_hi - i_lo, b + j_lo, j_hi - j_lo, out + out_lo);
+        });
+    }
+    group.wait();
+}
+
+// Parallel version of merge(arr, aux, left, mid, right). max_chunks = 0 uses every pool
+// thread plus the caller.
+inline void parallelMerge(std::vector<double>& arr, std::vector<double>& aux, ptrdiff_t left, ptrdiff_t mid, ptrdiff_t right,
+                          WorkStealingPool& pool, int max_chunks = 0) {
+    // The copy into aux must finish before any chunk reads across the whole range
+    parallelCopy(arr.data() + left, aux.data() + left, right - left + 1, pool);
+    parallelMergeRuns(aux.data() + left, mid - left + 1, aux.data() + mid + 1, right - mid, arr.data() + left,
+                      pool, max_chunks);
+}
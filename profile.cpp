@@ -0,0 +1,115 @@
+// Per-phase breakdown of the sort engines: time by phase and recursion depth, merge and
+// traffic counters, and hardware counters where perf events are permitted, e.g.
+//   profile --sizes 1e7 --threads 1,16 --engines 'mergesorttk*'
+// This driver always builds the engines instrumented; the others stay uninstrumented
+// unless compiled with -DPARALLELSORT_INSTRUMENT.
+#define PARALLELSORT_INSTRUMENT
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "instrument.h"
+#include "mergesorttk.h"
+#include "psort.h"
+#include "ranksort.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    opts.sizes = {1000000, 10000000};
+    opts.reps = 3;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    auto minThreadSize = [](ptrdiff_t n, const BenchContext& ctx) { return max<ptrdiff_t>(10000, n / (4 * ctx.threads)); };
+    const vector<BenchEngine> engines = {
+        {"mergesorttk/network", [&](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             mergeSort(a, b, 0, n - 1, 50, minThreadSize(n, ctx), ctx.pool, networkSort);
+         }},
+        {"mergesorttk/ping-pong", [&](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+             ptrdiff_t n = a.size();
+             pingPongMergeSort(a, b, 0, n - 1, 50, minThreadSize(n, ctx), ctx.pool, networkSort);
+         }},
+        {"psort::parallel_sort", [](vector<double>& a, vector<double>&, const BenchContext& ctx) {
+             psort::SortOptions sort_opts;
+             sort_opts.pool = &ctx.pool;
+             psort::parallel_sort(a, {}, {}, sort_opts);
+         }},
+        {"ranksort", [](vector<double>& a, vector<double>&, const BenchContext& ctx) {
+#ifdef _OPENMP
+             omp_set_num_threads(ctx.threads);
+#endif
+             parallel_rank_sort(a);
+         }},
+    };
+    if (opts.list) {
+        for (const BenchEngine& e : engines) cout << e.name << endl;
+        return 0;
+    }
+
+    mt19937_64 gen(opts.seed);
+    for (InputPattern input : opts.inputs) {
+        for (ptrdiff_t n : opts.sizes) {
+            const vector<double> arr = generateInput(n, input, gen);
+            vector<double> work(n), aux(n);
+            for (int threads : opts.threads) {
+                WorkStealingPool pool(threads - 1);
+                BenchContext ctx{pool, threads};
+                for (const BenchEngine& engine : engines) {
+                    if (!engineSelected(engine, opts.engines)) continue;
+                    auto run = [&] {
+                        memcpy(work.data(), arr.data(), n * sizeof(double));
+                        engine.sort(work, aux, ctx);
+                    };
+                    // Warm-up runs also start the pool and OpenMP threads the hardware counters attach to
+                    for (int i = 0; i < max(1, opts.warmup); i++) run();
+
+                    instrument::HardwareCounters hw;
+                    double wall_ms = 0;
+                    array<uint64_t, instrument::HardwareCounters::EVENTS> events{};
+                    instrument::reset();
+                    for (int r = 0; r < opts.reps; r++) {
+                        memcpy(work.data(), arr.data(), n * sizeof(double));
+                        hw.start();
+                        auto start = chrono::steady_clock::now();
+                        engine.sort(work, aux, ctx);
+                        auto stop = chrono::steady_clock::now();
+                        array<uint64_t, instrument::HardwareCounters::EVENTS> e = hw.stop();
+                        for (int i = 0; i < instrument::HardwareCounters::EVENTS; i++) events[i] += e[i] / opts.reps;
+                        wall_ms += chrono::duration<double, milli>(stop - start).count() / opts.reps;
+                        if (!is_sorted(work.begin(), work.end())) {
+                            cerr << "Sorting failed!" << endl;
+                            return 1;
+                        }
+                    }
+                    instrument::Report report = instrument::report();
+                    report.divide(opts.reps);
+
+                    cout << engine.name << ", " << n << " " << inputPatternName(input) << " elements, " << threads
+                         << " threads (mean of " << opts.reps << " sorts):" << endl;
+                    instrument::printReport(cout, report, wall_ms);
+                    if (hw.available()) {
+                        cout << "  hardware:";
+                        for (int i = 0; i < instrument::HardwareCounters::EVENTS; i++) {
+                            cout << " " << instrument::HardwareCounters::eventName(i) << " " << events[i];
+                        }
+                        cout << endl;
+                    } else {
+                        cout << "  hardware: perf events unavailable" << endl;
+                    }
+                    cout << endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
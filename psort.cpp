@@ -0,0 +1,144 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>  // For std::memcpy
+#include <algorithm>
+#include <string>
+#include "psort.h"
+#include "mergesorttk.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Key + payload record, as in production data
+struct Record {
+    double key;
+    int64_t payload;
+};
+
+// Average runtime in ms of sort(temp) over num_runs copies of arr (excluding the first run)
+template <typename T, typename SortFn, typename Sorted>
+double timeSort(const vector<T>& arr, int num_runs, SortFn sort, Sorted sorted) {
+    vector<double> runtimes;
+    for (int run = 0; run < num_runs; run++) {
+        vector<T> temp = arr;
+
+        auto start = high_resolution_clock::now();
+        sort(temp);
+        auto stop = high_resolution_clock::now();
+
+        double duration = duration_cast<nanoseconds>(stop - start).count() / 1e6; // Convert to ms
+        if (!sorted(temp)) {
+            cerr << "Sorting failed!" << endl;
+            exit(1);
+        }
+        runtimes.push_back(duration);
+    }
+
+    double sum = 0;
+    for (size_t i = 1; i < runtimes.size(); i++) {
+        sum += runtimes[i];
+    }
+    return sum / (num_runs - 1);
+}
+
+// The generic merge and rank sorts against std::stable_sort on a pool with workers, so the
+// parallel merge runs even on a host whose default pool has none
+template <typename T, typename Comp, typename Proj>
+void checkStable(const vector<T>& arr, Comp comp, Proj proj, WorkStealingPool& pool, const char* what) {
+    vector<T> expected = arr;
+    stable_sort(expected.begin(), expected.end(), [&](const T& a, const T& b) { return comp(invoke(proj, a), invoke(proj, b)); });
+    psort::SortOptions opts;
+    opts.pool = &pool;
+    for (int engine = 0; engine < 2; engine++) {
+        vector<T> out = arr;
+        if (engine == 0) psort::parallel_sort(out, comp, proj, opts);
+        else psort::rank_sort(out, comp, proj, opts);
+        if (out != expected) {
+            cerr << "Sorting failed! " << (engine == 0 ? "parallel_sort" : "rank_sort") << " on " << what << endl;
+            exit(1);
+        }
+    }
+}
+
+struct Tagged {
+    double key;
+    int id;
+    bool operator==(const Tagged&) const = default;
+};
+
+void checkGenericSorts(mt19937_64& gen) {
+    WorkStealingPool pool(3);
+    const int n = 200000;
+    vector<Tagged> tagged(n), few(n);
+    vector<float> floats(n);
+    uniform_real_distribution<double> dist(0.0, 1.0);
+    for (int i = 0; i < n; i++) {
+        tagged[i] = {dist(gen), i};
+        few[i] = {(double)(gen() % 6), i};
+        floats[i] = (float)dist(gen);
+    }
+    checkStable(tagged, ranges::less{}, &Tagged::key, pool, "records by a projection");
+    checkStable(tagged, ranges::greater{}, &Tagged::key, pool, "records in descending order");
+    checkStable(few, ranges::less{}, &Tagged::key, pool, "6 distinct keys");
+    checkStable(floats, ranges::less{}, identity{}, pool, "floats");
+    checkStable(floats, ranges::greater{}, identity{}, pool, "floats in descending order");
+}
+
+int main() {
+    random_device rd;
+    mt19937_64 gen(rd());
+    uniform_real_distribution<double> dist(0.0, 1.0);
+    checkGenericSorts(gen);
+
+    vector<int> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    int num_runs = 10;
+    auto doubles_sorted = [](const vector<double>& a) { return is_sorted(a.begin(), a.end()); };
+
+    for (int n : sizes) {
+        vector<double> arr(n);
+        for (int i = 0; i < n; i++) arr[i] = dist(gen);
+        cout << "Sorting " << n << " elements..." << endl;
+
+        // Doubles: the generic API against the engines it dispatches to
+        const int k = 50, min_thread_size = max(10000, n / (4 * (int)thread::hardware_concurrency()));
+        // One aux for every run, as the generic API reuses its thread-local workspace
+        vector<double> aux(n);
+        double direct_merge = timeSort(arr, num_runs, [&](vector<double>& a) {
+            pingPongMergeSort(a, aux, 0, a.size() - 1, k, min_thread_size, WorkStealingPool::instance(), networkSort);
+        }, doubles_sorted);
+        double generic_merge = timeSort(arr, num_runs, [](vector<double>& a) { psort::parallel_sort(a); }, doubles_sorted);
+        double direct_radix = timeSort(arr, num_runs, [&](vector<double>& a) { parallelRadixSort(a, aux); }, doubles_sorted);
+        double generic_radix = timeSort(arr, num_runs, [](vector<double>& a) { psort::sort(a); }, doubles_sorted);
+        cout << "doubles, threaded merge: pingPongMergeSort " << direct_merge << " ms, psort::parallel_sort "
+             << generic_merge << " ms; radix: parallelRadixSort " << direct_radix << " ms, psort::sort "
+             << generic_radix << " ms\n";
+
+        // Records sorted by key through a projection
+        vector<Record> records(n);
+        for (int i = 0; i < n; i++) records[i] = {arr[i], (int64_t)i};
+        auto records_sorted = [](const vector<Record>& r) {
+            return is_sorted(r.begin(), r.end(), [](const Record& a, const Record& b) { return a.key < b.key; });
+        };
+        double rec_std = timeSort(records, num_runs, [](vector<Record>& r) { psort::std_sort(r, {}, &Record::key); }, records_sorted);
+        double rec_merge = timeSort(records, num_runs, [](vector<Record>& r) { psort::parallel_sort(r, {}, &Record::key); }, records_sorted);
+        double rec_rank = timeSort(records, num_runs, [](vector<Record>& r) { psort::rank_sort(r, {}, &Record::key); }, records_sorted);
+        double rec_radix = timeSort(records, num_runs, [](vector<Record>& r) { psort::sort(r, {}, &Record::key); }, records_sorted);
+        cout << "records by key, std::sort: " << rec_std << " ms, parallel_sort: " << rec_merge << " ms, rank_sort: "
+             << rec_rank << " ms, sort (radix): " << rec_radix << " ms\n";
+
+        // Strings take the comparison-based path
+        if (n <= 1000000) {
+            vector<string> strings(n);
+            for (int i = 0; i < n; i++) strings[i] = to_string(gen());
+            auto strings_sorted = [](const vector<string>& s) { return is_sorted(s.begin(), s.end()); };
+            double str_std = timeSort(strings, num_runs, [](vector<string>& s) { psort::std_sort(s); }, strings_sorted);
+            double str_sort = timeSort(strings, num_runs, [](vector<string>& s) { psort::sort(s); }, strings_sorted);
+            cout << "strings, std::sort: " << str_std << " ms, psort::sort: " << str_sort << " ms\n";
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
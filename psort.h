@@ -0,0 +1,383 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <ranges>
+#include <type_traits>
+#include <vector>
+#include "threadpool.h"
+#include "merge.h"
+#include "parallel_merge.h"
+#include "sortnet.h"
+#include "radixsort.h"
+#include "tuning.h"
+#include "instrument.h"
+#include "workspace.h"
+
+// Generic sort API: every strategy of the benchmark programs (serial merge, k-hybrid,
+// threaded, rank sort, std::sort, radix) over iterator ranges or ranges/std::span with
+// a comparator and a key projection, e.g.
+//
+//     psort::sort(records, std::ranges::less{}, &Record::key);
+//     psort::parallel_sort(v.begin(), v.end(), std::ranges::greater{});
+//
+// Strategy choices are made at compile time: plain doubles in ascending order use the
+// SIMD merge kernel and sorting-network leaves, arithmetic keys compared with < or >
+// can use the radix engine, anything else takes the comparison-based paths. Leaf size
+// and thread grain left at 0 come from this host's tuning profile (tuning.h).
+namespace psort {
+
+struct SortOptions {
+    int k = 0;                         // Leaf size of the hybrid and threaded sorts; 0 = tunedProfile().k
+    ptrdiff_t min_thread_size = 0;     // Splits above this go to the pool; 0 = tunedProfile().minThreadSize(n, threads)
+    int radix_digit_bits = 11;         // 8 or 11-bit digits for the radix path
+    WorkStealingPool* pool = nullptr;  // nullptr = WorkStealingPool::instance()
+    SortWorkspace* workspace = nullptr;  // Scratch for trivially copyable elements; nullptr = SortWorkspace::Lease's choice
+};
+
+namespace detail {
+
+template <typename Comp, typename Key>
+constexpr bool is_less = std::is_same_v<Comp, std::ranges::less> || std::is_same_v<Comp, std::less<>> ||
+                         std::is_same_v<Comp, std::less<Key>>;
+
+template <typename Comp, typename Key>
+constexpr bool is_greater = std::is_same_v<Comp, std::ranges::greater> || std::is_same_v<Comp, std::greater<>> ||
+                            std::is_same_v<Comp, std::greater<Key>>;
+
+// Plain doubles sorted ascending: the SIMD merge kernel and sorting networks apply
+template <typename T, typename Comp, typename Proj>
+constexpr bool simd_doubles = std::is_same_v<T, double> && std::is_same_v<Proj, std::identity> && is_less<Comp, double>;
+
+// Arithmetic keys of up to 64 bits ordered by < or > can be radix sorted
+template <typename Key, typename Comp>
+constexpr bool radix_key = std::is_arithmetic_v<Key> && !std::is_same_v<Key, bool> && !std::is_same_v<Key, long double> &&
+                           sizeof(Key) <= 8 && (is_less<Comp, Key> || is_greater<Comp, Key>);
+
+template <typename It, typename Proj>
+using key_t = std::remove_cvref_t<std::invoke_result_t<Proj&, std::iter_reference_t<It>>>;
+
+// Order-preserving unsigned image of an arithmetic key (see doubleToKey). Adding +0.0
+// turns -0.0 into +0.0: the two compare equal, so they must share a key to stay stable.
+template <typename Key>
+uint64_t radixKey(Key key) {
+    if constexpr (std::is_same_v<Key, double>) {
+        return doubleToKey(key + 0.0);
+    } else if constexpr (std::is_same_v<Key, float>) {
+        uint32_t bits = std::bit_cast<uint32_t>(key + 0.0f);
+        return bits ^ ((bits >> 31) ? ~uint32_t(0) : (uint32_t(1) << 31));
+    } else if constexpr (std::is_signed_v<Key>) {
+        using U = std::make_unsigned_t<Key>;
+        return static_cast<U>(static_cast<U>(key) ^ (U(1) << (sizeof(Key) * 8 - 1)));
+    } else {
+        return static_cast<uint64_t>(key);
+    }
+}
+
+// Stable two-run merge: ties are taken from a
+template <typename T, typename Comp, typename Proj>
+void mergeRunsBy(T* a, ptrdiff_t na, T* b, ptrdiff_t nb, T* out, Comp& comp, Proj& proj) {
+    if constexpr (simd_doubles<T, Comp, Proj>) {
+        ::mergeRuns(a, na, b, nb, out);
+    } else {
+        ptrdiff_t i = 0, j = 0, k = 0;
+        while (i < na && j < nb) {
+            if (std::invoke(comp, std::invoke(proj, b[j]), std::invoke(proj, a[i]))) {
+                out[k++] = std::move(b[j++]);
+            } else {
+                out[k++] = std::move(a[i++]);
+            }
+        }
+        std::move(a + i, a + na, out + k);
+        std::move(b + j, b + nb, out + k + (na - i));
+    }
+}
+
+// coRank from parallel_merge.h for any comparator
+template <typename T, typename Comp, typename Proj>
+ptrdiff_t coRankBy(ptrdiff_t rank, const T* a, ptrdiff_t m, const T* b, ptrdiff_t n, Comp& comp, Proj& proj) {
+    ptrdiff_t lo = std::max<ptrdiff_t>(0, rank - n);
+    ptrdiff_t hi = std::min(rank, m);
+    while (true) {
+        ptrdiff_t i = lo + (hi - lo) / 2;
+        ptrdiff_t j = rank - i;
+        if (i > 0 && j < n && std::invoke(comp, std::invoke(proj, b[j]), std::invoke(proj, a[i - 1]))) {
+            hi = i - 1;
+        } else if (j > 0 && i < m && !std::invoke(comp, std::invoke(proj, b[j - 1]), std::invoke(proj, a[i]))) {
+            lo = i + 1;
+        } else {
+            return i;
+        }
+    }
+}
+
+template <typename T, typename Comp, typename Proj>
+void parallelMergeRunsBy(T* a, ptrdiff_t m, T* b, ptrdiff_t n, T* out, WorkStealingPool& pool, Comp& comp, Proj& proj) {
+    if constexpr (simd_doubles<T, Comp, Proj>) {
+        ::parallelMergeRuns(a, m, b, n, out, pool);
+    } else {
+        ptrdiff_t total = m + n;
+        int chunks = parallelChunks(total, pool);
+        TaskGroup group(pool);
+        for (int c = 0; c < chunks; c++) {
+            group.run([&, c] {
+                ptrdiff_t out_lo = total * c / chunks;
+                ptrdiff_t out_hi = total * (c + 1) / chunks;
+                ptrdiff_t i_lo = coRankBy(out_lo, a, m, b, n, comp, proj), j_lo = out_lo - i_lo;
+                ptrdiff_t i_hi = coRankBy(out_hi, a, m, b, n, comp, proj), j_hi = out_hi - i_hi;
+                mergeRunsBy(a + i_lo, i_hi - i_lo, b + j_lo, j_hi - j_lo, out + out_lo, comp, proj);
+            });
+        }
+        group.wait();
+    }
+}
+
+// Leaf sorter: sorting network for doubles, stable insertion sort otherwise
+template <typename T, typename Comp, typename Proj>
+void leafSortBy(T* a, ptrdiff_t len, Comp& comp, Proj& proj) {
+    if constexpr (simd_doubles<T, Comp, Proj>) {
+        networkSort(a, len);
+    } else {
+        for (ptrdiff_t i = 1; i < len; i++) {
+            T key = std::move(a[i]);
+            ptrdiff_t j = i - 1;
+            while (j >= 0 && std::invoke(comp, std::invoke(proj, key), std::invoke(proj, a[j]))) {
+                a[j + 1] = std::move(a[j]);
+                j--;
+            }
+            a[j + 1] = std::move(key);
+        }
+    }
+}
+
+// Ping-pong hybrid merge sort of [lo, hi): src and dst hold the same data on entry and
+// the sorted range ends up in dst (see mergeSortInto in mergesorttk.h)
+template <typename T, typename Comp, typename Proj>
+void sortInto(T* src, T* dst, ptrdiff_t lo, ptrdiff_t hi, ptrdiff_t k, ptrdiff_t grain, WorkStealingPool* pool, Comp& comp, Proj& proj) {
+    const ptrdiff_t n = hi - lo;
+    if (n <= k || n < 2) {
+        PSORT_PHASE(Leaf, n);
+        leafSortBy(dst + lo, n, comp, proj);
+        return;
+    }
+    const ptrdiff_t mid = lo + n / 2;
+    if (pool && n > grain) {
+        TaskGroup group(*pool);
+        {
+            PSORT_PHASE(Spawn, n);
+            PSORT_COUNT(Tasks, 1);
+            group.run([&] { sortInto(dst, src, lo, mid, k, grain, pool, comp, proj); });
+        }
+        sortInto(dst, src, mid, hi, k, grain, pool, comp, proj);
+        {
+            PSORT_PHASE(Join, n);
+            group.wait();
+        }
+        PSORT_PHASE(ParallelMerge, n);
+        PSORT_COUNT_MERGE(n, 2 * n * sizeof(T));
+        parallelMergeRunsBy(src + lo, mid - lo, src + mid, hi - mid, dst + lo, *pool, comp, proj);
+    } else {
+        sortInto(dst, src, lo, mid, k, grain, pool, comp, proj);
+        sortInto(dst, src, mid, hi, k, grain, pool, comp, proj);
+        PSORT_PHASE(Merge, n);
+        PSORT_COUNT_MERGE(n, 2 * n * sizeof(T));
+        mergeRunsBy(src + lo, mid - lo, src + mid, hi - mid, dst + lo, comp, proj);
+    }
+}
+
+// Runs body(T* data, ptrdiff_t n) on contiguous storage: in place for contiguous iterators,
+// through a temporary vector otherwise
+template <typename It, typename Body>
+void withContiguous(It first, It last, Body body) {
+    using T = std::iter_value_t<It>;
+    const ptrdiff_t n = last - first;
+    if constexpr (std::contiguous_iterator<It>) {
+        body(std::to_address(first), n);
+    } else {
+        std::vector<T> data(std::make_move_iterator(first), std::make_move_iterator(last));
+        body(data.data(), n);
+        std::move(data.begin(), data.end(), first);
+    }
+}
+
+inline WorkStealingPool& poolOf(const SortOptions& opts) {
+    return opts.pool ? *opts.pool : WorkStealingPool::instance();
+}
+
+// Workspace slots: the merge and radix scratch, then rank_sort's (key, index) pairs and
+// its gathered elements, which are live while the pairs are merge sorted, then the radix
+// histograms and bucket offsets
+constexpr int SCRATCH_SLOT = 0, RANKED_SLOT = 1, GATHER_SLOT = 2, COUNTS_SLOT = 3;
+
+template <typename It, typename Comp, typename Proj>
+void mergeSortImpl(It first, It last, Comp& comp, Proj& proj, int k, WorkStealingPool* pool, ptrdiff_t min_thread_size,
+                   SortWorkspace* workspace) {
+    using T = std::iter_value_t<It>;
+    withContiguous(first, last, [&](T* data, ptrdiff_t n) {
+        if (n < 2) return;
+        if (k == 0) k = tunedProfile().k;
+        ptrdiff_t grain = min_thread_size;
+        if (pool && grain == 0) grain = tunedProfile().minThreadSize(n, (int)pool->size() + 1);
+        if constexpr (workspace_type<T>) {
+            SortWorkspace::Lease ws(workspace);
+            T* buffer = ws->buffer<T>(SCRATCH_SLOT, n);
+            {
+                PSORT_PHASE(Copy, n);
+                PSORT_COUNT(BytesMoved, 2 * n * sizeof(T));
+                std::copy(data, data + n, buffer);
+            }
+            sortInto(buffer, data, 0, n, k, grain, pool, comp, proj);
+        } else {
+            std::vector<T> buffer;
+            {
+                PSORT_PHASE(Copy, n);
+                PSORT_COUNT(BytesMoved, 2 * n * sizeof(T));
+                buffer.assign(data, data + n);
+            }
+            sortInto(buffer.data(), data, 0, n, k, grain, pool, comp, proj);
+        }
+    });
+}
+
+template <typename It, typename Comp, typename Proj>
+void radixSortImpl(It first, It last, Comp&, Proj& proj, const SortOptions& opts, bool parallel) {
+    using T = std::iter_value_t<It>;
+    using Key = key_t<It, Proj>;
+    auto key = [&proj](const T& x) {
+        uint64_t k = radixKey<Key>(std::invoke(proj, x));
+        if constexpr (is_greater<Comp, Key>) k = ~k;   // Only the low sizeof(Key) * 8 bits are read
+        return k;
+    };
+    withContiguous(first, last, [&](T* data, ptrdiff_t n) {
+        if (n < 2) return;
+        SortWorkspace::Lease ws(opts.workspace);
+        const int key_bits = sizeof(Key) * 8;
+        const int chunks = parallel ? radixChunks(n, poolOf(opts)) : 1;
+        ptrdiff_t* counts = ws->buffer<ptrdiff_t>(COUNTS_SLOT, radixCountsSize(chunks, key_bits, opts.radix_digit_bits));
+        auto sort = [&](T* aux) {
+            if (parallel) {
+                parallelRadixSortBy(data, aux, n, key, key_bits, opts.radix_digit_bits, poolOf(opts), counts);
+            } else {
+                radixSortBy(data, aux, n, key, key_bits, opts.radix_digit_bits, counts);
+            }
+        };
+        if constexpr (workspace_type<T>) {
+            sort(ws->buffer<T>(SCRATCH_SLOT, n));
+        } else {
+            std::vector<T> aux(n);
+            sort(aux.data());
+        }
+    });
+}
+
+}  // namespace detail
+
+// Serial top-down merge sort (mergesort.cpp), stable
+template <std::random_access_iterator It, typename Comp = std::ranges::less, typename Proj = std::identity>
+void merge_sort(It first, It last, Comp comp = {}, Proj proj = {}) {
+    detail::mergeSortImpl(first, last, comp, proj, 1, nullptr, 0, nullptr);
+}
+
+// Serial merge sort with leaves of up to opts.k elements (mergesortk.cpp), stable
+template <std::random_access_iterator It, typename Comp = std::ranges::less, typename Proj = std::identity>
+void hybrid_sort(It first, It last, Comp comp = {}, Proj proj = {}, SortOptions opts = {}) {
+    detail::mergeSortImpl(first, last, comp, proj, opts.k, nullptr, 0, opts.workspace);
+}
+
+// Threaded hybrid merge sort on the work-stealing pool (mergesorttk.h), stable
+template <std::random_access_iterator It, typename Comp = std::ranges::less, typename Proj = std::identity>
+void parallel_sort(It first, It last, Comp comp = {}, Proj proj = {}, SortOptions opts = {}) {
+    detail::mergeSortImpl(first, last, comp, proj, opts.k, &detail::poolOf(opts), opts.min_thread_size, opts.workspace);
+}
+
+// Rank sort (ranksort.cpp): keys are paired with their original index, the pairs are
+// sorted by (key, index) and the elements are gathered in rank order
+template <std::random_access_iterator It, typename Comp = std::ranges::less, typename Proj = std::identity>
+void rank_sort(It first, It last, Comp comp = {}, Proj proj = {}, SortOptions opts = {}) {
+    using T = std::iter_value_t<It>;
+    using Key = detail::key_t<It, Proj>;
+    struct Ranked {
+        Key key;
+        ptrdiff_t index;
+    };
+    detail::withContiguous(first, last, [&](T* data, ptrdiff_t n) {
+        SortWorkspace::Lease lease(opts.workspace);
+        SortWorkspace& workspace = *lease;
+        std::vector<Ranked> ranked_vector;
+        Ranked* ranked;
+        if constexpr (workspace_type<Ranked>) {
+            ranked = workspace.buffer<Ranked>(detail::RANKED_SLOT, n);
+        } else {
+            ranked_vector.resize(n);
+            ranked = ranked_vector.data();
+        }
+        for (ptrdiff_t i = 0; i < n; i++) ranked[i] = {std::invoke(proj, data[i]), i};
+
+        auto by_rank = [&comp](const Ranked& x, const Ranked& y) {
+            if (std::invoke(comp, x.key, y.key)) return true;
+            if (std::invoke(comp, y.key, x.key)) return false;
+            return x.index < y.index;
+        };
+        std::identity id;
+        detail::mergeSortImpl(ranked, ranked + n, by_rank, id, opts.k, &detail::poolOf(opts), opts.min_thread_size, &workspace);
+
+        if constexpr (workspace_type<T>) {
+            T* gathered = workspace.buffer<T>(detail::GATHER_SLOT, n);
+            for (ptrdiff_t i = 0; i < n; i++) gathered[i] = data[ranked[i].index];
+            std::copy(gathered, gathered + n, data);
+        } else {
+            std::vector<T> gathered;
+            gathered.reserve(n);
+            for (ptrdiff_t i = 0; i < n; i++) gathered.push_back(std::move(data[ranked[i].index]));
+            std::move(gathered.begin(), gathered.end(), data);
+        }
+    });
+}
+
+// std::sort baseline (sort.cpp), not stable
+template <std::random_access_iterator It, typename Comp = std::ranges::less, typename Proj = std::identity>
+void std_sort(It first, It last, Comp comp = {}, Proj proj = {}) {
+    std::ranges::sort(first, last, comp, proj);
+}
+
+// LSD radix sort (radixsort.h) for arithmetic keys ordered by < or >, stable
+template <std::random_access_iterator It, typename Comp = std::ranges::less, typename Proj = std::identity>
+    requires detail::radix_key<detail::key_t<It, Proj>, Comp>
+void radix_sort(It first, It last, Comp comp = {}, Proj proj = {}, SortOptions opts = {}) {
+    detail::radixSortImpl(first, last, comp, proj, opts, true);
+}
+
+// Default entry point: radix for arithmetic keys, threaded hybrid merge sort otherwise. Stable.
+template <std::random_access_iterator It, typename Comp = std::ranges::less, typename Proj = std::identity>
+void sort(It first, It last, Comp comp = {}, Proj proj = {}, SortOptions opts = {}) {
+    if constexpr (detail::radix_key<detail::key_t<It, Proj>, Comp>) {
+        detail::radixSortImpl(first, last, comp, proj, opts, true);
+    } else {
+        parallel_sort(first, last, comp, proj, opts);
+    }
+}
+
+// Range overloads (vectors, arrays, std::span, ...)
+#define PSORT_RANGE_OVERLOAD(name)                                                                         \
+    template <std::ranges::random_access_range R, typename Comp = std::ranges::less,                      \
+              typename Proj = std::identity, typename... Opts>                                             \
+    void name(R&& range, Comp comp = {}, Proj proj = {}, Opts... opts) {                                   \
+        name(std::ranges::begin(range), std::ranges::end(range), comp, proj, opts...);                     \
+    }
+
+PSORT_RANGE_OVERLOAD(merge_sort)
+PSORT_RANGE_OVERLOAD(hybrid_sort)
+PSORT_RANGE_OVERLOAD(parallel_sort)
+PSORT_RANGE_OVERLOAD(rank_sort)
+PSORT_RANGE_OVERLOAD(std_sort)
+PSORT_RANGE_OVERLOAD(radix_sort)
+PSORT_RANGE_OVERLOAD(sort)
+#undef PSORT_RANGE_OVERLOAD
+
+}  // namespace psort
@@ -0,0 +1,21 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "radixsort.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    vector<BenchEngine> engines = {
+        {"std::sort", [](vector<double>& a, vector<double>&, const BenchContext&) { sort(a.begin(), a.end()); }},
+    };
+    for (int bits : {8, 11}) {
+        string name = to_string(bits) + "-bit digits";
+        engines.push_back({name, [bits](vector<double>& a, vector<double>& b, const BenchContext&) { radixSort(a, b, bits); }});
+        engines.push_back({name + "/parallel", [bits](vector<double>& a, vector<double>& b, const BenchContext& ctx) {
+                               parallelRadixSort(a, b, bits, ctx.pool);
+                           }});
+    }
+    return benchMain(argc, argv, engines);
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "threadpool.h"
+#include "workspace.h"
+
+constexpr int RADIX_PREFETCH_DISTANCE = 64;   // Elements ahead of the scatter cursor to prefetch
+constexpr int PARALLEL_RADIX_MIN_SIZE = 1 << 16; // Below this the threaded passes cost more than they save
+
+// Order-preserving map from IEEE doubles to unsigned keys: positives get the sign bit
+// flipped, negatives get every bit flipped, so unsigned key order == numeric order.
+inline uint64_t doubleToKey(double d) {
+    uint64_t bits = std::bit_cast<uint64_t>(d);
+    uint64_t mask = (bits >> 63) ? ~uint64_t(0) : (uint64_t(1) << 63);
+    return bits ^ mask;
+}
+
+inline double keyToDouble(uint64_t key) {
+    uint64_t mask = (key >> 63) ? (uint64_t(1) << 63) : ~uint64_t(0);
+    return std::bit_cast<double>(key ^ mask);
+}
+
+// Key function for sorting plain doubles
+struct DoubleKey {
+    uint64_t operator()(double d) const { return doubleToKey(d); }
+};
+
+// The engine below sorts any element type T by an unsigned key of key_bits bits
+// produced by key(x); the double entry points at the bottom use DoubleKey.
+
+inline int radixPasses(int key_bits, int digit_bits) { return (key_bits + digit_bits - 1) / digit_bits; }
+
+// Threads (chunks) the parallel sort splits n elements over
+inline int radixChunks(ptrdiff_t n, WorkStealingPool& pool) {
+    return static_cast<int>(std::min<ptrdiff_t>(pool.size() + 1, std::max<ptrdiff_t>(1, n / PARALLEL_RADIX_MIN_SIZE)));
+}
+
+// Counters (histograms and bucket offsets) a sort over num_chunks chunks uses. Callers
+// that sort repeatedly pass a buffer of this size as counts; without one the sort
+// allocates its own.
+inline size_t radixCountsSize(int num_chunks, int key_bits, int digit_bits) {
+    const size_t buckets = size_t(1) << digit_bits;
+    return (num_chunks + 1) * radixPasses(key_bits, digit_bits) * buckets + num_chunks * buckets;
+}
+
+// Digit histograms for every pass from one sweep over src[lo, hi): hist[pass * buckets + digit]
+template <typename T, typename KeyFn>
+void radixHistograms(const T* src, ptrdiff_t lo, ptrdiff_t hi, KeyFn key, int key_bits, int digit_bits, ptrdiff_t* hist) {
+    const int buckets = 1 << digit_bits;
+    const int passes = radixPasses(key_bits, digit_bits);
+    const uint64_t mask = buckets - 1;
+    std::fill(hist, hist + passes * buckets, 0);
+    for (ptrdiff_t i = lo; i < hi; i++) {
+        uint64_t k = key(src[i]);
+        for (int p = 0; p < passes; p++) {
+            hist[p * buckets + ((k >> (p * digit_bits)) & mask)]++;
+        }
+    }
+}
+
+// A pass is trivial when every key shares its digit: the scatter would be a plain copy
+inline bool radixPassTrivial(const ptrdiff_t* hist, int buckets, ptrdiff_t n) {
+    for (int b = 0; b < buckets; b++) {
+        if (hist[b] != 0) return hist[b] == n;
+    }
+    return true;
+}
+
+// Stable scatter of src[lo, hi) into dst using running bucket offsets
+template <typename T, typename KeyFn>
+void radixScatter(const T* src, T* dst, ptrdiff_t lo, ptrdiff_t hi, KeyFn key, int shift, uint64_t mask, ptrdiff_t* offsets) {
+    for (ptrdiff_t i = lo; i < hi; i++) {
+        __builtin_prefetch(src + i + RADIX_PREFETCH_DISTANCE);
+        dst[offsets[(key(src[i]) >> shift) & mask]++] = src[i];
+    }
+}
+
+// LSD radix sort of arr[0, n) by key(x); aux must hold n elements, counts (if given)
+// radixCountsSize(1, key_bits, digit_bits)
+template <typename T, typename KeyFn>
+void radixSortBy(T* arr, T* aux, ptrdiff_t n, KeyFn key, int key_bits, int digit_bits, ptrdiff_t* counts = nullptr) {
+    if (n < 2) return;
+    const int buckets = 1 << digit_bits;
+    const int passes = radixPasses(key_bits, digit_bits);
+    const uint64_t mask = buckets - 1;
+
+    std::vector<ptrdiff_t> own;
+    if (!counts) {
+        own.resize(radixCountsSize(1, key_bits, digit_bits));
+        counts = own.data();
+    }
+    ptrdiff_t* hist = counts;
+    ptrdiff_t* offsets = counts + passes * buckets;
+    radixHistograms(arr, 0, n, key, key_bits, digit_bits, hist);
+
+    T* src = arr;
+    T* dst = aux;
+    for (int p = 0; p < passes; p++) {
+        const ptrdiff_t* h = hist + p * buckets;
+        if (radixPassTrivial(h, buckets, n)) continue;
+
+        ptrdiff_t sum = 0;
+        for (int b = 0; b < buckets; b++) {
+            offsets[b] = sum;
+            sum += h[b];
+        }
+        radixScatter(src, dst, 0, n, key, p * digit_bits, mask, offsets);
+        std::swap(src, dst);
+    }
+
+    if (src != arr) std::copy(src, src + n, arr);
+}
+
+// Multi-threaded LSD radix sort: each thread histograms its own chunk, the per-thread
+// histograms are prefix-summed bucket-major so every thread gets a private, stable
+// output range per bucket, then all chunks scatter concurrently. counts (if given) holds
+// radixCountsSize(radixChunks(n, pool), key_bits, digit_bits).
+template <typename T, typename KeyFn>
+void parallelRadixSortBy(T* arr, T* aux, ptrdiff_t n, KeyFn key, int key_bits, int digit_bits, WorkStealingPool& pool,
+                         ptrdiff_t* counts = nullptr) {
+    const int num_chunks = radixChunks(n, pool);
+    if (num_chunks == 1) {
+        radixSortBy(arr, aux, n, key, key_bits, digit_bits, counts);
+        return;
+    }
+
+    const int buckets = 1 << digit_bits;
+    const int passes = radixPasses(key_bits, digit_bits);
+    const uint64_t mask = buckets - 1;
+    auto chunk_lo = [&](int c) { return n * c / num_chunks; };
+
+    std::vector<ptrdiff_t> own;
+    if (!counts) {
+        own.resize(radixCountsSize(num_chunks, key_bits, digit_bits));
+        counts = own.data();
+    }
+    // Chunk c's histograms, then their totals, then every chunk's bucket offsets
+    auto chunk_hist = [&](int c) { return counts + c * passes * buckets; };
+    ptrdiff_t* total = counts + num_chunks * passes * buckets;
+    ptrdiff_t* offsets = total + passes * buckets;
+
+    // Digit counts do not depend on element order, so one sweep finds every trivial pass
+    {
+        TaskGroup group(pool);
+        for (int c = 0; c < num_chunks; c++) {
+            group.run([&, c] { radixHistograms(arr, chunk_lo(c), chunk_lo(c + 1), key, key_bits, digit_bits, chunk_hist(c)); });
+        }
+        group.wait();
+    }
+    std::fill(total, total + passes * buckets, 0);
+    for (int c = 0; c < num_chunks; c++) {
+        for (int i = 0; i < passes * buckets; i++) total[i] += chunk_hist(c)[i];
+    }
+
+    T* src = arr;
+    T* dst = aux;
+    bool first_pass = true;
+    for (int p = 0; p < passes; p++) {
+        if (radixPassTrivial(total + p * buckets, buckets, n)) continue;
+        const int shift = p * digit_bits;
+
+        // After the first scatter the chunks hold different elements, so recount per chunk
+        if (!first_pass) {
+            TaskGroup group(pool);
+            for (int c = 0; c < num_chunks; c++) {
+                group.run([&, c] {
+                    ptrdiff_t* h = chunk_hist(c) + p * buckets;
+                    std::fill(h, h + buckets, 0);
+                    for (ptrdiff_t i = chunk_lo(c); i < chunk_lo(c + 1); i++) h[(key(src[i]) >> shift) & mask]++;
+                });
+            }
+            group.wait();
+        }
+        first_pass = false;
+
+        ptrdiff_t sum = 0;
+        for (int b = 0; b < buckets; b++) {
+            for (int c = 0; c < num_chunks; c++) {
+                offsets[c * buckets + b] = sum;
+                sum += chunk_hist(c)[p * buckets + b];
+            }
+        }
+
+        TaskGroup group(pool);
+        for (int c = 0; c < num_chunks; c++) {
+            group.run([&, c] { radixScatter(src, dst, chunk_lo(c), chunk_lo(c + 1), key, shift, mask, offsets + c * buckets); });
+        }
+        group.wait();
+        std::swap(src, dst);
+    }
+
+    if (src != arr) std::copy(src, src + n, arr);
+}
+
+constexpr int RADIX_COUNTS_SLOT = 0;   // Workspace slot of the double sorts' counters
+
+// LSD radix sort for doubles using 8 or 11-bit digits; aux must hold arr.size() elements.
+// The counters come from workspace (nullptr = SortWorkspace::Lease's choice).
+inline void radixSort(std::vector<double>& arr, std::vector<double>& aux, int digit_bits = 11, SortWorkspace* workspace = nullptr) {
+    SortWorkspace::Lease ws(workspace);
+    ptrdiff_t* counts = ws->buffer<ptrdiff_t>(RADIX_COUNTS_SLOT, radixCountsSize(1, 64, digit_bits));
+    radixSortBy(arr.data(), aux.data(), (ptrdiff_t)arr.size(), DoubleKey{}, 64, digit_bits, counts);
+}
+
+inline void parallelRadixSort(std::vector<double>& arr, std::vector<double>& aux, int digit_bits = 11,
+                              WorkStealingPool& pool = WorkStealingPool::instance(), SortWorkspace* workspace = nullptr) {
+    const ptrdiff_t n = arr.size();
+    SortWorkspace::Lease ws(workspace);
+    ptrdiff_t* counts = ws->buffer<ptrdiff_t>(RADIX_COUNTS_SLOT, radixCountsSize(radixChunks(n, pool), 64, digit_bits));
+    parallelRadixSortBy(arr.data(), aux.data(), n, DoubleKey{}, 64, digit_bits, pool, counts);
+}
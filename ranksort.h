@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "instrument.h"
+#include "workspace.h"
+
+// Parallel rank sort on OpenMP tasks: doubles are tagged with their index, sorted by
+// (value, index) with a recursive merge sort whose merges place every element by its
+// rank, and written back. Without -fopenmp the pragmas are ignored and it runs serially.
+
+// Structure to hold elements with their original indices. The 64-bit index takes the
+// slot that alignment padding filled when it was an int, so Element stays 16 bytes and
+// inputs past 2^31 elements cost no extra memory traffic.
+struct Element {
+    double value;
+    uint64_t index;
+
+    // Comparison operator for sorting
+    bool operator<(const Element& other) const {
+        return (value != other.value) ? (value < other.value) : (index < other.index);
+    }
+};
+
+static_assert(sizeof(Element) == 16, "Element must stay two words");
+
+using MergeFn = void (*)(Element* start, Element* mid, Element* end, Element* temp);
+
+// Pre-declare for tasking
+inline void parallel_rank_sort_impl(Element* start, Element* end, Element* elements_base, Element* temp_base, int depth, MergeFn merge_fn);
+
+constexpr int SEQUENTIAL_CUTOFF = 16384;  // Threshold for switching to sequential sort
+constexpr int PARALLEL_DEPTH = 5;        // Limit task creation depth
+
+// Previous merge (kept as the ranksort-legacy engine): copies the right half into a fresh vector on every
+// call and binary-searches every element, O(n log n) work per level
+inline void legacy_parallel_merge(Element* start, Element* mid, Element* end, Element* temp) {
+    const size_t n1 = mid - start;
+    const size_t n2 = end - mid;
+    
+    if (n1 == 0 || n2 == 0) return;
+    PSORT_COUNT_MERGE(n1 + n2, 4 * (n1 + n2) * sizeof(Element));   // Merge into temp, then copy back
+
+    // Pre-sort right half for better cache locality
+    std::vector<Element> right_sorted(mid, end);
+    #pragma omp parallel for simd
+    for (size_t j = 0; j < n2; ++j) {
+        right_sorted[j] = mid[j];
+    }
+
+    // Parallel rank calculations with SIMD
+    #pragma omp parallel 
+    {
+        // Calculate ranks for elements in the left half
+        #pragma omp for simd nowait
+        for (size_t i = 0; i < n1; ++i) {
+            const auto& elem = start[i];
+            auto pos = std::lower_bound(right_sorted.begin(), right_sorted.end(), elem) - right_sorted.begin();
+            temp[i + pos] = elem;
+        }
+        // Calculate ranks for elements in the right half
+        #pragma omp for simd nowait
+        for (size_t j = 0; j < n2; ++j) {
+            const auto& elem = right_sorted[j];
+            auto pos = std::upper_bound(start, mid, elem) - start;
+            temp[pos + j] = elem;
+        }
+    }
+
+    // Block-wise copy back using cache-friendly pattern
+    const size_t block_size = 4096 / sizeof(Element);
+    #pragma omp parallel for simd
+    for (size_t i = 0; i < n1 + n2; i += block_size) {
+        const size_t end_block = std::min(i + block_size, n1 + n2);
+        std::copy(temp + i, temp + end_block, start + i);
+    }
+}
+// Co-rank search: how many of the first `rank` elements of merge(a, b) come from a.
+// Element::operator< is a strict total order on (value, index), so no ties arise.
+inline size_t co_rank(size_t rank, const Element* a, size_t m, const Element* b, size_t n) {
+    size_t lo = rank > n ? rank - n : 0;
+    size_t hi = std::min(rank, m);
+    while (true) {
+        size_t i = lo + (hi - lo) / 2;
+        size_t j = rank - i;
+        if (i > 0 && j < n && b[j] < a[i - 1]) {
+            hi = i - 1;     // a[i-1] comes after b[j]: take fewer from a
+        } else if (j > 0 && i < m && a[i] < b[j - 1]) {
+            lo = i + 1;     // a[i] comes before b[j-1]: take more from a
+        } else {
+            return i;
+        }
+    }
+}
+
+constexpr size_t MERGE_BLOCK = 1 << 14;  // Output elements merged per task
+
+// Blocked rank merge: the output is cut into MERGE_BLOCK-sized blocks, each block
+// co-ranks its start and end against both halves and merges sequentially into temp.
+// temp is the preallocated slice of temp_base, so nothing is allocated per call.
+inline void optimized_parallel_merge(Element* start, Element* mid, Element* end, Element* temp) {
+    const size_t n1 = mid - start;
+    const size_t n2 = end - mid;
+    
+    if (n1 == 0 || n2 == 0) return;
+    if (!(*mid < *(mid - 1))) return;  // Halves already in order
+    PSORT_COUNT_MERGE(n1 + n2, 4 * (n1 + n2) * sizeof(Element));   // Merge into temp, then copy back
+
+    const size_t total = n1 + n2;
+    const size_t num_blocks = (total + MERGE_BLOCK - 1) / MERGE_BLOCK;
+
+    #pragma omp taskloop grainsize(1) default(none) firstprivate(start, mid, temp, n1, n2, total, num_blocks)
+    for (size_t b = 0; b < num_blocks; ++b) {
+        const size_t out_lo = b * MERGE_BLOCK;
+        const size_t out_hi = std::min(out_lo + MERGE_BLOCK, total);
+        size_t i = co_rank(out_lo, start, n1, mid, n2);
+        size_t j = out_lo - i;
+        const size_t i_end = co_rank(out_hi, start, n1, mid, n2);
+        const size_t j_end = out_hi - i_end;
+
+        Element* out = temp + out_lo;
+        while (i < i_end && j < j_end) {
+            *out++ = (mid[j] < start[i]) ? mid[j++] : start[i++];
+        }
+        while (i < i_end) *out++ = start[i++];
+        while (j < j_end) *out++ = mid[j++];
+    }
+
+    // Block-wise copy back using cache-friendly pattern
+    #pragma omp taskloop grainsize(1) default(none) firstprivate(start, temp, total, num_blocks)
+    for (size_t b = 0; b < num_blocks; ++b) {
+        const size_t lo = b * MERGE_BLOCK;
+        std::copy(temp + lo, temp + std::min(lo + MERGE_BLOCK, total), start + lo);
+    }
+}
+
+// Recursive function to perform parallel rank sort
+inline void parallel_rank_sort_impl(Element* start, Element* end, Element* elements_base, Element* temp_base, int depth, MergeFn merge_fn) {
+    const size_t n = end - start;
+    if (n <= SEQUENTIAL_CUTOFF) {
+        // Use sequential sort for small arrays
+        PSORT_PHASE(Leaf, n);
+        std::sort(start, end);
+        return;
+    }
+
+    Element* mid = start + n/2;
+    const size_t offset = start - elements_base;
+    Element* local_temp = temp_base + offset;
+
+    if (depth < PARALLEL_DEPTH) {
+        // Create parallel tasks for sorting subarrays
+        {
+            PSORT_PHASE(Spawn, n);
+            PSORT_COUNT(Tasks, 2);
+            #pragma omp task default(none) firstprivate(start, mid, elements_base, temp_base, depth, merge_fn)
+            parallel_rank_sort_impl(start, mid, elements_base, temp_base, depth + 1, merge_fn);
+
+            #pragma omp task default(none) firstprivate(mid, end, elements_base, temp_base, depth, merge_fn)
+            parallel_rank_sort_impl(mid, end, elements_base, temp_base, depth + 1, merge_fn);
+        }
+        {
+            PSORT_PHASE(Join, n);
+            #pragma omp taskwait
+        }
+    } else {
+        // Sort subarrays sequentially if depth limit is reached
+        parallel_rank_sort_impl(start, mid, elements_base, temp_base, depth, merge_fn);
+        parallel_rank_sort_impl(mid, end, elements_base, temp_base, depth, merge_fn);
+    }
+        // Merge the sorted subarrays
+    PSORT_PHASE(Merge, n);   // The merge functions count the merges they do
+    merge_fn(start, mid, end, local_temp);
+}
+// Sorts elements[0..n) by (value, index) on OpenMP tasks, with temp[0..n) as scratch
+inline void parallel_rank_sort_elements(Element* elements, Element* temp, size_t n, MergeFn merge_fn = optimized_parallel_merge) {
+    #pragma omp parallel
+    #pragma omp single
+    parallel_rank_sort_impl(elements, elements + n, elements, temp, 0, merge_fn);
+}
+
+// Workspace slots of the elements and their merge scratch
+constexpr int RANK_ELEMENTS_SLOT = 0, RANK_TEMP_SLOT = 1;
+
+// Main function to perform parallel rank sort on a vector of doubles. elements and temp
+// live in the workspace (the calling thread's by default), so repeated sorts allocate
+// nothing once it has grown. Fresh pages are first written by the static parallel loop,
+// so they are spread over the NUMA nodes of the OpenMP threads instead of all landing on
+// the main thread's node (bind the threads with OMP_PROC_BIND / OMP_PLACES).
+inline void parallel_rank_sort(std::vector<double>& arr, MergeFn merge_fn = optimized_parallel_merge, SortWorkspace* workspace = nullptr) {
+    const size_t n = arr.size();
+    SortWorkspace::Lease ws(workspace);
+    Element* elements = ws->buffer<Element>(RANK_ELEMENTS_SLOT, n);
+    Element* temp = ws->buffer<Element>(RANK_TEMP_SLOT, n);
+    {
+        PSORT_PHASE(Pack, n);
+        PSORT_COUNT(BytesMoved, n * (sizeof(double) + 2 * sizeof(Element)));
+        #pragma omp parallel for simd schedule(static)
+        for (size_t i = 0; i < n; ++i) {
+            elements[i] = {arr[i], i};
+            temp[i] = elements[i];
+        }
+    }
+
+    parallel_rank_sort_elements(elements, temp, n, merge_fn);
+
+    PSORT_PHASE(Unpack, n);
+    PSORT_COUNT(BytesMoved, n * (sizeof(Element) + sizeof(double)));
+    #pragma omp parallel for simd
+    for (size_t i = 0; i < n; ++i) {
+        arr[i] = elements[i].value;
+    }
+}
+
+// Argsort: order[i] is the original index of the i-th smallest key, equal keys in index
+// order. The indices the rank sort carries for tie-breaking are returned instead of
+// discarded, so payload columns can be reordered later (see argsort.h).
+template <typename Index>
+void parallel_rank_argsort(const std::vector<double>& keys, std::vector<Index>& order, MergeFn merge_fn = optimized_parallel_merge,
+                           SortWorkspace* workspace = nullptr) {
+    const size_t n = keys.size();
+    SortWorkspace::Lease ws(workspace);
+    Element* elements = ws->buffer<Element>(RANK_ELEMENTS_SLOT, n);
+    Element* temp = ws->buffer<Element>(RANK_TEMP_SLOT, n);
+    #pragma omp parallel for simd schedule(static)
+    for (size_t i = 0; i < n; ++i) {
+        elements[i] = {keys[i], i};
+        temp[i] = elements[i];
+    }
+
+    parallel_rank_sort_elements(elements, temp, n, merge_fn);
+
+    order.resize(n);
+    #pragma omp parallel for simd
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = static_cast<Index>(elements[i].index);
+    }
+}
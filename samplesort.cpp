@@ -0,0 +1,68 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <functional>
+#include <string>
+#include <utility>
+#include "samplesort.h"
+#include "bench.h"
+
+using namespace std;
+
+// Largest regular bucket relative to a perfect split, and the share of elements in equality buckets
+void printSkew(const SampleSortStats& stats, ptrdiff_t n) {
+    ptrdiff_t largest = 0;
+    int nonempty = 0;
+    long long equal = 0;
+    for (size_t b = 0; b < stats.bucket_sizes.size(); b++) {
+        if (b % 2 == 1) {
+            equal += stats.bucket_sizes[b];
+        } else {
+            largest = max(largest, stats.bucket_sizes[b]);
+        }
+        if (stats.bucket_sizes[b] > 0) nonempty++;
+    }
+    int regular = stats.num_splitters + 1;
+    cout << "  splitters = " << stats.num_splitters << ", non-empty buckets = " << nonempty
+         << ", largest bucket = " << largest << " (" << (double)largest * regular / n << "x ideal)"
+         << ", in equality buckets = " << 100.0 * equal / n << "%\n";
+}
+
+int main() {
+    // Use high-quality random number generator
+    random_device rd;
+    mt19937 gen(rd());
+    uniform_real_distribution<double> dist(0.0, 1.0);
+
+    vector<ptrdiff_t> sizes = standardSizes();
+    int num_runs = 10; // Number of times to run each test
+
+    // Uniform input plus the duplicate-heavy cases that unbalance naive splitters
+    vector<pair<string, function<double()>>> inputs = {
+        {"uniform", [&] { return dist(gen); }},
+        {"16 distinct values", [&] { return (double)(int)(dist(gen) * 16); }},
+        {"all equal", [] { return 1.0; }},
+    };
+
+    for (ptrdiff_t n : sizes) {
+        for (auto& [name, next] : inputs) {
+            vector<double> arr(n);
+            for (ptrdiff_t i = 0; i < n; i++) {
+                arr[i] = next();
+            }
+
+            cout << "Sorting " << n << " elements (" << name << ")..." << endl;
+
+            SampleSortStats stats;
+            BenchStats t = measureSort(arr, num_runs - 1, 1, [&](vector<double>& a, vector<double>& b) {
+                sampleSort(a, b, 0, WorkStealingPool::instance(), &stats);
+            });
+            double avg_time = t.mean;
+            cout << "Average runtime for n = " << n << ": " << avg_time << " ms (median " << t.median << ", p95 " << t.p95 << ")\n";
+            printSkew(stats, n);
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
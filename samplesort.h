@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "threadpool.h"
+#include "mergesorttk.h"
+#include "tuning.h"
+#include "workspace.h"
+
+constexpr int SAMPLE_SORT_MIN_SIZE = 1 << 15;  // Smaller inputs go straight to mergeSort
+constexpr int MAX_SPLITTERS = 255;             // Up to 256 regular + 256 equality buckets
+constexpr int OVERSAMPLING = 16;               // Samples drawn per regular bucket
+constexpr int SCATTER_BLOCK = 16;              // Doubles buffered per bucket before a flush (two cache lines)
+constexpr int CLASSIFY_BLOCK = 16;             // Elements classified together to overlap tree descents
+
+// Workspace slots of scatterToBuckets: bucket of every element, per-chunk counts and
+// offsets, per-chunk write-combining buffers and their fill levels
+constexpr int BUCKET_OF_SLOT = 0, BUCKET_COUNTS_SLOT = 1, SCATTER_BUFFER_SLOT = 2, SCATTER_FILL_SLOT = 3;
+
+// Per-bucket sizes of the last sampleSort call, used to report skew
+struct SampleSortStats {
+    std::vector<ptrdiff_t> bucket_sizes;   // Regular and equality buckets interleaved
+    int num_splitters = 0;
+};
+
+// Branchless splitter tree: the sorted, de-duplicated splitters are stored in Eytzinger
+// (BFS) order so classification is `levels` compare-and-shift steps with no branches.
+// Element x goes to bucket 2*j when it falls strictly between splitter j-1 and j,
+// and to the equality bucket 2*j+1 when it equals splitter j. Equality buckets need no
+// sorting, which keeps heavy-duplicate and all-equal inputs balanced.
+class SplitterTree {
+public:
+    explicit SplitterTree(std::vector<double> splitters) : sorted_(std::move(splitters)) {
+        levels_ = 0;
+        while ((1 << levels_) - 1 < (int)sorted_.size()) levels_++;
+        const int padded = (1 << levels_) - 1;
+        sorted_.resize(padded + 1, sorted_.back());   // Pad with the largest splitter; last slot is a sentinel
+        tree_.resize(padded + 1);
+        int pos = 0;
+        build(1, pos);
+    }
+
+    int numBuckets() const { return 2 << levels_; }
+
+    int classify(double x) const {
+        int j = 1;
+        for (int l = 0; l < levels_; l++) {
+            j = 2 * j + (tree_[j] < x);
+        }
+        j -= 1 << levels_;   // Number of splitters < x
+        return 2 * j + (sorted_[j] == x);
+    }
+
+    // classify on CLASSIFY_BLOCK elements at once, level by level: the independent descents
+    // overlap instead of each waiting out the latency of the previous compare
+    void classifyBlock(const double* x, uint16_t* out) const {
+        int j[CLASSIFY_BLOCK];
+        for (int u = 0; u < CLASSIFY_BLOCK; u++) j[u] = 1;
+        for (int l = 0; l < levels_; l++) {
+            for (int u = 0; u < CLASSIFY_BLOCK; u++) j[u] = 2 * j[u] + (tree_[j[u]] < x[u]);
+        }
+        for (int u = 0; u < CLASSIFY_BLOCK; u++) {
+            int k = j[u] - (1 << levels_);
+            out[u] = 2 * k + (sorted_[k] == x[u]);
+        }
+    }
+
+private:
+    void build(int node, int& pos) {
+        if (node >= (int)tree_.size()) return;
+        build(2 * node, pos);
+        tree_[node] = sorted_[pos++];
+        build(2 * node + 1, pos);
+    }
+
+    std::vector<double> sorted_;
+    std::vector<double> tree_;   // tree_[0] unused
+    int levels_;
+};
+
+// Moves src[0..n) into dst grouped by bucket, every bucket keeping input order; returns the
+// bucket bounds (numBuckets() + 1 offsets). Pass 1 classifies each chunk and counts its
+// bucket sizes, pass 2 scatters through small per-bucket write-combining buffers so each
+// write to dst is a full block. The scratch comes from workspace (nullptr = SortWorkspace::Lease's
+// choice), so repeated calls allocate only the returned bounds.
+inline std::vector<ptrdiff_t> scatterToBuckets(const double* src, double* dst, ptrdiff_t n, const SplitterTree& tree,
+                                               WorkStealingPool& pool, SortWorkspace* workspace = nullptr) {
+    const int buckets = tree.numBuckets();
+    const int num_chunks = pool.size() + 1;
+    auto chunk_lo = [&](int c) { return n * c / num_chunks; };
+    SortWorkspace::Lease ws(workspace);
+    uint16_t* bucket_of = ws->buffer<uint16_t>(BUCKET_OF_SLOT, n);
+    ptrdiff_t* counts = ws->buffer<ptrdiff_t>(BUCKET_COUNTS_SLOT, 2 * num_chunks * buckets);
+    ptrdiff_t* offsets = counts + num_chunks * buckets;
+    double* buffers = ws->buffer<double>(SCATTER_BUFFER_SLOT, num_chunks * buckets * SCATTER_BLOCK);
+    int* fills = ws->buffer<int>(SCATTER_FILL_SLOT, num_chunks * buckets);
+    std::fill(counts, counts + num_chunks * buckets, 0);
+    {
+        TaskGroup group(pool);
+        for (int c = 0; c < num_chunks; c++) {
+            group.run([&, c] {
+                ptrdiff_t* count = counts + c * buckets;
+                const ptrdiff_t end = chunk_lo(c + 1);
+                ptrdiff_t i = chunk_lo(c);
+                for (; i + CLASSIFY_BLOCK <= end; i += CLASSIFY_BLOCK) {
+                    tree.classifyBlock(src + i, bucket_of + i);
+                    for (int u = 0; u < CLASSIFY_BLOCK; u++) count[bucket_of[i + u]]++;
+                }
+                for (; i < end; i++) {
+                    int b = tree.classify(src[i]);
+                    bucket_of[i] = b;
+                    count[b]++;
+                }
+            });
+        }
+        group.wait();
+    }
+
+    // Bucket-major prefix sums: chunk c owns a contiguous slice of every bucket
+    std::vector<ptrdiff_t> bucket_start(buckets + 1);
+    ptrdiff_t sum = 0;
+    for (int b = 0; b < buckets; b++) {
+        bucket_start[b] = sum;
+        for (int c = 0; c < num_chunks; c++) {
+            offsets[c * buckets + b] = sum;
+            sum += counts[c * buckets + b];
+        }
+    }
+    bucket_start[buckets] = n;
+
+    TaskGroup group(pool);
+    for (int c = 0; c < num_chunks; c++) {
+        group.run([&, c] {
+            ptrdiff_t* out = offsets + c * buckets;
+            double* buffer = buffers + (ptrdiff_t)c * buckets * SCATTER_BLOCK;
+            int* fill = fills + c * buckets;
+            std::fill(fill, fill + buckets, 0);
+            const ptrdiff_t begin = chunk_lo(c), end = chunk_lo(c + 1);
+            for (ptrdiff_t i = begin; i < end; i++) {
+                int b = bucket_of[i];
+                buffer[b * SCATTER_BLOCK + fill[b]++] = src[i];
+                if (fill[b] == SCATTER_BLOCK) {
+                    std::memcpy(dst + out[b], buffer + b * SCATTER_BLOCK, SCATTER_BLOCK * sizeof(double));
+                    out[b] += SCATTER_BLOCK;
+                    fill[b] = 0;
+                }
+            }
+            for (int b = 0; b < buckets; b++) {
+                std::memcpy(dst + out[b], buffer + b * SCATTER_BLOCK, fill[b] * sizeof(double));
+            }
+        });
+    }
+    group.wait();
+    return bucket_start;
+}
+
+// Parallel sample sort: oversample splitters, classify every element with the splitter
+// tree, scatter each chunk through per-bucket write-combining buffers into aux, then
+// sort the regular buckets concurrently with the hybrid mergeSort and copy back.
+// k = 0 takes the leaf size from tunedProfile(), which also sets the bucket sorts' grain.
+// The scatter's scratch comes from workspace (nullptr = SortWorkspace::Lease's choice).
+inline void sampleSort(std::vector<double>& arr, std::vector<double>& aux, int k = 0,
+                       WorkStealingPool& pool = WorkStealingPool::instance(), SampleSortStats* stats = nullptr,
+                       SortWorkspace* workspace = nullptr) {
+    const ptrdiff_t n = arr.size();
+    const int threads = pool.size() + 1;
+    const TuningProfile& profile = tunedProfile();
+    if (k == 0) k = profile.k;
+    if (n < SAMPLE_SORT_MIN_SIZE) {
+        mergeSort(arr, aux, 0, n - 1, k, n, pool);
+        if (stats) *stats = {{n}, 0};
+        return;
+    }
+
+    // Draw and sort the sample, then take evenly spaced, de-duplicated splitters
+    const int num_splitters = std::min(MAX_SPLITTERS, std::max(15, 4 * threads - 1));
+    std::vector<double> sample((num_splitters + 1) * OVERSAMPLING);
+    std::mt19937 gen(n);
+    std::uniform_int_distribution<ptrdiff_t> pick(0, n - 1);
+    for (double& s : sample) s = arr[pick(gen)];
+    std::sort(sample.begin(), sample.end());
+
+    std::vector<double> splitters;
+    for (int i = 1; i <= num_splitters; i++) {
+        double s = sample[i * OVERSAMPLING - 1];
+        if (splitters.empty() || splitters.back() < s) splitters.push_back(s);
+    }
+    SplitterTree tree(splitters);
+
+    const std::vector<ptrdiff_t> bucket_start = scatterToBuckets(arr.data(), aux.data(), n, tree, pool, workspace);
+    const int buckets = tree.numBuckets();
+
+    // Sort regular buckets in aux (arr is the scratch space) and copy every bucket back
+    const ptrdiff_t min_thread_size = profile.minThreadSize(n, threads);
+    {
+        TaskGroup group(pool);
+        for (int b = 0; b < buckets; b++) {
+            ptrdiff_t lo = bucket_start[b], hi = bucket_start[b + 1];
+            if (lo == hi) continue;
+            group.run([&, b, lo, hi] {
+                if (b % 2 == 0) mergeSort(aux, arr, lo, hi - 1, k, min_thread_size, pool);
+                std::memcpy(arr.data() + lo, aux.data() + lo, (hi - lo) * sizeof(double));
+            });
+        }
+        group.wait();
+    }
+
+    if (stats) {
+        stats->num_splitters = splitters.size();
+        stats->bucket_sizes.resize(buckets);
+        for (int b = 0; b < buckets; b++) stats->bucket_sizes[b] = bucket_start[b + 1] - bucket_start[b];
+    }
+}
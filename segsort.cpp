@@ -0,0 +1,112 @@
+// Throughput of the batched segment sort against sorting every segment with its own call,
+// for several segment-length distributions, e.g.
+//   segsort --sizes 1e7 --threads 1,16 --engines 'segmentedSort*,std::sort*'
+// The sizes are total elements; each distribution cuts them into segments and the report
+// adds segments/s to the usual timings.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "segsort.h"
+#include "mergesorttk.h"
+#include "bench.h"
+
+using namespace std;
+
+// Segment lengths drawn until they cover n elements (the last one is cut to fit)
+struct LengthDistribution {
+    string name;
+    ptrdiff_t lo, hi;
+    bool log_uniform;   // Many short segments and a tail of long ones
+};
+
+inline vector<ptrdiff_t> segmentOffsets(ptrdiff_t n, const LengthDistribution& dist, mt19937_64& gen) {
+    uniform_int_distribution<ptrdiff_t> uniform(dist.lo, dist.hi);
+    uniform_real_distribution<double> exponent(log((double)dist.lo), log((double)dist.hi + 1));
+    vector<ptrdiff_t> offsets = {0};
+    while (offsets.back() < n) {
+        ptrdiff_t len = dist.log_uniform ? (ptrdiff_t)exp(exponent(gen)) : uniform(gen);
+        offsets.push_back(min(n, offsets.back() + len));
+    }
+    return offsets;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    opts.sizes = {1000000, 10000000};
+    opts.reps = 5;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    const vector<LengthDistribution> distributions = {
+        {"fixed 8", 8, 8, false},
+        {"fixed 16", 16, 16, false},
+        {"fixed 64", 64, 64, false},
+        {"uniform 8-64", 8, 64, false},
+        {"uniform 8-500", 8, 500, false},
+        {"log-uniform 8-500", 8, 500, true},
+    };
+
+    BenchReport report(opts, {{"segments_per_s", nullptr}});
+    report.run([&](const BenchConfig& cfg) {
+        const ptrdiff_t n = cfg.n;
+        WorkStealingPool& pool = cfg.pool;
+        vector<double> work(n), aux(n);
+        auto prepare = [&] { memcpy(work.data(), cfg.arr.data(), n * sizeof(double)); };
+
+        for (size_t d = 0; d < distributions.size(); d++) {
+            const LengthDistribution& dist = distributions[d];
+            // The same segments for every thread count and input of this size
+            mt19937_64 gen(opts.seed + d);
+            const vector<ptrdiff_t> offsets = segmentOffsets(n, dist, gen);
+            const ptrdiff_t segments = offsets.size() - 1;
+            auto sorted = [&] {
+                for (ptrdiff_t s = 0; s < segments; s++) {
+                    if (!is_sorted(work.begin() + offsets[s], work.begin() + offsets[s + 1])) return false;
+                }
+                return true;
+            };
+
+            if (report.text()) {
+                if (d > 0) cout << endl;
+                cout << "Sorting " << segments << " segments (" << dist.name << ") of " << n << " " << inputPatternName(cfg.input)
+                     << " elements with " << cfg.threads << " threads..." << endl;
+            }
+            auto record = [&](const string& engine, const BenchStats& stats) {
+                const double per_second = stats.median > 0 ? segments / (stats.median / 1e3) : 0;
+                report.record({engine + " [" + dist.name + "]", cfg.input, n, cfg.threads, stats, {per_second}});
+            };
+
+            if (report.selected("segmentedSort")) {
+                record("segmentedSort", measureRuns(opts.reps, opts.warmup, prepare, [&] { segmentedSort(work, offsets, pool); }, sorted));
+            }
+            // One call per segment, spread over the pool by segment count
+            if (report.selected("std::sort per segment")) {
+                record("std::sort per segment", measureRuns(opts.reps, opts.warmup, prepare, [&] {
+                    parallelFor(segments, pool, [&](ptrdiff_t lo, ptrdiff_t hi) {
+                        for (ptrdiff_t s = lo; s < hi; s++) sort(work.begin() + offsets[s], work.begin() + offsets[s + 1]);
+                    });
+                }, sorted));
+            }
+            if (report.selected("networkSort per segment")) {
+                record("networkSort per segment", measureRuns(opts.reps, opts.warmup, prepare, [&] {
+                    parallelFor(segments, pool, [&](ptrdiff_t lo, ptrdiff_t hi) {
+                        for (ptrdiff_t s = lo; s < hi; s++) networkSort(work.data() + offsets[s], offsets[s + 1] - offsets[s]);
+                    });
+                }, sorted));
+            }
+            if (report.selected("mergeSort per segment")) {
+                record("mergeSort per segment", measureRuns(opts.reps, opts.warmup, prepare, [&] {
+                    parallelFor(segments, pool, [&](ptrdiff_t lo, ptrdiff_t hi) {
+                        for (ptrdiff_t s = lo; s < hi; s++) {
+                            if (offsets[s + 1] - offsets[s] > 1) mergeSort(work, aux, offsets[s], offsets[s + 1] - 1, 50, n, pool, networkSort);
+                        }
+                    });
+                }, sorted));
+            }
+        }
+    });
+    return report.finish();
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "threadpool.h"
+#include "merge.h"
+#include "sortnet.h"
+
+// Batched sort of many small independent segments of one flat buffer: segment s is
+// data[offsets[s]..offsets[s + 1]). Sorting each with its own call pays the call and the
+// padding of a whole network per segment and uses one SIMD lane of every compare; here
+// segments of up to LANE_NETWORK_MAX elements are transposed into columns, one segment
+// per vector lane, and a batch of 4 (AVX2) or 8 (AVX-512) of them is sorted by one
+// bitonic network of vertical min/max with no shuffles. Longer segments take the
+// single-segment network of sortnet.h up to 64 elements, and beyond that a bottom-up
+// merge sort of network-sorted blocks through a per-thread scratch buffer (insertion sort
+// and std::sort both lose to it from about 100 elements). Threads take contiguous runs of
+// segments of about equal element counts, so a skewed length mix still balances.
+
+constexpr int LANE_NETWORK_MAX = 16;                // Longest segment sorted in a vector lane
+constexpr int MAX_LANES = 8;                        // Segments per batch with AVX-512
+constexpr ptrdiff_t SEGMENT_LEAF = 32;              // Block sorted by a network before merging longer segments
+constexpr ptrdiff_t SEGMENT_GRAIN = 1 << 14;        // Fewest elements worth a task
+
+// Column layout of a batch: element i of the segment in lane s is cols[i * lanes + s].
+// Each kernel sorts every lane of an N-row block with the bitonic schedule of
+// bitonicSortScalar, comparing whole rows.
+template <int N>
+void laneSortScalar(double* cols) {
+    constexpr int L = 4;
+    auto exchange = [cols](int i, int j) {
+        for (int s = 0; s < L; s++) {
+            double x = cols[i * L + s], y = cols[j * L + s];
+            cols[i * L + s] = std::min(x, y);
+            cols[j * L + s] = std::max(x, y);
+        }
+    };
+    for (int k = 2; k <= N; k *= 2) {
+        for (int base = 0; base < N; base += k) {
+            for (int t = 0; t < k / 2; t++) exchange(base + t, base + k - 1 - t);
+        }
+        for (int j = k / 4; j > 0; j /= 2) {
+            for (int i = 0; i < N; i++) {
+                if (!(i & j)) exchange(i, i + j);
+            }
+        }
+    }
+}
+
+#ifdef SORTNET_X86
+template <int N>
+__attribute__((target("avx2"))) void laneSortAVX2(double* cols) {
+    __m256d v[N];
+    for (int i = 0; i < N; i++) v[i] = _mm256_load_pd(cols + 4 * i);
+    for (int k = 2; k <= N; k *= 2) {
+        for (int base = 0; base < N; base += k) {
+            for (int t = 0; t < k / 2; t++) {
+                __m256d x = v[base + t], y = v[base + k - 1 - t];
+                v[base + t] = _mm256_min_pd(x, y);
+                v[base + k - 1 - t] = _mm256_max_pd(x, y);
+            }
+        }
+        for (int j = k / 4; j > 0; j /= 2) {
+            for (int i = 0; i < N; i++) {
+                if (i & j) continue;
+                __m256d x = v[i], y = v[i + j];
+                v[i] = _mm256_min_pd(x, y);
+                v[i + j] = _mm256_max_pd(x, y);
+            }
+        }
+    }
+    for (int i = 0; i < N; i++) _mm256_store_pd(cols + 4 * i, v[i]);
+}
+
+template <int N>
+__attribute__((target("avx512f"))) void laneSortAVX512(double* cols) {
+    __m512d v[N];
+    for (int i = 0; i < N; i++) v[i] = _mm512_load_pd(cols + 8 * i);
+    for (int k = 2; k <= N; k *= 2) {
+        for (int base = 0; base < N; base += k) {
+            for (int t = 0; t < k / 2; t++) {
+                __m512d x = v[base + t], y = v[base + k - 1 - t];
+                v[base + t] = _mm512_min_pd(x, y);
+                v[base + k - 1 - t] = _mm512_max_pd(x, y);
+            }
+        }
+        for (int j = k / 4; j > 0; j /= 2) {
+            for (int i = 0; i < N; i++) {
+                if (i & j) continue;
+                __m512d x = v[i], y = v[i + j];
+                v[i] = _mm512_min_pd(x, y);
+                v[i + j] = _mm512_max_pd(x, y);
+            }
+        }
+    }
+    for (int i = 0; i < N; i++) _mm512_store_pd(cols + 8 * i, v[i]);
+}
+#endif
+
+// Lane count and the 8- and 16-row kernels of one instruction set
+struct LaneKernels {
+    int lanes;
+    void (*sort[2])(double*);
+};
+
+// Picks AVX-512, AVX2 or the scalar kernels once, like networkKernels()
+inline const LaneKernels& laneKernels() {
+    static const LaneKernels kernels = [] {
+#ifdef SORTNET_X86
+        if (__builtin_cpu_supports("avx512f")) return LaneKernels{8, {laneSortAVX512<8>, laneSortAVX512<16>}};
+        if (__builtin_cpu_supports("avx2")) return LaneKernels{4, {laneSortAVX2<8>, laneSortAVX2<16>}};
+#endif
+        return LaneKernels{4, {laneSortScalar<8>, laneSortScalar<16>}};
+    }();
+    return kernels;
+}
+
+// Sorts `count` segments of at most LANE_NETWORK_MAX elements side by side, one per lane
+inline void laneBatchSort(double* const* segs, const ptrdiff_t* lens, int count) {
+    const LaneKernels& kernels = laneKernels();
+    const int lanes = kernels.lanes;
+    const ptrdiff_t longest = *std::max_element(lens, lens + count);
+    const int rows = longest <= 8 ? 8 : 16;
+
+    alignas(64) double cols[LANE_NETWORK_MAX * MAX_LANES];
+    std::fill(cols, cols + rows * lanes, std::numeric_limits<double>::infinity());
+    for (int s = 0; s < count; s++) {
+        for (ptrdiff_t i = 0; i < lens[s]; i++) cols[i * lanes + s] = segs[s][i];
+    }
+    kernels.sort[rows == 16](cols);
+    for (int s = 0; s < count; s++) {
+        for (ptrdiff_t i = 0; i < lens[s]; i++) segs[s][i] = cols[i * lanes + s];
+    }
+}
+
+// The calling thread's merge scratch, grown to at least size doubles and kept between sorts
+inline double* segmentScratch(ptrdiff_t size) {
+    thread_local std::vector<double> scratch;
+    if ((ptrdiff_t)scratch.size() < size) scratch.resize(size);
+    return scratch.data();
+}
+
+// Sorts a[0..len) by networks on SEGMENT_LEAF blocks, then bottom-up merges that
+// alternate between a and scratch
+inline void blockMergeSort(double* a, ptrdiff_t len, double* scratch) {
+    for (ptrdiff_t b = 0; b < len; b += SEGMENT_LEAF) networkSort(a + b, std::min(SEGMENT_LEAF, len - b));
+    double* src = a;
+    double* dst = scratch;
+    for (ptrdiff_t width = SEGMENT_LEAF; width < len; width *= 2) {
+        for (ptrdiff_t lo = 0; lo < len; lo += 2 * width) {
+            const ptrdiff_t mid = std::min(lo + width, len), hi = std::min(lo + 2 * width, len);
+            mergeRuns(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+        }
+        std::swap(src, dst);
+    }
+    if (src != a) std::memcpy(a, src, len * sizeof(double));
+}
+
+// Sorts segments [first, last) on the calling thread
+inline void sortSegments(double* data, const ptrdiff_t* offsets, ptrdiff_t first, ptrdiff_t last) {
+    const int lanes = laneKernels().lanes;
+    double* batch[MAX_LANES];
+    ptrdiff_t lens[MAX_LANES];
+    int pending = 0;
+    for (ptrdiff_t s = first; s < last; s++) {
+        double* seg = data + offsets[s];
+        const ptrdiff_t len = offsets[s + 1] - offsets[s];
+        if (len < 2) continue;
+        if (len <= LANE_NETWORK_MAX) {
+            batch[pending] = seg;
+            lens[pending] = len;
+            if (++pending == lanes) {
+                laneBatchSort(batch, lens, pending);
+                pending = 0;
+            }
+        } else if (len <= MAX_NETWORK_SIZE) {
+            networkSort(seg, len);
+        } else {
+            blockMergeSort(seg, len, segmentScratch(len));
+        }
+    }
+    if (pending > 0) laneBatchSort(batch, lens, pending);
+}
+
+// Sorts every segment data[offsets[s]..offsets[s + 1]) for s < segments (offsets holds
+// segments + 1 entries, non-decreasing). Tasks take runs of whole segments holding about
+// equal numbers of elements.
+inline void segmentedSort(double* data, const ptrdiff_t* offsets, ptrdiff_t segments, WorkStealingPool& pool = WorkStealingPool::instance()) {
+    if (segments <= 0) return;
+    const ptrdiff_t total = offsets[segments] - offsets[0];
+    // Several tasks per thread, so threads that drew short segments steal the rest
+    const int chunks = (int)std::max<ptrdiff_t>(1, std::min<ptrdiff_t>(4 * ((ptrdiff_t)pool.size() + 1), total / SEGMENT_GRAIN));
+    if (chunks == 1) {
+        sortSegments(data, offsets, 0, segments);
+        return;
+    }
+
+    // Chunk c starts at the first segment starting at or after its share of the elements
+    std::vector<ptrdiff_t> bounds(chunks + 1);
+    for (int c = 0; c <= chunks; c++) {
+        const ptrdiff_t target = offsets[0] + total * c / chunks;
+        bounds[c] = c == chunks ? segments : std::lower_bound(offsets, offsets + segments, target) - offsets;
+    }
+    TaskGroup group(pool);
+    for (int c = 0; c < chunks; c++) {
+        const ptrdiff_t first = bounds[c], last = bounds[c + 1];
+        if (first < last) group.run([=] { sortSegments(data, offsets, first, last); });
+    }
+    group.wait();
+}
+
+inline void segmentedSort(std::vector<double>& data, const std::vector<ptrdiff_t>& offsets, WorkStealingPool& pool = WorkStealingPool::instance()) {
+    segmentedSort(data.data(), offsets.data(), (ptrdiff_t)offsets.size() - 1, pool);
+}
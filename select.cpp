@@ -0,0 +1,83 @@
+// Top-k, partial sort, nth_element and quantile selection against a full sort, e.g.
+//   select --sizes 1e8 --threads 1,16 --engines 'topk*,partial_sort*'
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "select.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    opts.sizes = {10000000, 100000000};
+    opts.reps = 5;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    const vector<ptrdiff_t> k_values = {10, 1000, 1000000};
+    vector<double> percentiles;
+    for (int p = 1; p < 100; p++) percentiles.push_back(p / 100.0);
+
+    BenchReport report(opts);
+    report.run([&](const BenchConfig& cfg) {
+        const ptrdiff_t n = cfg.n;
+        const vector<double>& arr = cfg.arr;
+        WorkStealingPool& pool = cfg.pool;
+        vector<double> work(n), aux(n);
+        auto prepare = [&] { memcpy(work.data(), arr.data(), n * sizeof(double)); };
+        if (report.text()) cout << "Selecting from " << n << " " << inputPatternName(cfg.input) << " elements with " << cfg.threads << " threads..." << endl;
+
+        double full_ms = 0;
+        auto record = [&](const string& name, const BenchStats& stats) {
+            report.record({name, cfg.input, n, cfg.threads, stats, {}});
+            if (report.text() && full_ms > 0) cout << "    " << full_ms / stats.median << "x faster than the full sort" << endl;
+        };
+
+        // Baseline: the threaded merge sort of the whole array
+        record("full sort", measureRuns(opts.reps, opts.warmup, prepare, [&] {
+            sortPrefix(work, aux, n, pool);
+        }, [&] { return is_sorted(work.begin(), work.end()); }));
+        full_ms = report.results().back().stats.median;
+
+        for (ptrdiff_t k : k_values) {
+            if (k >= n) continue;
+            const string suffix = " k=" + to_string(k);
+            vector<double> top;
+            auto top_ok = [&] { return (ptrdiff_t)top.size() == k && is_sorted(top.begin(), top.end()); };
+            auto prefix_ok = [&] { return is_sorted(work.begin(), work.begin() + k) && *min_element(work.begin() + k, work.end()) >= work[k - 1]; };
+            auto nth_ok = [&] { return *max_element(work.begin(), work.begin() + k) <= work[k] && *min_element(work.begin() + k, work.end()) >= work[k]; };
+
+            if (report.selected("topk" + suffix)) {
+                record("topk" + suffix, measureRuns(opts.reps, opts.warmup, [] {},
+                                                    [&] { top = parallelTopK(arr.data(), n, k, pool); }, top_ok));
+            }
+            if (report.selected("partial_sort" + suffix)) {
+                record("partial_sort" + suffix, measureRuns(opts.reps, opts.warmup, prepare,
+                                                            [&] { parallelPartialSort(work, aux, k, pool); }, prefix_ok));
+            }
+            if (report.selected("std::partial_sort" + suffix)) {
+                record("std::partial_sort" + suffix, measureRuns(opts.reps, opts.warmup, prepare,
+                                                                 [&] { partial_sort(work.begin(), work.begin() + k, work.end()); }, prefix_ok));
+            }
+            if (report.selected("nth_element" + suffix)) {
+                record("nth_element" + suffix, measureRuns(opts.reps, opts.warmup, prepare,
+                                                           [&] { parallelNthElement(work, aux, k, pool); }, nth_ok));
+            }
+            if (report.selected("std::nth_element" + suffix)) {
+                record("std::nth_element" + suffix, measureRuns(opts.reps, opts.warmup, prepare,
+                                                                [&] { nth_element(work.begin(), work.begin() + k, work.end()); }, nth_ok));
+            }
+        }
+
+        vector<double> values;
+        if (report.selected("quantiles p1..p99")) {
+            record("quantiles p1..p99", measureRuns(opts.reps, opts.warmup, prepare,
+                                                    [&] { values = parallelQuantiles(work, aux, percentiles, pool); },
+                                                    [&] { return is_sorted(values.begin(), values.end()); }));
+        }
+    });
+    return report.finish();
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "threadpool.h"
+#include "merge.h"
+#include "parallel_merge.h"
+#include "mergesorttk.h"
+#include "samplesort.h"
+#include "tuning.h"
+
+// Selection engines for queries that need only part of the order: top-k, partial sort,
+// nth_element and multi-quantile selection. Small k keeps a bounded heap per chunk and
+// merges the chunks' results; larger k and single ranks narrow the range by sampling two
+// pivots that bracket the wanted rank and partitioning around them in parallel; many
+// ranks at once share one splitter-tree bucket pass.
+
+constexpr ptrdiff_t SELECT_SEQUENTIAL = 1 << 16;   // Ranges up to this size use std::nth_element
+constexpr ptrdiff_t SELECT_SAMPLE = 1 << 14;       // Sample drawn per partitioning round
+constexpr ptrdiff_t TOPK_HEAP_MAX = 1 << 14;       // Larger k selects instead of keeping heaps
+
+// Replaces the top of a heap of k elements (comp-largest on top) by x and sifts it down
+template <typename Comp>
+void replaceTop(double* heap, ptrdiff_t k, double x, Comp& comp) {
+    ptrdiff_t i = 0;
+    while (true) {
+        ptrdiff_t child = 2 * i + 1;
+        if (child >= k) break;
+        if (child + 1 < k && comp(heap[child], heap[child + 1])) child++;
+        if (!comp(x, heap[child])) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = x;
+}
+
+// Merge of two sorted runs cut to its first `limit` elements, with the SIMD kernel for
+// the default order
+template <typename Comp>
+std::vector<double> mergeFirst(const std::vector<double>& a, const std::vector<double>& b, ptrdiff_t limit, Comp& comp) {
+    std::vector<double> merged(a.size() + b.size());
+    if constexpr (std::is_same_v<Comp, std::less<double>>) {
+        mergeRuns(a.data(), a.size(), b.data(), b.size(), merged.data());
+    } else {
+        std::merge(a.begin(), a.end(), b.begin(), b.end(), merged.begin(), comp);
+    }
+    merged.resize(std::min<ptrdiff_t>(limit, merged.size()));
+    return merged;
+}
+
+// Heap top-k for 0 < k <= n: every chunk runs one pass with a bounded heap of its k best,
+// so most elements cost a single compare against the heap top; the sorted heaps are then
+// merged pairwise, truncated to k
+template <typename Comp>
+std::vector<double> topKHeaps(const double* arr, ptrdiff_t n, ptrdiff_t k, WorkStealingPool& pool, Comp& comp) {
+    const int chunks = parallelChunks(n, pool);
+    std::vector<std::vector<double>> best(chunks);
+    {
+        TaskGroup group(pool);
+        for (int c = 0; c < chunks; c++) {
+            group.run([&, c] {
+                const double* begin = arr + n * c / chunks;
+                const double* end = arr + n * (c + 1) / chunks;
+                const ptrdiff_t size = std::min<ptrdiff_t>(k, end - begin);
+                std::vector<double>& heap = best[c];
+                heap.assign(begin, begin + size);
+                std::make_heap(heap.begin(), heap.end(), comp);
+                for (const double* p = begin + size; p < end; p++) {
+                    if (comp(*p, heap[0])) replaceTop(heap.data(), size, *p, comp);
+                }
+                std::sort_heap(heap.begin(), heap.end(), comp);
+            });
+        }
+        group.wait();
+    }
+
+    // At most chunks * k elements remain: merge rounds of pairs, each run cut to k
+    for (size_t width = 1; width < best.size(); width *= 2) {
+        for (size_t i = 0; i + width < best.size(); i += 2 * width) {
+            best[i] = mergeFirst(best[i], best[i + width], k, comp);
+        }
+    }
+    best[0].resize(k);
+    return best[0];
+}
+
+// Three-way partition of a[lo..hi) around lo_pivot <= hi_pivot through aux: elements below
+// lo_pivot first, then those in [lo_pivot, hi_pivot], then the rest. Returns the sizes of
+// the first two groups.
+inline std::pair<ptrdiff_t, ptrdiff_t> partition3(double* a, double* aux, ptrdiff_t lo, ptrdiff_t hi, double lo_pivot, double hi_pivot,
+                                                  WorkStealingPool& pool) {
+    const ptrdiff_t n = hi - lo;
+    const int chunks = parallelChunks(n, pool);
+    std::vector<ptrdiff_t> counts(3 * chunks, 0);
+    auto group_of = [&](double x) { return x < lo_pivot ? 0 : (x > hi_pivot ? 2 : 1); };
+    {
+        TaskGroup group(pool);
+        for (int c = 0; c < chunks; c++) {
+            group.run([&, c] {
+                ptrdiff_t* count = counts.data() + 3 * c;
+                const ptrdiff_t begin = lo + n * c / chunks, end = lo + n * (c + 1) / chunks;
+                for (ptrdiff_t i = begin; i < end; i++) count[group_of(a[i])]++;
+            });
+        }
+        group.wait();
+    }
+
+    // Output offsets: every group in chunk order
+    std::vector<ptrdiff_t> offsets(3 * chunks);
+    ptrdiff_t total = lo;
+    for (int g = 0; g < 3; g++) {
+        for (int c = 0; c < chunks; c++) {
+            offsets[3 * c + g] = total;
+            total += counts[3 * c + g];
+        }
+    }
+    {
+        TaskGroup group(pool);
+        for (int c = 0; c < chunks; c++) {
+            group.run([&, c] {
+                ptrdiff_t out[3] = {offsets[3 * c], offsets[3 * c + 1], offsets[3 * c + 2]};
+                const ptrdiff_t begin = lo + n * c / chunks, end = lo + n * (c + 1) / chunks;
+                for (ptrdiff_t i = begin; i < end; i++) aux[out[group_of(a[i])]++] = a[i];
+            });
+        }
+        group.wait();
+    }
+    parallelCopy(aux + lo, a + lo, n, pool);
+
+    ptrdiff_t below = 0, between = 0;
+    for (int c = 0; c < chunks; c++) {
+        below += counts[3 * c];
+        between += counts[3 * c + 1];
+    }
+    return {below, between};
+}
+
+// std::nth_element on a[lo..hi) in parallel: a sample of SELECT_SAMPLE elements gives two
+// pivots about three standard deviations either side of the wanted rank, so one partition
+// round almost always leaves it in a middle group of a few percent of the range, which
+// the next round (or std::nth_element once small) finishes. A round that cannot shrink the
+// range (few distinct values) is followed by one around a single pivot, whose equal group
+// ends the search if it holds the rank.
+inline void selectRange(double* a, double* aux, ptrdiff_t lo, ptrdiff_t hi, ptrdiff_t nth, WorkStealingPool& pool) {
+    std::mt19937_64 gen(hi * 31 + nth);
+    std::vector<double> sample;
+    bool single_pivot = false;
+    while (hi - lo > SELECT_SEQUENTIAL) {
+        const ptrdiff_t n = hi - lo;
+        std::uniform_int_distribution<ptrdiff_t> pick(lo, hi - 1);
+        sample.resize(SELECT_SAMPLE);
+        for (double& x : sample) x = a[pick(gen)];
+        std::sort(sample.begin(), sample.end());
+
+        const ptrdiff_t s = sample.size();
+        const ptrdiff_t rank = (ptrdiff_t)((double)(nth - lo) / n * s);
+        const ptrdiff_t margin = single_pivot ? 0 : 3 * (ptrdiff_t)std::sqrt((double)s);
+        const double lo_pivot = sample[std::max<ptrdiff_t>(0, rank - margin)];
+        const double hi_pivot = sample[std::min<ptrdiff_t>(s - 1, rank + margin)];
+
+        auto [below, between] = partition3(a, aux, lo, hi, lo_pivot, hi_pivot, pool);
+        single_pivot = between == n;
+        if (nth < lo + below) {
+            hi = lo + below;
+        } else if (nth >= lo + below + between) {
+            lo += below + between;
+        } else {
+            lo += below;
+            hi = lo + between;
+            if (lo_pivot == hi_pivot) return;   // The middle group is one repeated value
+        }
+    }
+    std::nth_element(a + lo, a + nth, a + hi);
+}
+
+// Threaded merge sort of v[0..m) with the leaf size and grain of the tuning profile
+inline void sortPrefix(std::vector<double>& v, std::vector<double>& aux, ptrdiff_t m, WorkStealingPool& pool) {
+    const TuningProfile& profile = tunedProfile();
+    mergeSort(v, aux, 0, m - 1, profile.k, profile.minThreadSize(m, pool.size() + 1), pool, networkSort);
+}
+
+// The k comp-smallest elements of arr[0..n) in order (by default the k smallest,
+// std::greater<double> gives the k largest); arr is only read. k up to TOPK_HEAP_MAX, or
+// any other order, keeps per-chunk heaps; above that a copy of arr is partitioned at rank
+// k and only its k-element end is sorted.
+template <typename Comp = std::less<double>>
+std::vector<double> parallelTopK(const double* arr, ptrdiff_t n, ptrdiff_t k, WorkStealingPool& pool = WorkStealingPool::instance(),
+                                 Comp comp = {}) {
+    k = std::min(k, n);
+    if (k <= 0) return {};
+    constexpr bool ascending = std::is_same_v<Comp, std::less<double>>;
+    constexpr bool descending = std::is_same_v<Comp, std::greater<double>>;
+    if (k <= TOPK_HEAP_MAX || !(ascending || descending)) return topKHeaps(arr, n, k, pool, comp);
+
+    std::vector<double> a(n), aux(n);
+    parallelCopy(arr, a.data(), n, pool);
+    const ptrdiff_t lo = ascending ? 0 : n - k;
+    if (k < n) selectRange(a.data(), aux.data(), 0, n, ascending ? k - 1 : n - k, pool);
+    std::vector<double> top(a.begin() + lo, a.begin() + lo + k), top_aux(k);
+    sortPrefix(top, top_aux, k, pool);
+    if (descending) std::reverse(top.begin(), top.end());
+    return top;
+}
+
+// Rearranges arr like std::nth_element(arr.begin(), arr.begin() + nth, arr.end())
+inline void parallelNthElement(std::vector<double>& arr, std::vector<double>& aux, ptrdiff_t nth,
+                               WorkStealingPool& pool = WorkStealingPool::instance()) {
+    if (nth < 0 || nth >= (ptrdiff_t)arr.size()) return;
+    selectRange(arr.data(), aux.data(), 0, arr.size(), nth, pool);
+}
+
+// Moves the multiset top (the k smallest of arr, sorted) to arr[0..k), leaving the other
+// elements in arr[k..n): positions holding a value below top[k-1], plus the first ones
+// holding exactly top[k-1] until k are picked, are the elements to bring forward; each
+// picked slot at or past k takes an unpicked element from the front, which top overwrites.
+inline void moveTopToFront(std::vector<double>& arr, const std::vector<double>& top, WorkStealingPool& pool) {
+    const ptrdiff_t n = arr.size(), k = top.size();
+    const double t = top[k - 1];
+    const ptrdiff_t need_equal = top.end() - std::lower_bound(top.begin(), top.end(), t);
+    const int chunks = parallelChunks(n, pool);
+    std::vector<std::vector<ptrdiff_t>> below(chunks), equal(chunks);
+    {
+        TaskGroup group(pool);
+        for (int c = 0; c < chunks; c++) {
+            group.run([&, c] {
+                const double* a = arr.data();
+                const ptrdiff_t begin = n * c / chunks, end = n * (c + 1) / chunks;
+                for (ptrdiff_t i = begin; i < end; i++) {
+                    if (a[i] <= t) {
+                        if (a[i] < t) below[c].push_back(i);
+                        else if ((ptrdiff_t)equal[c].size() < need_equal) equal[c].push_back(i);
+                    }
+                }
+            });
+        }
+        group.wait();
+    }
+
+    std::vector<ptrdiff_t> picked;
+    ptrdiff_t equal_left = need_equal;
+    for (int c = 0; c < chunks; c++) {
+        const ptrdiff_t take = std::min<ptrdiff_t>(equal_left, equal[c].size());
+        equal_left -= take;
+        picked.insert(picked.end(), below[c].begin(), below[c].end());
+        picked.insert(picked.end(), equal[c].begin(), equal[c].begin() + take);
+    }
+    std::sort(picked.begin(), picked.end());
+
+    // Unpicked front slots, in order, refill the picked slots past the front
+    auto back = std::lower_bound(picked.begin(), picked.end(), k);
+    auto next = picked.begin();
+    for (ptrdiff_t i = 0; back != picked.end(); i++) {
+        if (next != picked.end() && *next == i) {
+            next++;
+        } else {
+            arr[*back++] = arr[i];
+        }
+    }
+    std::copy(top.begin(), top.end(), arr.begin());
+}
+
+// Like std::partial_sort(arr.begin(), arr.begin() + k, arr.end()). Small k takes the heap
+// top-k and moves it to the front; larger k selects the k smallest into place, then the
+// threaded merge sort (network leaves, SIMD merges) orders them.
+inline void parallelPartialSort(std::vector<double>& arr, std::vector<double>& aux, ptrdiff_t k,
+                                WorkStealingPool& pool = WorkStealingPool::instance()) {
+    const ptrdiff_t n = arr.size();
+    k = std::min(k, n);
+    if (k <= 0) return;
+    if (k < n && k <= TOPK_HEAP_MAX) {
+        std::less<double> comp;
+        moveTopToFront(arr, topKHeaps(arr.data(), n, k, pool, comp), pool);
+        return;
+    }
+    if (k < n) selectRange(arr.data(), aux.data(), 0, n, k - 1, pool);
+    sortPrefix(arr, aux, k, pool);
+}
+
+// Places every rank of ranks[0..count) (sorted, unique) within a[lo..hi), as an
+// nth_element per rank would. A sample gives each rank two splitters bracketing it, like
+// selectRange's pivots; one splitter-tree scatter through aux then cuts the range into
+// buckets, and only those holding a rank recurse, concurrently. Equality buckets are
+// already done, and one rank alone goes to selectRange.
+inline void multiSelect(double* a, double* aux, ptrdiff_t lo, ptrdiff_t hi, const ptrdiff_t* ranks, ptrdiff_t count,
+                        WorkStealingPool& pool) {
+    if (count == 0) return;
+    const ptrdiff_t n = hi - lo;
+    if (n <= SELECT_SEQUENTIAL) {
+        const ptrdiff_t m = count / 2;
+        std::nth_element(a + lo, a + ranks[m], a + hi);
+        multiSelect(a, aux, lo, ranks[m], ranks, m, pool);
+        multiSelect(a, aux, ranks[m] + 1, hi, ranks + m + 1, count - m - 1, pool);
+        return;
+    }
+    if (count == 1) {
+        selectRange(a, aux, lo, hi, ranks[0], pool);
+        return;
+    }
+    if (2 * count > MAX_SPLITTERS) {
+        // Too many ranks for one tree: split at the middle one and recurse on both sides
+        const ptrdiff_t m = count / 2, nth = ranks[m];
+        selectRange(a, aux, lo, hi, nth, pool);
+        TaskGroup group(pool);
+        group.run([&] { multiSelect(a, aux, lo, nth, ranks, m, pool); });
+        multiSelect(a, aux, nth + 1, hi, ranks + m + 1, count - m - 1, pool);
+        group.wait();
+        return;
+    }
+
+    std::mt19937_64 gen(hi * 31 + count);
+    std::uniform_int_distribution<ptrdiff_t> pick(lo, hi - 1);
+    std::vector<double> sample(SELECT_SAMPLE);
+    for (double& x : sample) x = a[pick(gen)];
+    std::sort(sample.begin(), sample.end());
+    const ptrdiff_t s = sample.size();
+    const ptrdiff_t margin = 3 * (ptrdiff_t)std::sqrt((double)s);
+    std::vector<double> splitters;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        const ptrdiff_t rank = (ptrdiff_t)((double)(ranks[i] - lo) / n * s);
+        splitters.push_back(sample[std::max<ptrdiff_t>(0, rank - margin)]);
+        splitters.push_back(sample[std::min<ptrdiff_t>(s - 1, rank + margin)]);
+    }
+    std::sort(splitters.begin(), splitters.end());
+    splitters.erase(std::unique(splitters.begin(), splitters.end()), splitters.end());
+
+    SplitterTree tree(splitters);
+    const std::vector<ptrdiff_t> bucket_start = scatterToBuckets(a + lo, aux + lo, n, tree, pool);
+    parallelCopy(aux + lo, a + lo, n, pool);
+
+    TaskGroup group(pool);
+    const ptrdiff_t* rank = ranks;
+    for (int b = 0; b < tree.numBuckets(); b++) {
+        const ptrdiff_t b_lo = lo + bucket_start[b], b_hi = lo + bucket_start[b + 1];
+        const ptrdiff_t* first = rank;
+        while (rank < ranks + count && *rank < b_hi) rank++;
+        if (rank == first || b % 2 == 1) continue;
+        group.run([=, &pool] { multiSelect(a, aux, b_lo, b_hi, first, rank - first, pool); });
+    }
+    group.wait();
+}
+
+// Values of the given quantiles (0..1, nearest rank below: q * (n - 1)); arr is left
+// partitioned at every one of their ranks, as if by an nth_element per rank
+inline std::vector<double> parallelQuantiles(std::vector<double>& arr, std::vector<double>& aux, const std::vector<double>& quantiles,
+                                             WorkStealingPool& pool = WorkStealingPool::instance()) {
+    const ptrdiff_t n = arr.size();
+    if (n == 0) return std::vector<double>(quantiles.size(), 0.0);
+    std::vector<ptrdiff_t> ranks;
+    for (double q : quantiles) ranks.push_back(std::clamp<ptrdiff_t>((ptrdiff_t)(q * (n - 1)), 0, n - 1));
+    std::vector<ptrdiff_t> unique_ranks = ranks;
+    std::sort(unique_ranks.begin(), unique_ranks.end());
+    unique_ranks.erase(std::unique(unique_ranks.begin(), unique_ranks.end()), unique_ranks.end());
+
+    multiSelect(arr.data(), aux.data(), 0, n, unique_ranks.data(), unique_ranks.size(), pool);
+    std::vector<double> values;
+    for (ptrdiff_t r : ranks) values.push_back(arr[r]);
+    return values;
+}
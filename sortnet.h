@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SORTNET_X86 1
+#endif
+
+// Bitonic sorting networks for 8/16/32/64 doubles, used as the leaf sorter of the
+// hybrid merge sorts. Every comparator puts the minimum at the lower index: the first
+// step of each merge stage compares i with its mirror inside the block (i ^ (k - 1)),
+// the following steps compare i with i ^ j, so no per-stage direction flags are needed.
+
+constexpr int MAX_NETWORK_SIZE = 64;
+
+using LeafSortFn = void (*)(std::vector<double>& arr, ptrdiff_t left, ptrdiff_t right);
+
+template <int N>
+void bitonicSortScalar(double* a) {
+    for (int k = 2; k <= N; k *= 2) {
+        for (int base = 0; base < N; base += k) {
+            for (int t = 0; t < k / 2; t++) {
+                double x = a[base + t], y = a[base + k - 1 - t];
+                a[base + t] = std::min(x, y);
+                a[base + k - 1 - t] = std::max(x, y);
+            }
+        }
+        for (int j = k / 4; j > 0; j /= 2) {
+            for (int i = 0; i < N; i++) {
+                if (i & j) continue;
+                double x = a[i], y = a[i + j];
+                a[i] = std::min(x, y);
+                a[i + j] = std::max(x, y);
+            }
+        }
+    }
+}
+
+#ifdef SORTNET_X86
+#define SORTNET_AVX2 __attribute__((target("avx2"), always_inline)) inline
+#define SORTNET_AVX512 __attribute__((target("avx512f"), always_inline)) inline
+
+SORTNET_AVX2 __m256d reverse4(__m256d v) { return _mm256_permute4x64_pd(v, 0x1B); }
+
+// Compare-exchange of each lane of p with the same lane of `swapped`; lanes set in
+// take_max keep the maximum
+SORTNET_AVX2 void exchange4(double* p, __m256d v, __m256d swapped, int take_max) {
+    __m256d mask = _mm256_castsi256_pd(_mm256_set_epi64x(
+        -((take_max >> 3) & 1), -((take_max >> 2) & 1), -((take_max >> 1) & 1), -(take_max & 1)));
+    _mm256_storeu_pd(p, _mm256_blendv_pd(_mm256_min_pd(v, swapped), _mm256_max_pd(v, swapped), mask));
+}
+
+SORTNET_AVX512 __m512d reverse8(__m512d v) {
+    return _mm512_permutexvar_pd(_mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7), v);
+}
+
+SORTNET_AVX512 void exchange8(double* p, __m512d v, __m512d swapped, __mmask8 take_max) {
+    _mm512_storeu_pd(p, _mm512_mask_blend_pd(take_max, _mm512_min_pd(v, swapped), _mm512_max_pd(v, swapped)));
+}
+
+// AVX2: four doubles per register. Steps with j >= 4 compare whole registers, the
+// j = 2 and j = 1 steps (and the k = 2, 4 mirror steps) shuffle inside a register.
+template <int N>
+__attribute__((target("avx2"))) void bitonicSortAVX2(double* a) {
+    static_assert(N >= 8 && N % 4 == 0);
+    for (int k = 2; k <= N; k *= 2) {
+        for (int i = 0; i < N && k <= 4; i += 4) {
+            __m256d v = _mm256_loadu_pd(a + i);
+            if (k == 2) exchange4(a + i, v, _mm256_permute_pd(v, 0x5), 0b1010);
+            else exchange4(a + i, v, reverse4(v), 0b1100);
+        }
+        for (int base = 0; base < N && k > 4; base += k) {
+            for (int t = 0; t < k / 2; t += 4) {
+                double* p = a + base + t;
+                double* q = a + base + k - 4 - t;
+                __m256d x = _mm256_loadu_pd(p), y = reverse4(_mm256_loadu_pd(q));
+                _mm256_storeu_pd(p, _mm256_min_pd(x, y));
+                _mm256_storeu_pd(q, reverse4(_mm256_max_pd(x, y)));
+            }
+        }
+        for (int j = k / 4; j > 0; j /= 2) {
+            for (int i = 0; i < N; i += 4) {
+                if (j >= 4) {
+                    if (i & j) continue;
+                    __m256d x = _mm256_loadu_pd(a + i), y = _mm256_loadu_pd(a + i + j);
+                    _mm256_storeu_pd(a + i, _mm256_min_pd(x, y));
+                    _mm256_storeu_pd(a + i + j, _mm256_max_pd(x, y));
+                    continue;
+                }
+                __m256d v = _mm256_loadu_pd(a + i);
+                if (j == 2) exchange4(a + i, v, _mm256_permute2f128_pd(v, v, 1), 0b1100);
+                else exchange4(a + i, v, _mm256_permute_pd(v, 0x5), 0b1010);
+            }
+        }
+    }
+}
+
+// AVX-512: eight doubles per register, same schedule with masked blends
+template <int N>
+__attribute__((target("avx512f"))) void bitonicSortAVX512(double* a) {
+    static_assert(N >= 8 && N % 8 == 0);
+    for (int k = 2; k <= N; k *= 2) {
+        for (int i = 0; i < N && k <= 8; i += 8) {
+            __m512d v = _mm512_loadu_pd(a + i);
+            if (k == 2) exchange8(a + i, v, _mm512_permute_pd(v, 0x55), 0xAA);
+            else if (k == 4) exchange8(a + i, v, _mm512_permutex_pd(v, 0x1B), 0xCC);
+            else exchange8(a + i, v, reverse8(v), 0xF0);
+        }
+        for (int base = 0; base < N && k > 8; base += k) {
+            for (int t = 0; t < k / 2; t += 8) {
+                double* p = a + base + t;
+                double* q = a + base + k - 8 - t;
+                __m512d x = _mm512_loadu_pd(p), y = reverse8(_mm512_loadu_pd(q));
+                _mm512_storeu_pd(p, _mm512_min_pd(x, y));
+                _mm512_storeu_pd(q, reverse8(_mm512_max_pd(x, y)));
+            }
+        }
+        for (int j = k / 4; j > 0; j /= 2) {
+            for (int i = 0; i < N; i += 8) {
+                if (j >= 8) {
+                    if (i & j) continue;
+                    __m512d x = _mm512_loadu_pd(a + i), y = _mm512_loadu_pd(a + i + j);
+                    _mm512_storeu_pd(a + i, _mm512_min_pd(x, y));
+                    _mm512_storeu_pd(a + i + j, _mm512_max_pd(x, y));
+                    continue;
+                }
+                __m512d v = _mm512_loadu_pd(a + i);
+                if (j == 4) exchange8(a + i, v, _mm512_shuffle_f64x2(v, v, 0x4E), 0xF0);
+                else if (j == 2) exchange8(a + i, v, _mm512_permutex_pd(v, 0x4E), 0xCC);
+                else exchange8(a + i, v, _mm512_permute_pd(v, 0x55), 0xAA);
+            }
+        }
+    }
+}
+#endif
+
+// Kernels for 8, 16, 32 and 64 elements of one instruction set
+struct NetworkKernels {
+    void (*sort[4])(double*);
+};
+
+// Picks AVX-512, AVX2 or the scalar network once, based on the CPU we are running on
+inline const NetworkKernels& networkKernels() {
+    static const NetworkKernels kernels = [] {
+#ifdef SORTNET_X86
+        if (__builtin_cpu_supports("avx512f")) {
+            return NetworkKernels{{bitonicSortAVX512<8>, bitonicSortAVX512<16>, bitonicSortAVX512<32>, bitonicSortAVX512<64>}};
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return NetworkKernels{{bitonicSortAVX2<8>, bitonicSortAVX2<16>, bitonicSortAVX2<32>, bitonicSortAVX2<64>}};
+        }
+#endif
+        return NetworkKernels{{bitonicSortScalar<8>, bitonicSortScalar<16>, bitonicSortScalar<32>, bitonicSortScalar<64>}};
+    }();
+    return kernels;
+}
+
+// Sorts a[0..len) with the smallest network that fits, padding with +infinity.
+// Ranges above MAX_NETWORK_SIZE fall back to insertion sort.
+inline void networkSort(double* a, ptrdiff_t len) {
+    if (len < 2) return;
+    if (len > MAX_NETWORK_SIZE) {
+        for (ptrdiff_t i = 1; i < len; i++) {
+            double key = a[i];
+            ptrdiff_t j = i - 1;
+            while (j >= 0 && a[j] > key) {
+                a[j + 1] = a[j];
+                j--;
+            }
+            a[j + 1] = key;
+        }
+        return;
+    }
+
+    int size = 8, which = 0;
+    while (size < len) {
+        size *= 2;
+        which++;
+    }
+    alignas(64) double buffer[MAX_NETWORK_SIZE];
+    std::copy(a, a + len, buffer);
+    std::fill(buffer + len, buffer + size, std::numeric_limits<double>::infinity());
+    networkKernels().sort[which](buffer);
+    std::copy(buffer, buffer + len, a);
+}
+
+// Leaf sorter with the same signature as insertionSort(arr, left, right)
+inline void networkSort(std::vector<double>& arr, ptrdiff_t left, ptrdiff_t right) {
+    networkSort(arr.data() + left, right - left + 1);
+}
@@ -0,0 +1,110 @@
+// Streaming sort against the batch path on the same simulated arrival of chunks, e.g.
+//   streamsort --sizes 1e8 --threads 1,16
+// Chunks arrive unthrottled or at a fixed rate. The batch path collects every chunk and
+// then runs mergeSort; the streaming path pushes each chunk into a StreamingSorter as it
+// arrives and reads the output in blocks after the last one. Both clocks start with the
+// first chunk: "first output" is when the smallest block can be consumed, "total" when
+// the whole sorted output has been produced.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "streamsort.h"
+#include "bench.h"
+
+using namespace std;
+
+struct Arrival {
+    string name;
+    double elements_per_second;   // 0: as fast as the producer can push
+};
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+    opts.sizes = {10000000, 100000000};
+    opts.reps = 5;
+    if (!parseBenchOptions(argc, argv, opts)) return 1;
+
+    const vector<ptrdiff_t> chunk_sizes = {1 << 16, 1 << 20};
+    const vector<Arrival> arrivals = {{"unthrottled", 0}, {"100M/s", 100e6}};
+    constexpr size_t READ_BLOCK = 1 << 20;
+
+    BenchReport report(opts, {{"first_output_ms", nullptr}});
+    report.run([&](const BenchConfig& cfg) {
+        const ptrdiff_t n = cfg.n;
+        const vector<double>& arr = cfg.arr;
+        WorkStealingPool& pool = cfg.pool;
+        vector<double> work(n), aux(n);
+        if (report.text()) cout << "Sorting " << n << " " << inputPatternName(cfg.input) << " elements arriving in chunks with " << cfg.threads << " threads..." << endl;
+
+        for (const Arrival& arrival : arrivals) {
+            for (ptrdiff_t chunk : chunk_sizes) {
+                const string suffix = " [chunk " + to_string(chunk) + ", " + arrival.name + "]";
+                // Hands every chunk to deliver(lo, hi) at its arrival time
+                auto produce = [&](chrono::steady_clock::time_point start, auto deliver) {
+                    for (ptrdiff_t lo = 0; lo < n; lo += chunk) {
+                        if (arrival.elements_per_second > 0) {
+                            this_thread::sleep_until(start + chrono::duration_cast<chrono::steady_clock::duration>(
+                                                                 chrono::duration<double>(lo / arrival.elements_per_second)));
+                        }
+                        deliver(lo, min(n, lo + chunk));
+                    }
+                };
+                auto record = [&](const string& name, const vector<double>& first, const vector<double>& total) {
+                    report.record({name + suffix, cfg.input, n, cfg.threads, summarize(total), {summarize(first).median}});
+                };
+                auto check = [&](const vector<double>& out) {
+                    if (!is_sorted(out.begin(), out.end())) {
+                        cerr << "Sorting failed!" << endl;
+                        exit(1);
+                    }
+                };
+
+                if (report.selected("batch" + suffix)) {
+                    vector<double> first, total;
+                    for (int r = 0; r < opts.warmup + opts.reps; r++) {
+                        auto start = chrono::steady_clock::now();
+                        produce(start, [&](ptrdiff_t lo, ptrdiff_t hi) { memcpy(work.data() + lo, arr.data() + lo, (hi - lo) * sizeof(double)); });
+                        mergeSort(work, aux, 0, n - 1, tunedProfile().k, tunedProfile().minThreadSize(n, cfg.threads), pool, networkSort);
+                        const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                        check(work);
+                        if (r < opts.warmup) continue;
+                        first.push_back(ms);
+                        total.push_back(ms);
+                    }
+                    record("batch", first, total);
+                }
+
+                if (report.selected("stream" + suffix)) {
+                    vector<double> first, total;
+                    for (int r = 0; r < opts.warmup + opts.reps; r++) {
+                        StreamingSortOptions sort_opts;
+                        sort_opts.pool = &pool;
+                        StreamingSorter sorter(sort_opts);
+                        auto start = chrono::steady_clock::now();
+                        produce(start, [&](ptrdiff_t lo, ptrdiff_t hi) { sorter.push(arr.data() + lo, hi - lo); });
+                        sorter.finish();
+
+                        StreamingSorter::Reader reader(sorter);
+                        double first_ms = 0;
+                        for (size_t done = 0; reader.remaining() > 0;) {
+                            done += reader.read(work.data() + done, READ_BLOCK);
+                            if (first_ms == 0) first_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                        }
+                        const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                        check(work);
+                        if (r < opts.warmup) continue;
+                        first.push_back(first_ms);
+                        total.push_back(ms);
+                    }
+                    record("stream", first, total);
+                }
+            }
+        }
+    });
+    return report.finish();
+}
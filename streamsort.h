@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "threadpool.h"
+#include "mergesorttk.h"
+#include "kwaymerge.h"
+#include "tuning.h"
+
+// Streaming sort: callers push chunks as they arrive, every chunk is sorted into a run by
+// the hybrid mergeSort on the pool while the next one is still arriving, and output is
+// merged from the runs only as it is read. Without a bound on future input no element is
+// safe to emit before the last chunk, so after finish() the first output waits only for
+// the chunks still being sorted and one block merge, instead of a sort of everything.
+//
+// Runs are merged in the background only to keep their number at most
+// StreamingSortOptions::max_runs (the two shortest, so long runs are not rewritten over
+// and over); the rest of the merging happens block by block in the Reader, which finds
+// the next block's slice of every run with multiwaySplit and merges the slices with the
+// k-way kernels.
+
+struct StreamingSortOptions {
+    WorkStealingPool* pool = nullptr;   // Shared pool when null
+    int k = 0;                          // Leaf size of the chunk sorts; 0 = tunedProfile().k
+    int max_runs = 32;                  // Runs left for the final merge
+};
+
+class StreamingSorter {
+public:
+    explicit StreamingSorter(const StreamingSortOptions& opts = {})
+        : opts_(opts), pool_(opts.pool ? *opts.pool : WorkStealingPool::instance()), group_(pool_) {}
+
+    StreamingSorter(const StreamingSorter&) = delete;
+    StreamingSorter& operator=(const StreamingSorter&) = delete;
+
+    // Queues a chunk for sorting and returns right away; callable from several threads
+    void push(std::vector<double> chunk) {
+        if (finished_) throw std::logic_error("StreamingSorter::push after finish");
+        if (chunk.empty()) return;
+        group_.run([this, chunk = std::move(chunk)]() mutable { sortChunk(std::move(chunk)); });
+    }
+
+    void push(const double* data, size_t n) { push(std::vector<double>(data, data + n)); }
+
+    // No more input: waits (helping on the pool) until every chunk is a sorted run
+    void finish() {
+        finished_ = true;
+        group_.wait();
+    }
+
+    // Elements pushed so far that have been sorted into runs
+    size_t sorted() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t total = 0;
+        for (const std::vector<double>& run : runs_) total += run.size();
+        return total + merging_elements_;
+    }
+
+    // Reads the merged output block by block, smallest first. The sorter must be
+    // finished and must outlive the reader.
+    class Reader {
+    public:
+        explicit Reader(StreamingSorter& sorter) : pool_(sorter.pool_) {
+            if (!sorter.finished_) throw std::logic_error("StreamingSorter::Reader before finish");
+            for (const std::vector<double>& run : sorter.runs_) runs_.push_back({run.data(), run.data() + run.size()});
+            total_ = totalSize(runs_.data(), (int)runs_.size());
+            split_.assign(runs_.size(), 0);
+            next_split_.assign(runs_.size(), 0);
+        }
+
+        size_t remaining() const { return total_ - done_; }
+
+        // Writes the next min(max, remaining()) elements to out and returns their count
+        size_t read(double* out, size_t max) {
+            const ptrdiff_t count = std::min(max, remaining());
+            if (count == 0) return 0;
+            const int k = (int)runs_.size();
+            multiwaySplit(runs_.data(), k, done_ + count, next_split_.data());
+            std::vector<SortedRun> slices(k);
+            for (int i = 0; i < k; i++) slices[i] = {runs_[i].begin + split_[i], runs_[i].begin + next_split_[i]};
+            parallelKWayMerge(slices.data(), k, out, pool_);
+            split_.swap(next_split_);
+            done_ += count;
+            return count;
+        }
+
+        // Element at a time, through an internal block
+        bool next(double& value) {
+            if (pos_ == block_.size()) {
+                block_.resize(READER_BLOCK);
+                block_.resize(read(block_.data(), READER_BLOCK));
+                pos_ = 0;
+                if (block_.empty()) return false;
+            }
+            value = block_[pos_++];
+            return true;
+        }
+
+        static constexpr size_t READER_BLOCK = 1 << 16;
+
+    private:
+        WorkStealingPool& pool_;
+        std::vector<SortedRun> runs_;
+        size_t total_ = 0, done_ = 0;
+        std::vector<ptrdiff_t> split_, next_split_;
+        std::vector<double> block_;
+        size_t pos_ = 0;
+    };
+
+    // Whole output at once, with one parallel k-way merge
+    void drain(std::vector<double>& out) {
+        Reader reader(*this);
+        out.resize(reader.remaining());
+        reader.read(out.data(), out.size());
+    }
+
+private:
+    void sortChunk(std::vector<double> chunk) {
+        const ptrdiff_t n = chunk.size();
+        std::vector<double> aux(n);
+        const TuningProfile& profile = tunedProfile();
+        mergeSort(chunk, aux, 0, n - 1, opts_.k ? opts_.k : profile.k, profile.minThreadSize(n, pool_.size() + 1), pool_, networkSort);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        runs_.push_back(std::move(chunk));
+        // Merge the two shortest runs while there are too many, each merge on the thread
+        // that found the excess, so concurrent chunks merge disjoint pairs
+        while ((int)runs_.size() > opts_.max_runs) {
+            std::sort(runs_.begin(), runs_.end(), [](const std::vector<double>& a, const std::vector<double>& b) { return a.size() > b.size(); });
+            std::vector<double> a = std::move(runs_.back());
+            runs_.pop_back();
+            std::vector<double> b = std::move(runs_.back());
+            runs_.pop_back();
+            merging_elements_ += a.size() + b.size();
+            lock.unlock();
+
+            std::vector<double> merged(a.size() + b.size());
+            parallelMergeRuns(a.data(), a.size(), b.data(), b.size(), merged.data(), pool_);
+            lock.lock();
+            merging_elements_ -= merged.size();
+            runs_.push_back(std::move(merged));
+        }
+    }
+
+    StreamingSortOptions opts_;
+    WorkStealingPool& pool_;
+    mutable std::mutex mutex_;
+    std::vector<std::vector<double>> runs_;
+    size_t merging_elements_ = 0;
+    std::atomic<bool> finished_{false};
+    TaskGroup group_;   // Last member: destroyed (and waited for) before the runs
+};
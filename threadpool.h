@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent work-stealing task pool used by the parallel sort engines.
+// Every worker owns a deque: it pushes and pops its own tasks at the back (LIFO,
+// so the most recently split half is still warm in cache) and, when idle, steals
+// from the front of the other workers' deques. Tasks submitted from outside the
+// pool go to a shared injection queue.
+class WorkStealingPool {
+public:
+    // on_start(i) runs first on worker i, e.g. to pin it to a CPU set (numasort.h)
+    explicit WorkStealingPool(unsigned num_workers = default_workers(), std::function<void(unsigned)> on_start = nullptr)
+        : queues_(num_workers + 1) {
+        for (unsigned i = 0; i < num_workers; i++) {
+            workers_.emplace_back([this, i, on_start] {
+                if (on_start) on_start(i);
+                workerLoop(i);
+            });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        sleep_cv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Number of worker threads (the thread waiting on a TaskGroup also runs tasks)
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+    void submit(std::function<void()> task) {
+        size_t q = (tl_pool == this) ? tl_index : injector();
+        {
+            std::lock_guard<std::mutex> lock(queues_[q].mutex);
+            queues_[q].tasks.push_back(std::move(task));
+        }
+        queued_.fetch_add(1);
+        if (sleepers_.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.notify_one();
+        }
+    }
+
+    // Run one pending task if any is available; returns false when every queue is empty
+    bool tryRunOne() {
+        size_t self = (tl_pool == this) ? tl_index : injector();
+        std::function<void()> task;
+        if (!popBack(self, task) && !stealAny(self, task)) return false;
+        queued_.fetch_sub(1);
+        task();
+        return true;
+    }
+
+    // Shared pool sized to the machine, created on first use
+    static WorkStealingPool& instance() {
+        static WorkStealingPool pool;
+        return pool;
+    }
+
+    static unsigned default_workers() {
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw > 1 ? hw - 1 : 0;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    size_t injector() const { return queues_.size() - 1; }
+
+    bool popBack(size_t q, std::function<void()>& task) {
+        std::lock_guard<std::mutex> lock(queues_[q].mutex);
+        if (queues_[q].tasks.empty()) return false;
+        task = std::move(queues_[q].tasks.back());
+        queues_[q].tasks.pop_back();
+        return true;
+    }
+
+    bool popFront(size_t q, std::function<void()>& task) {
+        std::lock_guard<std::mutex> lock(queues_[q].mutex);
+        if (queues_[q].tasks.empty()) return false;
+        task = std::move(queues_[q].tasks.front());
+        queues_[q].tasks.pop_front();
+        return true;
+    }
+
+    // Steal the oldest (largest) task, starting from the neighbour so victims are spread out
+    bool stealAny(size_t self, std::function<void()>& task) {
+        size_t n = queues_.size();
+        for (size_t step = 1; step <= n; step++) {
+            size_t victim = (self + step) % n;
+            if (victim == self) continue;
+            if (popFront(victim, task)) return true;
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned index) {
+        tl_pool = this;
+        tl_index = index;
+        while (true) {
+            if (tryRunOne()) continue;
+
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleepers_.fetch_add(1);
+            sleep_cv_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+            sleepers_.fetch_sub(1);
+            if (stop_ && queued_.load() == 0) return;
+        }
+    }
+
+    std::vector<Queue> queues_;  // one per worker, plus the injection queue at the end
+    std::vector<std::thread> workers_;
+    std::atomic<long> queued_{0};
+    std::atomic<int> sleepers_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    bool stop_ = false;
+
+    static inline thread_local WorkStealingPool* tl_pool = nullptr;
+    static inline thread_local size_t tl_index = 0;
+};
+
+// Fork-join scope: run() hands a task to the pool, wait() keeps executing pending
+// tasks on the calling thread until every task of this group has finished, so
+// recursive splits never block a worker.
+class TaskGroup {
+public:
+    explicit TaskGroup(WorkStealingPool& pool) : pool_(pool) {}
+    ~TaskGroup() { wait(); }
+
+    template <typename F>
+    void run(F&& f) {
+        pending_.fetch_add(1);
+        pool_.submit([this, f = std::forward<F>(f)]() mutable {
+            f();
+            pending_.fetch_sub(1);
+        });
+    }
+
+    void wait() {
+        while (pending_.load() > 0) {
+            if (!pool_.tryRunOne()) std::this_thread::yield();
+        }
+    }
+
+private:
+    WorkStealingPool& pool_;
+    std::atomic<int> pending_{0};
+};
@@ -0,0 +1,75 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "autotune.h"
+
+using namespace std;
+
+// Best of five psort::parallel_sort runs on arr with the given profile
+double timeProfile(const vector<double>& arr, const TuningProfile& p, WorkStealingPool& pool) {
+    AutotuneOptions opts;
+    opts.reps = 5;
+    return timeCandidate(arr, p, opts, pool);
+}
+
+int main(int argc, char* argv[]) {
+    // tune [--n N] [--eta E] [--reps R] [--threads T]   calibrate this host and store its profile
+    // tune --show                                       print the stored profile of this host
+    // The profile file is $PARALLELSORT_PROFILE or ~/.cache/parallelsort/profiles
+    AutotuneOptions opts;
+    int threads = 0;
+    bool show = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--n" && i + 1 < argc) opts.n = stoll(argv[++i]);
+        else if (arg == "--eta" && i + 1 < argc) opts.eta = stoi(argv[++i]);
+        else if (arg == "--reps" && i + 1 < argc) opts.reps = stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) threads = stoi(argv[++i]);
+        else if (arg == "--show") show = true;
+        else {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+    if (opts.n < 2 || opts.eta < 2 || opts.reps < 1 || threads < 0) {
+        cerr << "--n must be at least 2, --eta at least 2, --reps at least 1" << endl;
+        return 1;
+    }
+
+    const string path = profilePath(), host = hostKey();
+    cout << "Host: " << host << "\nProfile file: " << path << endl;
+
+    TuningProfile stored;
+    bool found = loadProfile(path, host, stored);
+    if (show) {
+        cout << (found ? describeProfile(stored) : "not calibrated, defaults " + describeProfile(stored)) << endl;
+        return found ? 0 : 1;
+    }
+
+    WorkStealingPool pool(threads > 0 ? threads - 1 : WorkStealingPool::default_workers());
+    opts.pool = &pool;
+    cout << "Calibrating with " << pool.size() + 1 << " threads, " << TUNE_K_VALUES.size() * TUNE_GRAIN_DIVISORS.size() * mergeKernels().size()
+         << " candidates, up to n = " << opts.n << "..." << endl;
+    auto start = chrono::steady_clock::now();
+    TuningProfile best = calibrate(opts, &cout);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Calibration took " << seconds << " s" << endl;
+
+    // Tuned against the built-in defaults at the largest calibration size
+    mt19937_64 gen(opts.seed + 1);
+    uniform_real_distribution<double> dist(0.0, 1.0);
+    vector<double> arr(opts.n);
+    for (double& x : arr) x = dist(gen);
+    double default_ms = timeProfile(arr, TuningProfile(), pool), tuned_ms = timeProfile(arr, best, pool);
+    cout << "Defaults (" << describeProfile(TuningProfile()) << "): " << default_ms << " ms\n"
+         << "Tuned    (" << describeProfile(best) << "): " << tuned_ms << " ms, " << default_ms / tuned_ms << "x" << endl;
+
+    if (!saveProfile(path, host, best)) {
+        cerr << "Could not write " << path << endl;
+        return 1;
+    }
+    cout << "Saved profile to " << path << endl;
+    return 0;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "merge.h"
+
+// Per-host tuning profile: the leaf size k, the thread grain (MIN_THREAD_SIZE as a share
+// of n / threads) and the merge kernel found by the calibration in autotune.h. Profiles
+// are stored one line per host in a text file, keyed by CPU model and core count, so a
+// process only reads the file; it never runs the search itself.
+
+struct TuningProfile {
+    int k = 50;                    // Leaf size of the hybrid merge sorts
+    int grain_divisor = 4;         // MIN_THREAD_SIZE = max(min_grain, n / (grain_divisor * threads))
+    ptrdiff_t min_grain = 10000;
+    std::string kernel = "simd";   // Merge kernel, see mergeKernels()
+    bool tuned = false;            // Read from a calibrated profile instead of the defaults
+
+    ptrdiff_t minThreadSize(ptrdiff_t n, int threads) const {
+        return std::max<ptrdiff_t>(min_grain, n / ((ptrdiff_t)grain_divisor * threads));
+    }
+};
+
+struct MergeKernelEntry {
+    const char* name;
+    MergeRunsFn fn;
+};
+
+// Kernels the calibration chooses from
+inline const std::vector<MergeKernelEntry>& mergeKernels() {
+    static const std::vector<MergeKernelEntry> kernels = {
+        {"branchy", mergeRunsBranchy},
+        {"branchless", mergeRunsBranchless},
+        {"simd", mergeRunsSIMD},
+    };
+    return kernels;
+}
+
+// nullptr for an unknown name
+inline MergeRunsFn mergeKernelByName(const std::string& name) {
+    for (const MergeKernelEntry& e : mergeKernels()) {
+        if (name == e.name) return e.fn;
+    }
+    return nullptr;
+}
+
+// CPU model from /proc/cpuinfo ("unknown" elsewhere)
+inline std::string cpuModel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) return line.substr(line.find_first_not_of(" \t", colon + 1));
+        }
+    }
+    return "unknown";
+}
+
+// Profile key of this machine: CPU model and number of hardware threads
+inline std::string hostKey() {
+    return cpuModel() + ", " + std::to_string(std::thread::hardware_concurrency()) + " threads";
+}
+
+// $PARALLELSORT_PROFILE, else $XDG_CACHE_HOME/parallelsort/profiles, else ~/.cache/parallelsort/profiles
+inline std::string profilePath() {
+    if (const char* path = std::getenv("PARALLELSORT_PROFILE")) return path;
+    if (const char* cache = std::getenv("XDG_CACHE_HOME")) return std::string(cache) + "/parallelsort/profiles";
+    if (const char* home = std::getenv("HOME")) return std::string(home) + "/.cache/parallelsort/profiles";
+    return "parallelsort-profiles";
+}
+
+// Profile line: "<host key>\tk=<k> grain_divisor=<g> min_grain=<m> kernel=<name>"
+inline std::string formatProfile(const std::string& host, const TuningProfile& p) {
+    return host + "\tk=" + std::to_string(p.k) + " grain_divisor=" + std::to_string(p.grain_divisor) +
+           " min_grain=" + std::to_string(p.min_grain) + " kernel=" + p.kernel;
+}
+
+inline bool parseProfile(const std::string& fields, TuningProfile& p) {
+    std::istringstream in(fields);
+    std::string field;
+    TuningProfile parsed;
+    while (in >> field) {
+        size_t eq = field.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = field.substr(0, eq), value = field.substr(eq + 1);
+        if (key == "k") {
+            parsed.k = std::atoi(value.c_str());
+        } else if (key == "grain_divisor") {
+            parsed.grain_divisor = std::atoi(value.c_str());
+        } else if (key == "min_grain") {
+            parsed.min_grain = std::atoll(value.c_str());
+        } else if (key == "kernel") {
+            parsed.kernel = value;
+        }
+    }
+    if (parsed.k < 1 || parsed.grain_divisor < 1 || parsed.min_grain < 1 || !mergeKernelByName(parsed.kernel)) return false;
+    parsed.tuned = true;
+    p = parsed;
+    return true;
+}
+
+// Reads the profile of host from path; false if the file or the host's line is missing or malformed
+inline bool loadProfile(const std::string& path, const std::string& host, TuningProfile& p) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t tab = line.find('\t');
+        if (tab != std::string::npos && line.compare(0, tab, host) == 0) return parseProfile(line.substr(tab + 1), p);
+    }
+    return false;
+}
+
+// Stores the profile of host in path, replacing its previous line and keeping other hosts'
+inline bool saveProfile(const std::string& path, const std::string& host, const TuningProfile& p) {
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.compare(0, host.size() + 1, host + "\t") != 0) lines.push_back(line);
+        }
+    }
+    lines.push_back(formatProfile(host, p));
+
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);   // mkdir -p of the parent directories
+    }
+    std::ofstream out(path, std::ios::trunc);
+    for (const std::string& line : lines) out << line << "\n";
+    return static_cast<bool>(out);
+}
+
+// Profile of this host, read once per process (defaults if it was never calibrated). A
+// tuned merge kernel is installed as activeMergeKernel() on first use.
+inline const TuningProfile& tunedProfile() {
+    static const TuningProfile profile = [] {
+        TuningProfile p;
+        if (loadProfile(profilePath(), hostKey(), p)) activeMergeKernel() = mergeKernelByName(p.kernel);
+        return p;
+    }();
+    return profile;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <sys/mman.h>
+
+// Scratch memory reused across sorts. Repeated sorts of small and medium batches otherwise
+// pay a malloc (or an mmap plus a page fault per 4 KB page) for every temporary; a
+// workspace keeps its buffers mapped, so once it has grown to the largest batch, the
+// psort.h, rank, sample and radix sorts allocate no scratch (buffers, radix counters,
+// bucket maps) and touch no fresh pages. Their parallel runs still allocate the pool's
+// small task records. The engines of mergesorttk.h and adaptivesort.h do not take a
+// workspace: they use a caller-owned aux or allocate their own scratch.
+//
+// Buffers are numbered slots so an engine can hold several at once (data and scratch,
+// elements and temp). A slot grows geometrically (at least doubling) and does not keep
+// its contents when it grows. Slots of 2 MB and more are 2 MB aligned and advised as
+// transparent huge pages, which cuts TLB misses on the large passes. A workspace is used
+// by one sort at a time: pool threads may write into its buffers, but two sorts must not
+// share one, and a sort must not call another on the same workspace.
+//
+// The engines take the calling thread's local() workspace through a Lease when none is
+// passed. A pool thread that helps in TaskGroup::wait can pick up a second sort while its
+// first one still holds local(); that sort then gets a private workspace for its duration.
+
+constexpr size_t WORKSPACE_PAGE = 4096;
+constexpr size_t WORKSPACE_HUGE_PAGE = 2 << 20;
+
+// Element types a workspace can hold: raw mapped memory is a valid array of them
+template <typename T>
+constexpr bool workspace_type = std::is_trivially_copyable_v<T> && std::is_trivially_default_constructible_v<T>;
+
+class SortWorkspace {
+public:
+    static constexpr int SLOTS = 4;
+
+    SortWorkspace() = default;
+    SortWorkspace(const SortWorkspace&) = delete;
+    SortWorkspace& operator=(const SortWorkspace&) = delete;
+    ~SortWorkspace() { release(); }
+
+    // Uninitialized room for count elements of T in slot, valid until the slot next grows
+    template <typename T>
+    T* buffer(int slot, size_t count) {
+        static_assert(workspace_type<T>, "workspace buffers hold trivially copyable types");
+        return static_cast<T*>(reserve(slot, count * sizeof(T)));
+    }
+
+    // Unmaps every slot
+    void release() {
+        for (Slot& s : slots_) {
+            if (s.data) munmap(s.data, s.bytes);
+            s = {};
+        }
+    }
+
+    // Bytes mapped over all slots
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Slot& s : slots_) total += s.bytes;
+        return total;
+    }
+
+    // The calling thread's workspace, used by the engines (through a Lease) when none is passed
+    static SortWorkspace& local() {
+        thread_local SortWorkspace workspace;
+        return workspace;
+    }
+
+    // The workspace of one sort: the given one, else local() unless a sort running on this
+    // thread holds it, else a private one released with the lease
+    class Lease {
+    public:
+        explicit Lease(SortWorkspace* workspace) : workspace_(workspace) {
+            if (workspace_) return;
+            if (!localHeld()) {
+                localHeld() = holds_local_ = true;
+                workspace_ = &local();
+            } else {
+                own_ = std::make_unique<SortWorkspace>();
+                workspace_ = own_.get();
+            }
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() {
+            if (holds_local_) localHeld() = false;
+        }
+
+        SortWorkspace& operator*() const { return *workspace_; }
+        SortWorkspace* operator->() const { return workspace_; }
+
+    private:
+        SortWorkspace* workspace_;
+        std::unique_ptr<SortWorkspace> own_;
+        bool holds_local_ = false;
+    };
+
+    // Slot growths (each one an mmap) by every workspace of the process
+    static uint64_t growths() { return growthCounter().load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        void* data = nullptr;
+        size_t bytes = 0;
+    };
+
+    static bool& localHeld() {
+        thread_local bool held = false;
+        return held;
+    }
+
+    static std::atomic<uint64_t>& growthCounter() {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+
+    void* reserve(int slot, size_t bytes) {
+        Slot& s = slots_[slot];
+        if (bytes <= s.bytes) return s.data;
+        const size_t grown = std::max(bytes, 2 * s.bytes);
+        if (s.data) munmap(s.data, s.bytes);
+        s = {};
+        if (grown >= WORKSPACE_HUGE_PAGE) {
+            // Over-map by one huge page and trim both ends to a 2 MB aligned range
+            const size_t size = (grown + WORKSPACE_HUGE_PAGE - 1) & ~(WORKSPACE_HUGE_PAGE - 1);
+            void* p = mmap(nullptr, size + WORKSPACE_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+            const uintptr_t raw = reinterpret_cast<uintptr_t>(p);
+            const uintptr_t aligned = (raw + WORKSPACE_HUGE_PAGE - 1) & ~(uintptr_t)(WORKSPACE_HUGE_PAGE - 1);
+            if (aligned > raw) munmap(p, aligned - raw);
+            if (aligned + size < raw + size + WORKSPACE_HUGE_PAGE) {
+                munmap(reinterpret_cast<void*>(aligned + size), raw + size + WORKSPACE_HUGE_PAGE - aligned - size);
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+            s = {reinterpret_cast<void*>(aligned), size};
+        } else {
+            const size_t size = (grown + WORKSPACE_PAGE - 1) & ~(WORKSPACE_PAGE - 1);
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+            s = {p, size};
+        }
+        growthCounter().fetch_add(1, std::memory_order_relaxed);
+        return s.data;
+    }
+
+    std::array<Slot, SLOTS> slots_{};
+};